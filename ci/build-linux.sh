@@ -39,6 +39,11 @@ export MPICC=$HOME/mpich/bin/mpicc
 export MPICXX=$HOME/mpich/bin/mpicxx
 export LD_LIBRARY_PATH=/usr/lib/lapack:/usr/lib/libblas:$LD_LIBRARY_PATH
 
+# Optionally build tensors with the intrusive reference count and small-block cache
+if [ "$TENSOR_INTRUSIVE_REFCOUNT" = "ON" ]; then
+    EXTRA_CONFIG="--enable-tensor-intrusive-refcount"
+fi
+
 # Configure and build MADNESS
 ./autogen.sh 
 mkdir build
@@ -48,6 +53,7 @@ cd build
     --with-google-test \
     --enable-never-spin \
     --with-libxc=${HOME}/libxc \
+    $EXTRA_CONFIG \
     LIBS="-L/usr/lib/lapack -L/usr/lib/libblas -llapack -lblas -lpthread"
 
 if [ "$RUN_TEST" = "buildonly" ]; then
@@ -10,6 +10,7 @@ cmake \
     -D CMAKE_BUILD_TYPE=RelWithDebInfo \
     -D ENABLE_UNITTESTS=ON \
     -D ENABLE_NEVER_SPIN=ON \
+    -D ENABLE_TENSOR_INTRUSIVE_REFCOUNT=${TENSOR_INTRUSIVE_REFCOUNT:-OFF} \
     ..
 
 if [ "$RUN_TEST" = "buildonly" ]; then
@@ -627,31 +627,31 @@ Tensor<double> XCfunctional::fxc_apply(const std::vector<Tensor<double> >& t,
         // multiply the kernel with the various densities
         else if (xc_contrib== XCfunctional::kernel_second_local) {  // local terms, second derivative
             Tensor<double> dens_pt=copy(t[enum_rho_pt]);
-            Tensor<double> sigma_pt=2.0*copy(t[enum_sigma_pta]);   // factor 2 for closed shell
+            Tensor<double> sigma_pt=2.0*lazy(t[enum_sigma_pta]);   // factor 2 for closed shell
             munger m(rhotol,rhomin);
             dens_pt.unaryop(m);
             sigma_pt.unaryop(m);
 
-            result1=v2rho2.emul(dens_pt);
-            if (is_gga()) result1+= 2.0*v2rhosigma.emul(sigma_pt);
+            result1=emul(v2rho2,dens_pt);
+            if (is_gga()) result1+= 2.0*emul(v2rhosigma,sigma_pt);
         } 
         else if (xc_contrib== XCfunctional::kernel_second_semilocal) {   // semilocal terms, second derivative
 //            const Tensor<double>& dens_pt=t[enum_rho_pt];
 //            const Tensor<double>& sigma_pt=2.0*t[enum_sigma_pta];       // factor 2 for closed shell
             Tensor<double> dens_pt=copy(t[enum_rho_pt]);
-            Tensor<double> sigma_pt=2.0*copy(t[enum_sigma_pta]);   // factor 2 for closed shell
+            Tensor<double> sigma_pt=2.0*lazy(t[enum_sigma_pta]);   // factor 2 for closed shell
             munger m(rhotol,rhomin);
             dens_pt.unaryop(m);
             sigma_pt.unaryop(m);
 
-            result1=2.0*v2rhosigma.emul(dens_pt) + 4.0*v2sigma2.emul(sigma_pt);
+            result1=2.0*emul(v2rhosigma,dens_pt) + 4.0*emul(v2sigma2,sigma_pt);
         } 
         else if (xc_contrib== XCfunctional::kernel_first_semilocal) {   // semilocal terms, first derivative
             result1=2.0*vsigma;
         }
 
         // accumulate into result tensor with proper weighting
-        result+=result1*funcs[i].second;
+        result+=lazy(result1)*funcs[i].second;
     }
 
     // check for NaNs
@@ -11,8 +11,12 @@
 using namespace std;
 
 #include <madness/misc/cfft.h>
+#include <madness/world/madness_exception.h>
 //   Include math library
 #include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
 
 //   FORWARD FOURIER TRANSFORM
 //     Input  - input data
@@ -182,3 +186,255 @@ void CFFT::Scale(double_complex *const Data, const unsigned int N)
 	for (unsigned int Position = 0; Position < N; ++Position)
 		Data[Position] *= Factor;
 }
+
+
+namespace madness {
+
+    namespace {
+        const double pi = 3.14159265358979323846;
+    }
+
+    FFTPlan::FFTPlan(unsigned long n) : n(n) {
+        if (n < 1 || (n & (n - 1))) MADNESS_EXCEPTION("FFTPlan: length must be a power of two", n);
+
+        // Per-stage twiddles so that the butterflies read them consecutively
+        if (n > 1) {
+            wr.resize(n-1);
+            wi.resize(n-1);
+        }
+        for (unsigned long h=1; h<n; h<<=1) {
+            for (unsigned long k=0; k<h; ++k) {
+                const double theta = -pi*double(k)/double(h);
+                wr[h-1+k] = std::cos(theta);
+                wi[h-1+k] = std::sin(theta);
+            }
+        }
+
+        unsigned long bits = 0;
+        while ((1ul << bits) < n) ++bits;
+        for (unsigned long i=0; i<n; ++i) {
+            unsigned long j = 0;
+            for (unsigned long b=0; b<bits; ++b) if (i & (1ul << b)) j |= 1ul << (bits-1-b);
+            if (i < j) {
+                swaps.push_back(i);
+                swaps.push_back(j);
+            }
+        }
+    }
+
+    void FFTPlan::transform_contiguous(double_complex* data, double sign) const {
+        for (size_t p=0; p<swaps.size(); p+=2) std::swap(data[swaps[p]], data[swaps[p+1]]);
+
+        double* const x = reinterpret_cast<double*>(data);
+        for (unsigned long h=1; h<n; h<<=1) {
+            const double* const cr = &wr[h-1];
+            const double* const ci = &wi[h-1];
+            for (unsigned long i=0; i<n; i+=2*h) {
+                double* const a = x + 2*i;
+                double* const b = x + 2*(i+h);
+                for (unsigned long k=0; k<h; ++k) {
+                    const double c = cr[k], s = sign*ci[k];
+                    const double tr = c*b[2*k] - s*b[2*k+1];
+                    const double ti = c*b[2*k+1] + s*b[2*k];
+                    b[2*k]   = a[2*k]   - tr;
+                    b[2*k+1] = a[2*k+1] - ti;
+                    a[2*k]   += tr;
+                    a[2*k+1] += ti;
+                }
+            }
+        }
+    }
+
+    void FFTPlan::transform_rows(double_complex* data, unsigned long howmany, unsigned long stride, double sign) const {
+        for (size_t p=0; p<swaps.size(); p+=2) {
+            double_complex* const a = data + swaps[p]*stride;
+            double_complex* const b = data + swaps[p+1]*stride;
+            for (unsigned long m=0; m<howmany; ++m) std::swap(a[m], b[m]);
+        }
+
+        // Each butterfly is applied to the whole batch with one twiddle
+        const unsigned long len = 2*howmany;
+        for (unsigned long h=1; h<n; h<<=1) {
+            for (unsigned long i=0; i<n; i+=2*h) {
+                for (unsigned long k=0; k<h; ++k) {
+                    const double c = wr[h-1+k], s = sign*wi[h-1+k];
+                    double* const a = reinterpret_cast<double*>(data + (i+k)*stride);
+                    double* const b = reinterpret_cast<double*>(data + (i+k+h)*stride);
+                    if (k == 0) {
+                        for (unsigned long m=0; m<len; ++m) {
+                            const double t = b[m];
+                            b[m] = a[m] - t;
+                            a[m] += t;
+                        }
+                    }
+                    else {
+                        for (unsigned long m=0; m<len; m+=2) {
+                            const double tr = c*b[m] - s*b[m+1];
+                            const double ti = c*b[m+1] + s*b[m];
+                            b[m]   = a[m]   - tr;
+                            b[m+1] = a[m+1] - ti;
+                            a[m]   += tr;
+                            a[m+1] += ti;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void FFTPlan::transform(double_complex* data, unsigned long howmany, unsigned long stride, unsigned long dist, double sign) const {
+        if (dist == 0) dist = n*stride;
+        if (stride == 1) {
+            for (unsigned long m=0; m<howmany; ++m) transform_contiguous(data + m*dist, sign);
+        }
+        else if (dist == 1) {
+            transform_rows(data, howmany, stride, sign);
+        }
+        else {
+            std::vector<double_complex> buf(n);
+            for (unsigned long m=0; m<howmany; ++m) {
+                double_complex* const x = data + m*dist;
+                for (unsigned long j=0; j<n; ++j) buf[j] = x[j*stride];
+                transform_contiguous(&buf[0], sign);
+                for (unsigned long j=0; j<n; ++j) x[j*stride] = buf[j];
+            }
+        }
+    }
+
+    void FFTPlan::forward(double_complex* data, unsigned long howmany, unsigned long stride, unsigned long dist) const {
+        transform(data, howmany, stride, dist, 1.0);
+    }
+
+    void FFTPlan::inverse(double_complex* data, unsigned long howmany, unsigned long stride, unsigned long dist,
+                          bool scale) const {
+        transform(data, howmany, stride, dist, -1.0);
+        if (scale) {
+            if (dist == 0) dist = n*stride;
+            const double fac = 1.0/double(n);
+            for (unsigned long m=0; m<howmany; ++m)
+                for (unsigned long j=0; j<n; ++j) data[m*dist + j*stride] *= fac;
+        }
+    }
+
+    std::shared_ptr<const FFTPlan> FFTPlan::get(unsigned long n) {
+        static std::mutex mutex;
+        static std::map<unsigned long, std::shared_ptr<const FFTPlan> > cache;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const FFTPlan>& plan = cache[n];
+        if (!plan) plan = std::make_shared<const FFTPlan>(n);
+        return plan;
+    }
+
+
+    RealFFTPlan::RealFFTPlan(unsigned long n) : n(n) {
+        if (n < 2 || (n & (n - 1))) MADNESS_EXCEPTION("RealFFTPlan: length must be a power of two >= 2", n);
+        half = FFTPlan::get(n/2);
+        w.resize(n/4+1);
+        for (unsigned long k=0; k<=n/4; ++k) w[k] = std::polar(1.0, -2.0*pi*double(k)/double(n));
+    }
+
+    void RealFFTPlan::forward(const double* in, double_complex* out, unsigned long howmany,
+                              unsigned long idist, unsigned long odist) const {
+        const unsigned long h = n/2;
+        if (idist == 0) idist = n;
+        if (odist == 0) odist = h+1;
+        const double_complex mi(0.0, -0.5);
+        for (unsigned long m=0; m<howmany; ++m) {
+            double_complex* const z = out + m*odist;
+
+            // The even and odd elements are the real and imaginary parts of one complex sequence
+            std::memcpy(static_cast<void*>(z), in + m*idist, n*sizeof(double));
+            half->forward(z);
+
+            // X_k = E_k + W^k O_k and X_{h-k} = conj(E_k - W^k O_k)
+            for (unsigned long k=0; k<=h/2; ++k) {
+                const double_complex zk = z[k], zhk = std::conj(z[(h-k)%h]);
+                const double_complex e = 0.5*(zk + zhk);
+                const double_complex o = w[k]*(mi*(zk - zhk));
+                z[k] = e + o;
+                z[h-k] = std::conj(e - o);
+            }
+        }
+    }
+
+    void RealFFTPlan::inverse(double_complex* in, double* out, unsigned long howmany,
+                              unsigned long idist, unsigned long odist) const {
+        const unsigned long h = n/2;
+        if (idist == 0) idist = h+1;
+        if (odist == 0) odist = n;
+        const double_complex i(0.0, 1.0);
+        for (unsigned long m=0; m<howmany; ++m) {
+            double_complex* const x = in + m*idist;
+
+            // Z_k = E_k + i O_k with E_k = (X_k + conj(X_{h-k}))/2 and O_k = (X_k - conj(X_{h-k}))/(2 W^k)
+            for (unsigned long k=0; k<=h/2; ++k) {
+                const double_complex xk = x[k], xhk = std::conj(x[h-k]);
+                const double_complex e = 0.5*(xk + xhk);
+                const double_complex o = 0.5*(xk - xhk)*std::conj(w[k]);
+                x[k] = e + i*o;
+                if (k) x[h-k] = std::conj(e) + i*std::conj(o);
+            }
+            half->inverse(x);
+            std::memcpy(out + m*odist, static_cast<const void*>(x), n*sizeof(double));
+        }
+    }
+
+    std::shared_ptr<const RealFFTPlan> RealFFTPlan::get(unsigned long n) {
+        static std::mutex mutex;
+        static std::map<unsigned long, std::shared_ptr<const RealFFTPlan> > cache;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const RealFFTPlan>& plan = cache[n];
+        if (!plan) plan = std::make_shared<const RealFFTPlan>(n);
+        return plan;
+    }
+
+
+    FFTPlanND::FFTPlanND(const std::vector<unsigned long>& dims) : dims(dims) {
+        if (dims.empty()) MADNESS_EXCEPTION("FFTPlanND: no dimensions", 0);
+        for (unsigned long d : dims) plans.push_back(FFTPlan::get(d));
+        if (dims.back() >= 2) rplan = RealFFTPlan::get(dims.back());
+    }
+
+    unsigned long FFTPlanND::complex_size() const {
+        unsigned long size = dims.back()/2 + 1;
+        for (size_t a=0; a+1<dims.size(); ++a) size *= dims[a];
+        return size;
+    }
+
+    /// Transforms dimensions 0..ndim-1 of the array whose last dimension has length last
+    void FFTPlanND::transform(double_complex* data, unsigned long ndim, unsigned long last, bool inverse) const {
+        for (unsigned long a=0; a<ndim; ++a) {
+            unsigned long outer = 1, inner = last;
+            for (unsigned long b=0; b<a; ++b) outer *= dims[b];
+            for (unsigned long b=a+1; b+1<dims.size(); ++b) inner *= dims[b];
+            if (a+1 == dims.size()) inner = 1;
+            for (unsigned long o=0; o<outer; ++o) {
+                double_complex* const x = data + o*dims[a]*inner;
+                if (inverse) plans[a]->inverse(x, inner, inner, 1);
+                else plans[a]->forward(x, inner, inner, 1);
+            }
+        }
+    }
+
+    void FFTPlanND::forward(double_complex* data) const {
+        transform(data, dims.size(), dims.back(), false);
+    }
+
+    void FFTPlanND::inverse(double_complex* data) const {
+        transform(data, dims.size(), dims.back(), true);
+    }
+
+    void FFTPlanND::forward(const double* in, double_complex* out) const {
+        if (!rplan) MADNESS_EXCEPTION("FFTPlanND: last dimension too short for a real transform", dims.back());
+        const unsigned long nc = dims.back()/2 + 1;
+        rplan->forward(in, out, complex_size()/nc);
+        transform(out, dims.size()-1, nc, false);
+    }
+
+    void FFTPlanND::inverse(double_complex* in, double* out) const {
+        if (!rplan) MADNESS_EXCEPTION("FFTPlanND: last dimension too short for a real transform", dims.back());
+        const unsigned long nc = dims.back()/2 + 1;
+        transform(in, dims.size()-1, nc, true);
+        rplan->inverse(in, out, complex_size()/nc);
+    }
+}
@@ -10,6 +10,8 @@
 
 //   Include complex numbers header
 #include <complex>
+#include <vector>
+#include <memory>
 
 typedef std::complex<double> double_complex;
 
@@ -52,4 +54,133 @@ protected:
     static void Scale(double_complex *const Data, const unsigned int N);
 };
 
+namespace madness {
+
+    /// Plan for batched complex FFTs of a fixed power-of-two length
+
+    /// Unlike \c CFFT, which derives the twiddle factors by recurrence on
+    /// each call, the plan tabulates them per stage together with the
+    /// bit-reversal permutation, so that repeated transforms of one length
+    /// only do the butterflies.  Plans are immutable and can be shared
+    /// between threads; \c get() returns a cached plan for each length.
+    ///
+    /// A batch of \c howmany sequences is transformed in-place, element j
+    /// of sequence b being at data[b*dist + j*stride].  With stride 1 each
+    /// sequence is transformed in turn.  With dist 1 (e.g., along an outer
+    /// dimension of a multi-dimensional array) the butterflies run over
+    /// the contiguous batch in the innermost loop, which vectorizes.
+    class FFTPlan {
+        unsigned long n;
+        std::vector<double> wr, wi;     ///< Twiddles exp(-i pi k/h) of the stage with half length h at offset h-1
+        std::vector<unsigned long> swaps; ///< Pairs of indices exchanged by the bit reversal
+
+        void transform_contiguous(double_complex* data, double sign) const;
+        void transform_rows(double_complex* data, unsigned long howmany, unsigned long stride, double sign) const;
+        void transform(double_complex* data, unsigned long howmany, unsigned long stride, unsigned long dist, double sign) const;
+
+    public:
+        /// Makes the plan for length n, which must be a power of two
+        explicit FFTPlan(unsigned long n);
+
+        /// Returns the length of the transform
+        unsigned long size() const {return n;}
+
+        /// Forward transform, X_k = sum_j x_j exp(-2 pi i jk/n)
+
+        /// @param[in,out] data The sequences to be transformed in-place
+        /// @param[in] howmany The number of sequences
+        /// @param[in] stride The distance between elements of a sequence
+        /// @param[in] dist The distance between sequences (default is n*stride)
+        void forward(double_complex* data, unsigned long howmany=1, unsigned long stride=1, unsigned long dist=0) const;
+
+        /// Inverse transform, x_j = (1/n) sum_k X_k exp(2 pi i jk/n), the scaling being optional
+
+        /// Arguments as for \c forward()
+        void inverse(double_complex* data, unsigned long howmany=1, unsigned long stride=1, unsigned long dist=0,
+                     bool scale=true) const;
+
+        /// Returns the cached plan for length n (thread safe)
+        static std::shared_ptr<const FFTPlan> get(unsigned long n);
+    };
+
+
+    /// Plan for batched real-to-complex and complex-to-real FFTs of a fixed power-of-two length
+
+    /// The n real values are transformed as n/2 complex values with the
+    /// cached \c FFTPlan of half the length and the n/2+1 independent
+    /// coefficients of the Hermitian result separated with tabulated
+    /// twiddles, which costs about half of a complex transform of length n.
+    class RealFFTPlan {
+        unsigned long n;
+        std::shared_ptr<const FFTPlan> half;
+        std::vector<double_complex> w;  ///< exp(-2 pi i k/n), k=0..n/4
+
+    public:
+        /// Makes the plan for length n, which must be a power of two >= 2
+        explicit RealFFTPlan(unsigned long n);
+
+        /// Returns the length of the real sequences
+        unsigned long size() const {return n;}
+
+        /// Forward transform of real sequences to their n/2+1 coefficients X_0..X_n/2
+
+        /// @param[in] in The real sequences, sequence b starting at in + b*idist
+        /// @param[out] out The coefficients, sequence b starting at out + b*odist
+        /// @param[in] howmany The number of sequences
+        /// @param[in] idist The distance between input sequences (default is n)
+        /// @param[in] odist The distance between output sequences (default is n/2+1)
+        void forward(const double* in, double_complex* out, unsigned long howmany=1,
+                     unsigned long idist=0, unsigned long odist=0) const;
+
+        /// Inverse transform of n/2+1 coefficients to real sequences, scaled by 1/n
+
+        /// The input is overwritten.  Arguments as for \c forward() with
+        /// idist referring to the coefficients and odist to the real output.
+        void inverse(double_complex* in, double* out, unsigned long howmany=1,
+                     unsigned long idist=0, unsigned long odist=0) const;
+
+        /// Returns the cached plan for length n (thread safe)
+        static std::shared_ptr<const RealFFTPlan> get(unsigned long n);
+    };
+
+
+    /// Plan for multi-dimensional complex and real FFTs of row-major arrays
+
+    /// Complex transforms run along each dimension with the batched
+    /// \c FFTPlan, the outer dimensions using the vectorized batch over the
+    /// contiguous inner dimensions.  The real-to-complex transform
+    /// (n0,...,nd) -> (n0,...,nd/2+1) first transforms the last dimension
+    /// with \c RealFFTPlan and then the others as complex.  All lengths
+    /// must be powers of two.
+    class FFTPlanND {
+        std::vector<unsigned long> dims;
+        std::vector<std::shared_ptr<const FFTPlan> > plans;
+        std::shared_ptr<const RealFFTPlan> rplan;
+
+        void transform(double_complex* data, unsigned long ndim, unsigned long last, bool inverse) const;
+
+    public:
+        /// Makes the plan for arrays of the given dimensions
+        explicit FFTPlanND(const std::vector<unsigned long>& dims);
+
+        /// Returns the dimensions of the (real or complex) array
+        const std::vector<unsigned long>& get_dims() const {return dims;}
+
+        /// Returns the number of complex coefficients of the real-to-complex transform
+        unsigned long complex_size() const;
+
+        /// In-place forward complex transform of the array
+        void forward(double_complex* data) const;
+
+        /// In-place inverse complex transform of the array, scaled by 1/(n0*...*nd)
+        void inverse(double_complex* data) const;
+
+        /// Forward transform of the real array to the (n0,...,nd/2+1) complex array
+        void forward(const double* in, double_complex* out) const;
+
+        /// Inverse transform of the (n0,...,nd/2+1) complex array, which is overwritten, to the real array
+        void inverse(double_complex* in, double* out) const;
+    };
+}
+
 #endif // MADNESS_MISC_CFFT_H__INCLUDED
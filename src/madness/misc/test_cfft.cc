@@ -0,0 +1,250 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <madness/misc/cfft.h>
+
+using namespace std;
+using namespace madness;
+
+/// Tests the planned FFTs against a direct DFT and times them against CFFT
+
+/// With arguments, e.g. "test_cfft bench", only the timings are printed
+/// (with larger repeat counts).
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+vector<double_complex> dft(const vector<double_complex>& x, double sign) {
+    const size_t n = x.size();
+    vector<double_complex> y(n);
+    for (size_t k=0; k<n; ++k) {
+        double_complex sum = 0.0;
+        for (size_t j=0; j<n; ++j) sum += x[j]*std::polar(1.0, sign*2.0*3.14159265358979323846*double((j*k)%n)/double(n));
+        y[k] = sum;
+    }
+    return y;
+}
+
+double maxdiff(const double_complex* a, const double_complex* b, size_t n) {
+    double err = 0.0;
+    for (size_t i=0; i<n; ++i) err = std::max(err, std::abs(a[i]-b[i]));
+    return err;
+}
+
+double value(size_t i) {
+    return std::sin(0.37*i) + 0.25*std::cos(1.3*i*i);
+}
+
+bool test_1d() {
+    bool ok = true;
+    for (unsigned long n=1; n<=256; n*=2) {
+        vector<double_complex> x(n);
+        for (size_t i=0; i<n; ++i) x[i] = double_complex(value(i), value(i+n));
+        const vector<double_complex> ref = dft(x, -1.0);
+
+        // Single, batched contiguous, batched interleaved and strided
+        vector<double_complex> y = x;
+        FFTPlan::get(n)->forward(&y[0]);
+        double err = maxdiff(&y[0], &ref[0], n);
+
+        const unsigned long howmany = 3;
+        vector<double_complex> b(n*howmany), r(n*howmany), s(2*n*howmany);
+        for (size_t m=0; m<howmany; ++m)
+            for (size_t j=0; j<n; ++j) {
+                b[m*n+j] = x[j]*double(m+1);
+                r[j*howmany+m] = x[j]*double(m+1);
+                s[2*m*n + 2*j] = x[j]*double(m+1);
+            }
+        FFTPlan::get(n)->forward(&b[0], howmany);
+        FFTPlan::get(n)->forward(&r[0], howmany, howmany, 1);
+        FFTPlan::get(n)->forward(&s[0], howmany, 2, 2*n);
+        for (size_t m=0; m<howmany; ++m)
+            for (size_t j=0; j<n; ++j) {
+                err = std::max(err, std::abs(b[m*n+j] - ref[j]*double(m+1)));
+                err = std::max(err, std::abs(r[j*howmany+m] - ref[j]*double(m+1)));
+                err = std::max(err, std::abs(s[2*m*n+2*j] - ref[j]*double(m+1)));
+            }
+
+        FFTPlan::get(n)->inverse(&y[0]);
+        err = std::max(err, maxdiff(&y[0], &x[0], n));
+        FFTPlan::get(n)->inverse(&r[0], howmany, howmany, 1);
+        for (size_t m=0; m<howmany; ++m)
+            for (size_t j=0; j<n; ++j) err = std::max(err, std::abs(r[j*howmany+m] - x[j]*double(m+1)));
+
+        // Real to complex and back
+        if (n >= 2) {
+            vector<double> xr(2*n), xback(2*n);
+            vector<double_complex> xc(n), c(2*(n/2+1));
+            for (size_t i=0; i<n; ++i) xc[i] = xr[i] = xr[i+n] = value(i);
+            const vector<double_complex> rref = dft(xc, -1.0);
+            RealFFTPlan::get(n)->forward(&xr[0], &c[0], 2);
+            for (size_t m=0; m<2; ++m) err = std::max(err, maxdiff(&c[m*(n/2+1)], &rref[0], n/2+1));
+            RealFFTPlan::get(n)->inverse(&c[0], &xback[0], 2);
+            for (size_t i=0; i<2*n; ++i) err = std::max(err, std::abs(xback[i] - xr[i]));
+        }
+
+        cout << "n " << n << " error " << err << endl;
+        ok = ok && err < 1e-11*std::max(1.0, double(n));
+    }
+    return ok;
+}
+
+bool test_nd() {
+    bool ok = true;
+    const vector<vector<unsigned long> > shapes = {{8}, {4,8}, {8,2,16}, {2,4,8,4}};
+    for (const vector<unsigned long>& dims : shapes) {
+        FFTPlanND plan(dims);
+        size_t size = 1;
+        for (unsigned long d : dims) size *= d;
+
+        vector<double> x(size), xback(size);
+        vector<double_complex> xc(size);
+        for (size_t i=0; i<size; ++i) xc[i] = x[i] = value(i);
+
+        // Reference by 1-d DFTs along each dimension
+        vector<double_complex> ref = xc;
+        size_t inner = size;
+        for (size_t a=0; a<dims.size(); ++a) {
+            const size_t n = dims[a];
+            inner /= n;
+            for (size_t o=0; o<size/(n*inner); ++o)
+                for (size_t i=0; i<inner; ++i) {
+                    vector<double_complex> line(n);
+                    for (size_t j=0; j<n; ++j) line[j] = ref[(o*n+j)*inner+i];
+                    line = dft(line, -1.0);
+                    for (size_t j=0; j<n; ++j) ref[(o*n+j)*inner+i] = line[j];
+                }
+        }
+
+        vector<double_complex> y = xc;
+        plan.forward(&y[0]);
+        double err = maxdiff(&y[0], &ref[0], size);
+        plan.inverse(&y[0]);
+        err = std::max(err, maxdiff(&y[0], &xc[0], size));
+
+        const size_t last = dims.back(), nc = last/2+1;
+        vector<double_complex> c(plan.complex_size());
+        plan.forward(&x[0], &c[0]);
+        for (size_t r=0; r<size/last; ++r)
+            for (size_t k=0; k<nc; ++k) err = std::max(err, std::abs(c[r*nc+k] - ref[r*last+k]));
+        plan.inverse(&c[0], &xback[0]);
+        for (size_t i=0; i<size; ++i) err = std::max(err, std::abs(xback[i] - x[i]));
+
+        cout << "dims";
+        for (unsigned long d : dims) cout << " " << d;
+        cout << " error " << err << endl;
+        ok = ok && err < 1e-11;
+    }
+    return ok;
+}
+
+/// Times batched 1-d and 3-d transforms against CFFT
+void benchmark(int rep) {
+    for (unsigned long n=64; n<=4096; n*=4) {
+        const unsigned long howmany = 65536/n;
+        vector<double_complex> x(n*howmany);
+        for (size_t i=0; i<x.size(); ++i) x[i] = value(i);
+
+        double start = now();
+        for (int r=0; r<rep; ++r)
+            for (unsigned long m=0; m<howmany; ++m) CFFT::Forward(&x[m*n], n);
+        const double tcfft = (now()-start)/rep;
+
+        start = now();
+        for (int r=0; r<rep; ++r) FFTPlan::get(n)->forward(&x[0], howmany);
+        const double tplan = (now()-start)/rep;
+
+        vector<double> xr(n*howmany);
+        vector<double_complex> c((n/2+1)*howmany);
+        for (size_t i=0; i<xr.size(); ++i) xr[i] = value(i);
+        start = now();
+        for (int r=0; r<rep; ++r) RealFFTPlan::get(n)->forward(&xr[0], &c[0], howmany);
+        const double treal = (now()-start)/rep;
+
+        printf("1d n=%5lu x %5lu  CFFT %8.3f ms  plan %8.3f ms (%.1fx)  r2c %8.3f ms (%.1fx)\n",
+               n, howmany, 1e3*tcfft, 1e3*tplan, tcfft/tplan, 1e3*treal, tcfft/treal);
+    }
+
+    for (unsigned long n=16; n<=64; n*=2) {
+        const unsigned long size = n*n*n;
+        vector<double_complex> x(size);
+        for (size_t i=0; i<size; ++i) x[i] = value(i);
+
+        // CFFT along each dimension, gathering the strided lines
+        double start = now();
+        vector<double_complex> line(n);
+        for (int r=0; r<rep; ++r) {
+            for (unsigned long inner=1; inner<size; inner*=n)
+                for (unsigned long o=0; o<size/(n*inner); ++o)
+                    for (unsigned long i=0; i<inner; ++i) {
+                        double_complex* p = &x[o*n*inner+i];
+                        for (unsigned long j=0; j<n; ++j) line[j] = p[j*inner];
+                        CFFT::Forward(&line[0], n);
+                        for (unsigned long j=0; j<n; ++j) p[j*inner] = line[j];
+                    }
+        }
+        const double tcfft = (now()-start)/rep;
+
+        FFTPlanND plan({n,n,n});
+        start = now();
+        for (int r=0; r<rep; ++r) plan.forward(&x[0]);
+        const double tplan = (now()-start)/rep;
+
+        vector<double> xr(size);
+        vector<double_complex> c(plan.complex_size());
+        for (size_t i=0; i<size; ++i) xr[i] = value(i);
+        start = now();
+        for (int r=0; r<rep; ++r) plan.forward(&xr[0], &c[0]);
+        const double treal = (now()-start)/rep;
+
+        printf("3d n=%5lu^3       CFFT %8.3f ms  plan %8.3f ms (%.1fx)  r2c %8.3f ms (%.1fx)\n",
+               n, 1e3*tcfft, 1e3*tplan, tcfft/tplan, 1e3*treal, tcfft/treal);
+    }
+}
+
+int main(int argc, char** argv) {
+    cout.precision(3);
+    if (argc > 1) {
+        benchmark(20);
+        return 0;
+    }
+    const bool ok = test_1d() && test_nd();
+    benchmark(2);
+    cout << (ok ? "FFT plan tests passed" : "FFT plan tests FAILED") << endl;
+    return ok ? 0 : 1;
+}
@@ -184,6 +184,7 @@ namespace madness {
         static bool truncate_on_project; ///< If true initial projection inserts at n-1 not n
         static bool apply_randomize;   ///< If true use randomization for load balancing in apply integral operator
         static bool project_randomize; ///< If true use randomization for load balancing in project/refine
+        static bool accumulate_randomized; ///< If true accumulate low rank results of apply with a randomized range finder
         static BoundaryConditions<NDIM> bc; ///< Default boundary conditions
         static Tensor<double> cell ;   ///< cell[NDIM][2] Simulation cell, cell(0,0)=xlo, cell(0,1)=xhi, ...
         static Tensor<double> cell_width;///< Width of simulation cell in each dimension
@@ -342,6 +343,19 @@ namespace madness {
             project_randomize=value;
         }
 
+        /// Gets the randomized accumulation of low rank results flag
+        static bool get_accumulate_randomized() {
+            return accumulate_randomized;
+        }
+
+        /// Sets the randomized accumulation of low rank results flag
+
+        /// If set, the TT_2D results of apply are added to the destination
+        /// nodes by add_randomized instead of add_SVD
+        static void set_accumulate_randomized(bool value) {
+            accumulate_randomized=value;
+        }
+
         /// Returns the default boundary conditions
         static const BoundaryConditions<NDIM>& get_bc() {
             return bc;
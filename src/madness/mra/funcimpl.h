@@ -358,10 +358,13 @@ namespace madness {
             if (has_coeff()) {
 
 #if 1
-                coeff().add_SVD(t,args.thresh);
+                const bool randomized=FunctionDefaults<NDIM>::get_accumulate_randomized();
+                if (randomized) coeff().add_randomized(t,args.thresh);
+                else coeff().add_SVD(t,args.thresh);
                 if (buffer.rank()<coeff().rank()) {
                     if (buffer.has_data()) {
-                        buffer.add_SVD(coeff(),args.thresh);
+                        if (randomized) buffer.add_randomized(coeff(),args.thresh);
+                        else buffer.add_SVD(coeff(),args.thresh);
                     } else {
                         buffer=copy(coeff());
                     }
@@ -1840,10 +1843,10 @@ namespace madness {
             //madness::print("do_mul: l", key, left.size());
             Tensor<L> lcube = fcube_for_mul(key, key, left);
 
-            Tensor<T> tcube(cdata.vk,false);
-            TERNARY_OPTIMIZED_ITERATOR(T, tcube, L, lcube, R, rcube, *_p0 = *_p1 * *_p2;);
+            // Product and scaling in one pass (the transform is linear)
             double scale = pow(0.5,0.5*NDIM*key.level())*sqrt(FunctionDefaults<NDIM>::get_cell_volume());
-            tcube = transform(tcube,cdata.quad_phiw).scale(scale);
+            Tensor<T> tcube = emul(lcube, rcube)*scale;
+            tcube = transform(tcube,cdata.quad_phiw);
             coeffs.replace(key, nodeT(coeffT(tcube,targs),false));
         }
 
@@ -1869,10 +1872,9 @@ namespace madness {
 
             // it's sufficient to scale once
             double scale = pow(2.0,0.5*NDIM*key.level())/sqrt(FunctionDefaults<NDIM>::get_cell_volume());
-            Tensor<T> c1value=transform(c11,cdata2.quad_phit).scale(scale);
+            Tensor<T> c1value=transform(c11,cdata2.quad_phit);
             Tensor<R> c2value=transform(c22,cdata2.quad_phit);
-            Tensor<resultT> resultvalue(cdata2.vk,false);
-            TERNARY_OPTIMIZED_ITERATOR(resultT, resultvalue, T, c1value, R, c2value, *_p0 = *_p1 * *_p2;);
+            Tensor<resultT> resultvalue = emul(c1value, c2value)*scale;
 
             Tensor<resultT> result=transform(resultvalue,cdata2.quad_phiw);
 
@@ -2159,6 +2161,24 @@ namespace madness {
             template <typename Archive> void serialize(const Archive& ar) {}
         };
 
+        /// reduce the rank of a batch of local nodes in a single task
+        struct reduce_rank_task : public TaskInterface {
+            std::vector<coeffT*> coeffs;
+            double thresh;
+
+            reduce_rank_task(const std::vector<coeffT*>& coeffs, const double& thresh)
+                : coeffs(coeffs), thresh(thresh) {}
+
+            void run(World& world) {
+                coeffT::reduce_rank(coeffs,thresh);
+            }
+
+        private:
+            virtual void get_id(std::pair<void*,unsigned short>& id) const {
+                PoolTaskInterface::make_id(id, *this);
+            }
+        };
+
 
 
         /// check symmetry wrt particle exchange
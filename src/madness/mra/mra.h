@@ -44,6 +44,7 @@
 #include <madness/world/MADworld.h>
 #include <madness/misc/misc.h>
 #include <madness/tensor/tensor.h>
+#include <madness/tensor/vmath.h>
 
 #define FUNCTION_INSTANTIATE_1
 #define FUNCTION_INSTANTIATE_2
@@ -849,6 +850,9 @@ namespace madness {
         };
 
         /// Inplace unary operation on function values
+
+        /// For exp, log, sqrt, erf, sin and cos of real functions the
+        /// functors \c unaryop_exp etc. (vmath.h) are faster
         void unaryop(T (*f)(T)) {
             // Must fence here due to temporary object on stack
             // stopping us returning before complete
@@ -1165,7 +1165,7 @@ namespace madness {
 
         rhs.flo_unary_op_node_inplace(do_average(*this),true);
         this->scale_inplace(0.5,true);
-        flo_unary_op_node_inplace(do_reduce_rank(targs),true);
+        reduce_rank(targs,true);
     }
 
     /// change the tensor type of the coefficients in the FunctionNode
@@ -1178,10 +1178,23 @@ namespace madness {
 
     /// reduce the rank of the coefficients tensors
 
+    /// The local nodes are handed to the tasks in batches, so that the
+    /// small decompositions of all nodes of a batch are done together.
     /// @param[in]  targs   target tensor arguments (threshold and full/low rank)
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::reduce_rank(const TensorArgs& targs, bool fence) {
-        flo_unary_op_node_inplace(do_reduce_rank(targs),fence);
+        const size_t batchsize=32;
+        std::vector<coeffT*> batch;
+        for (typename dcT::iterator it=coeffs.begin(); it!=coeffs.end(); ++it) {
+            if (not it->second.has_coeff()) continue;
+            batch.push_back(&(it->second.coeff()));
+            if (batch.size()==batchsize) {
+                world.taskq.add(new reduce_rank_task(batch,targs.thresh));
+                batch.clear();
+            }
+        }
+        if (batch.size()>0) world.taskq.add(new reduce_rank_task(batch,targs.thresh));
+        if (fence) world.gop.fence();
     }
 
 
@@ -1742,7 +1755,7 @@ namespace madness {
 
         // reduce the rank of the final nodes, leave full tensors unchanged
         //            flo_unary_op_node_inplace(do_reduce_rank(tight_args.thresh),true);
-        flo_unary_op_node_inplace(do_reduce_rank(targs),true);
+        reduce_rank(targs,true);
 
         // change TT_FULL to low rank
         flo_unary_op_node_inplace(do_change_tensor_type(targs),true);
@@ -3308,6 +3321,7 @@ namespace madness {
         truncate_on_project = true;
         apply_randomize = false;
         project_randomize = false;
+        accumulate_randomized = false;
         bc = BoundaryConditions<NDIM>(BC_FREE);
         tt = TT_FULL;
         cell = Tensor<double>(NDIM,2);
@@ -3333,6 +3347,7 @@ namespace madness {
     		std::cout << "             truncate_on_project" <<  ": " << truncate_on_project << std::endl;
     		std::cout << "                 apply_randomize" <<  ": " << apply_randomize << std::endl;
     		std::cout << "               project_randomize" <<  ": " << project_randomize << std::endl;
+    		std::cout << "           accumulate_randomized" <<  ": " << accumulate_randomized << std::endl;
     		std::cout << "                              bc" <<  ": " << bc << std::endl;
     		std::cout << "                              tt" <<  ": " << tt << std::endl;
     		std::cout << "                            cell" <<  ": " << cell << std::endl;
@@ -3352,6 +3367,7 @@ namespace madness {
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::truncate_on_project;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::apply_randomize;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::project_randomize;
+    template <std::size_t NDIM> bool FunctionDefaults<NDIM>::accumulate_randomized;
     template <std::size_t NDIM> BoundaryConditions<NDIM> FunctionDefaults<NDIM>::bc;
     template <std::size_t NDIM> TensorType FunctionDefaults<NDIM>::tt;
     template <std::size_t NDIM> Tensor<double> FunctionDefaults<NDIM>::cell;
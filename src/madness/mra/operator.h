@@ -236,8 +236,24 @@ namespace madness {
             mTxmq(dimi, trans[0].r, dimk, w1, f.ptr(), trans[0].U, dimk);
 #endif
 
+            finish_transformation(dimk, trans, w1, w2, mufac, result);
+        }
+
+        /// accumulate into result the transformation of all but the first dimension
+
+        /// \c w1 holds the input transformed in the first dimension; \c w1 and
+        /// \c w2 are overwritten.
+        template <typename R>
+        void finish_transformation(long dimk,
+                                   const Transformation trans[NDIM],
+                                   R* restrict w1,
+                                   R* restrict w2,
+                                   const Q mufac,
+                                   Tensor<R>& result) const {
+            long size = 1;
+            for (std::size_t i=0; i<NDIM; ++i) size *= dimk;
             size = trans[0].r * size / dimk;
-            dimi = size/dimk;
+            long dimi = size/dimk;
             for (std::size_t d=1; d<NDIM; ++d) {
 #ifdef HAVE_IBMBGQ
                 mTxmq_padding(dimi, trans[d].r, dimk, dimk, w2, w1, trans[d].U);
@@ -352,6 +368,44 @@ namespace madness {
         }
 
 
+        /// Chooses the full or the low rank 1D blocks of the R or T part of one term
+
+        /// Blocks whose numerical rank at \c tol (relative to the norm of
+        /// the term) is below the break even point are applied in SVD form.
+        /// @return false if the rank in some dimension is zero so the term can be skipped
+        bool select_transformation(bool r_term, const ConvolutionData1D<Q>* const ops_1d[NDIM],
+                                   double tol, Transformation trans[NDIM]) const {
+            long dimk = k;
+            if (r_term and not modified()) dimk = 2*k;
+
+            long break_even;
+            if (NDIM==1) break_even = long(0.5*dimk);
+            else if (NDIM==2) break_even = long(0.6*dimk);
+            else if (NDIM==3) break_even=long(0.65*dimk);
+            else break_even=long(0.7*dimk);
+            for (std::size_t d=0; d<NDIM; ++d) {
+                const ConvolutionData1D<Q>& op1d = *ops_1d[d];
+                const Tensor<typename Tensor<Q>::scalar_type>& s = r_term ? op1d.Rs : op1d.Ts;
+                long r;
+                for (r=0; r<dimk; ++r) {
+                    if (s[r] < tol) break;
+                }
+                if (r >= break_even) {
+                    trans[d].r = dimk;
+                    trans[d].U = (r_term ? op1d.R : op1d.T).ptr();
+                    trans[d].VT = 0;
+                }
+                else {
+                    //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
+                    if (r == 0) return false;
+                    trans[d].r = r;
+                    trans[d].U = (r_term ? op1d.RU : op1d.TU).ptr();
+                    trans[d].VT = (r_term ? op1d.RVT : op1d.TVT).ptr();
+                }
+            }
+            return true;
+        }
+
         /// Apply one of the separated terms, accumulating into the result
         template <typename T>
         void muopxv_fast(ApplyTerms at,
@@ -366,7 +420,6 @@ namespace madness {
 
             //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
             Transformation trans[NDIM];
-            Tensor<T> trans2[NDIM];
 
             double Rnorm = 1.0;
             for (std::size_t d=0; d<NDIM; ++d) Rnorm *= ops_1d[d]->Rnorm;
@@ -379,40 +432,8 @@ namespace madness {
                 long twok = 2*k;
                 if (modified()) twok=k;
 
-                long break_even;
-                if (NDIM==1) break_even = long(0.5*twok);
-                else if (NDIM==2) break_even = long(0.6*twok);
-                else if (NDIM==3) break_even=long(0.65*twok);
-                else break_even=long(0.7*twok);
-                bool rank_is_zero = false;
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    long r;
-                    for (r=0; r<twok; ++r) {
-                        if (ops_1d[d]->Rs[r] < tol) break;
-                    }
-                    if (r >= break_even) {
-                        trans[d].r = twok;
-                        trans[d].U = ops_1d[d]->R.ptr();
-                        trans[d].VT = 0;
-                    }
-                    else {
-                        //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
-                        if (r == 0) {
-                            rank_is_zero = true;
-                            break;
-                        }
-                        trans[d].r = r;
-                        trans[d].U = ops_1d[d]->RU.ptr();
-                        trans[d].VT = ops_1d[d]->RVT.ptr();
-                    }
-                    trans2[d]=ops_1d[d]->R;
-                }
-
-                if (!rank_is_zero)
+                if (select_transformation(true, ops_1d, tol, trans))
                     apply_transformation(twok, trans, f, work1, work2, mufac, result);
-
-                //            apply_transformation2(n, twok, tol, trans2, f, work1, work2, mufac, result);
-//                apply_transformation3(trans2, f, mufac, result);
             }
 
             double Tnorm = 1.0;
@@ -421,42 +442,11 @@ namespace madness {
             if (at.t_term and (Tnorm>0.0)) {
                 tol = tol/(Tnorm*NDIM);  // Errors are relative within here
 
-                long break_even;
-                if (NDIM==1) break_even = long(0.5*k);
-                else if (NDIM==2) break_even = long(0.6*k);
-                else if (NDIM==3) break_even=long(0.65*k);
-                else break_even=long(0.7*k);
-                bool rank_is_zero = false;
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    long r;
-                    for (r=0; r<k; ++r) {
-                        if (ops_1d[d]->Ts[r] < tol) break;
-                    }
-                    if (r >= break_even) {
-                        trans[d].r = k;
-                        trans[d].U = ops_1d[d]->T.ptr();
-                        trans[d].VT = 0;
-                    }
-                    else {
-                        //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
-                        if (r == 0) {
-                            rank_is_zero = true;
-                            break;
-                        }
-                        trans[d].r = r;
-                        trans[d].U = ops_1d[d]->TU.ptr();
-                        trans[d].VT = ops_1d[d]->TVT.ptr();
-                    }
-                    trans2[d]=ops_1d[d]->T;
-                }
-                if (!rank_is_zero)
+                if (select_transformation(false, ops_1d, tol, trans))
                     apply_transformation(k, trans, f0, work1, work2, -mufac, result0);
-//                apply_transformation2(n, k, tol, trans2, f0, work1, work2, -mufac, result0);
-//                apply_transformation3(trans2, f0, -mufac, result0);
             }
         }
 
-
         /// Apply one of the separated terms, accumulating into the result
         template <typename T>
         void muopxv_fast2(Level n,
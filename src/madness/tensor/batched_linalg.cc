@@ -0,0 +1,465 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/batched_linalg.cc
+/// \brief Eigen-, singular value and QR decompositions of many small matrices at once
+
+#include <madness/tensor/tensor_lapack.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+
+#include <immintrin.h>
+
+#define BATCHED_NS batched_avx2
+#define BATCHED_TARGET __attribute__((target("avx2,fma")))
+#define BATCHED_AVX2
+#include <madness/tensor/batched_linalg_kernels.h>
+#undef BATCHED_AVX2
+#undef BATCHED_TARGET
+#undef BATCHED_NS
+
+#define BATCHED_NS batched_avx512
+#define BATCHED_TARGET __attribute__((target("avx512f,avx2,fma")))
+#define BATCHED_AVX512
+#include <madness/tensor/batched_linalg_kernels.h>
+#undef BATCHED_AVX512
+#undef BATCHED_TARGET
+#undef BATCHED_NS
+
+#endif // MADNESS_HAVE_MTXMQ_SIMD
+
+namespace madness {
+
+    namespace {
+
+        /// The batched kernels of one instruction set; \c lanes is zero for the LAPACK loop
+        struct BatchedKernels {
+            long lanes;
+            void (*syev)(long n, double* a, double* v);
+            void (*svd)(long m, long n, double* g, double* v);
+            void (*qr)(long m, long n, double* a, double* q);
+        };
+
+        // Largest matrices handed to the kernels; Jacobi loses to LAPACK beyond these
+        const long syev_max_n = 24;
+        const long svd_max_n = 32;
+        const long svd_max_m = 256;
+        const long qr_max_n = 64;
+
+        MTxmqISA detect_isa() {
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return MTXMQ_ISA_AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return MTXMQ_ISA_AVX2;
+#endif
+            return MTXMQ_ISA_REFERENCE;
+        }
+
+        // Selected during static initialization (see mtxmq_simd.cc)
+        MTxmqISA best_isa = MTXMQ_ISA_REFERENCE;
+        MTxmqISA current_isa = MTXMQ_ISA_REFERENCE;
+        BatchedKernels kernels = {0, 0, 0, 0};
+
+        void select_isa(MTxmqISA isa) {
+            if (isa > best_isa) isa = best_isa;
+            BatchedKernels k = {0, 0, 0, 0};
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+            if (isa == MTXMQ_ISA_AVX2) {
+                BatchedKernels t = {batched_avx2::W, batched_avx2::syev_lanes,
+                                    batched_avx2::svd_lanes, batched_avx2::qr_lanes};
+                k = t;
+            }
+            else if (isa == MTXMQ_ISA_AVX512) {
+                BatchedKernels t = {batched_avx512::W, batched_avx512::syev_lanes,
+                                    batched_avx512::svd_lanes, batched_avx512::qr_lanes};
+                k = t;
+            }
+#endif
+            kernels = k;
+            current_isa = isa;
+        }
+
+        struct BatchedLinalgInit {
+            BatchedLinalgInit() {
+                best_isa = detect_isa();
+                MTxmqISA isa = best_isa;
+                const char* s = std::getenv("MAD_BATCHED_LINALG_ISA");
+                if (s) {
+                    if (std::strcmp(s, "reference") == 0) isa = MTXMQ_ISA_REFERENCE;
+                    else if (std::strcmp(s, "avx2") == 0) isa = MTXMQ_ISA_AVX2;
+                    else if (std::strcmp(s, "avx512") == 0) isa = MTXMQ_ISA_AVX512;
+                }
+                select_isa(isa);
+            }
+        } batched_linalg_init;
+
+        /// Chunks of up to \c lanes matrices decomposed by one kernel call
+
+        /// The matrices are sorted by size.  With \c pad a chunk mixes sizes and
+        /// the smaller matrices are padded with zeros, which the Jacobi kernels
+        /// never rotate into the rest of the matrix; otherwise a chunk holds a
+        /// single shape.  A chunk runs at the cost of \c lanes matrices of its
+        /// largest size, so it is left to LAPACK unless at least
+        /// max(2, size*lanes/\c cost_lanes) of the lanes are used.  A
+        /// lone matrix is never worth a chunk: with AVX-512 a chunk of 4x4
+        /// eigenproblems takes 8 us against 4.7 us for LAPACK on one.  Pass
+        /// matrices from several tensors in one call to fill the lanes.
+        class LaneChunks {
+            struct Item {
+                long size, other, i;
+                bool operator<(const Item& b) const {
+                    return (size < b.size) || (size == b.size && other < b.other);
+                }
+            };
+            std::vector<Item> items;
+        public:
+            void add(long size, long other, long i) {
+                Item item = {size, other, i};
+                items.push_back(item);
+            }
+
+            /// Calls op(idx, nvalid) for each chunk and sets done[i] for the matrices in it
+
+            /// \c idx is filled up to \c lanes by repeating the last matrix of the chunk
+            template <typename opT>
+            void run(long lanes, bool pad, long cost_lanes, opT& op, std::vector<bool>& done) {
+                std::sort(items.begin(), items.end());
+                std::vector<long> idx(lanes);
+                size_t c = 0;
+                while (c < items.size()) {
+                    size_t e = c+1;
+                    while (e < items.size() && long(e-c) < lanes &&
+                           (pad || (items[e].size == items[c].size && items[e].other == items[c].other))) ++e;
+                    const long nvalid = e-c;
+                    if (nvalid >= 2 && nvalid*cost_lanes >= items[e-1].size*lanes) {
+                        for (long l=0; l<lanes; ++l) idx[l] = items[c + std::min(l, nvalid-1)].i;
+                        op(idx, nvalid);
+                        for (size_t k=c; k<e; ++k) done[items[k].i] = true;
+                    }
+                    c = e;
+                }
+            }
+        };
+
+        /// Chunk operation for syev_batched
+        struct SyevChunk {
+            const std::vector< Tensor<double> >& A;
+            std::vector< Tensor<double> >& V;
+            std::vector< Tensor<double> >& e;
+            std::vector<double> a, v;
+
+            SyevChunk(const std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& V,
+                      std::vector< Tensor<double> >& e) : A(A), V(V), e(e) {}
+
+            void operator()(const std::vector<long>& idx, long nvalid) {
+                const long W = idx.size();
+                long N = 0;
+                for (long l=0; l<W; ++l) N = std::max(N, A[idx[l]].dim(0));
+                a.assign(N*N*W, 0.0);
+                v.resize(N*N*W);
+                for (long l=0; l<W; ++l) {
+                    const Tensor<double>& t = A[idx[l]];
+                    const long n = t.dim(0);
+                    for (long i=0; i<n; ++i)
+                        for (long j=0; j<n; ++j) a[(i*N+j)*W+l] = 0.5*(t(i,j) + t(j,i));
+                }
+                kernels.syev(N, &a[0], &v[0]);
+
+                std::vector< std::pair<double,long> > order;
+                for (long l=0; l<nvalid; ++l) {
+                    const long n = A[idx[l]].dim(0);
+                    order.resize(n);
+                    for (long k=0; k<n; ++k) order[k] = std::make_pair(a[(k*N+k)*W+l], k);
+                    std::sort(order.begin(), order.end());
+                    Tensor<double> ee(n), vv(n,n);
+                    for (long k=0; k<n; ++k) {
+                        ee(k) = order[k].first;
+                        for (long i=0; i<n; ++i) vv(i,k) = v[(i*N+order[k].second)*W+l];
+                    }
+                    e[idx[l]] = ee;
+                    V[idx[l]] = vv;
+                }
+            }
+        };
+
+        /// Chunk operation for svd_batched
+        struct SvdChunk {
+            const std::vector< Tensor<double> >& A;
+            std::vector< Tensor<double> >& U;
+            std::vector< Tensor<double> >& s;
+            std::vector< Tensor<double> >& VT;
+            std::vector<double> g, v;
+
+            SvdChunk(const std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& U,
+                     std::vector< Tensor<double> >& s, std::vector< Tensor<double> >& VT)
+                : A(A), U(U), s(s), VT(VT) {}
+
+            void operator()(const std::vector<long>& idx, long nvalid) {
+                const long W = idx.size();
+                // Work with B = A or A^T so that B is (m,n) with m >= n
+                long M = 0, N = 0;
+                for (long l=0; l<W; ++l) {
+                    M = std::max(M, std::max(A[idx[l]].dim(0), A[idx[l]].dim(1)));
+                    N = std::max(N, std::min(A[idx[l]].dim(0), A[idx[l]].dim(1)));
+                }
+                g.assign(M*N*W, 0.0);
+                v.resize(N*N*W);
+                for (long l=0; l<W; ++l) {
+                    const Tensor<double>& t = A[idx[l]];
+                    const long m0 = t.dim(0), n0 = t.dim(1);
+                    const bool trans = m0 < n0;
+                    for (long i=0; i<m0; ++i) {
+                        for (long j=0; j<n0; ++j) {
+                            const long ib = trans ? j : i, jb = trans ? i : j;
+                            g[(jb*M+ib)*W+l] = t(i,j);
+                        }
+                    }
+                }
+                kernels.svd(M, N, &g[0], &v[0]);
+
+                std::vector< std::pair<double,long> > order;
+                for (long l=0; l<nvalid; ++l) {
+                    const long m0 = A[idx[l]].dim(0), n0 = A[idx[l]].dim(1);
+                    const bool trans = m0 < n0;
+                    const long m = trans ? n0 : m0;
+                    const long n = trans ? m0 : n0;
+                    order.resize(n);
+                    for (long k=0; k<n; ++k) {
+                        double norm2 = 0.0;
+                        for (long i=0; i<m; ++i) norm2 += g[(k*M+i)*W+l]*g[(k*M+i)*W+l];
+                        order[k] = std::make_pair(-std::sqrt(norm2), k);
+                    }
+                    std::sort(order.begin(), order.end());
+
+                    // Left singular vectors of B; columns with a zero singular
+                    // value are completed to an orthonormal set
+                    Tensor<double> ub(m,n), ss(n);
+                    for (long k=0; k<n; ++k) {
+                        const double sigma = -order[k].first;
+                        ss(k) = sigma;
+                        if (sigma > 0.0) {
+                            for (long i=0; i<m; ++i) ub(i,k) = g[(order[k].second*M+i)*W+l]/sigma;
+                            continue;
+                        }
+                        for (long e=0; e<m; ++e) {
+                            Tensor<double> x(m);
+                            x(e) = 1.0;
+                            for (int pass=0; pass<2; ++pass) {
+                                for (long c=0; c<k; ++c) {
+                                    double d = 0.0;
+                                    for (long i=0; i<m; ++i) d += ub(i,c)*x(i);
+                                    for (long i=0; i<m; ++i) x(i) -= d*ub(i,c);
+                                }
+                            }
+                            const double norm = x.normf();
+                            if (norm > 0.5) {
+                                for (long i=0; i<m; ++i) ub(i,k) = x(i)/norm;
+                                break;
+                            }
+                        }
+                    }
+
+                    Tensor<double> uu, vt;
+                    if (!trans) {
+                        uu = ub;
+                        vt = Tensor<double>(n,n);
+                        for (long k=0; k<n; ++k)
+                            for (long j=0; j<n; ++j) vt(k,j) = v[(j*N+order[k].second)*W+l];
+                    }
+                    else {
+                        // A = B^T = V diag(s) U_B^T
+                        uu = Tensor<double>(n,n);
+                        for (long i=0; i<n; ++i)
+                            for (long k=0; k<n; ++k) uu(i,k) = v[(i*N+order[k].second)*W+l];
+                        vt = transpose(ub);
+                    }
+                    U[idx[l]] = uu;
+                    s[idx[l]] = ss;
+                    VT[idx[l]] = vt;
+                }
+            }
+        };
+
+        /// Chunk operation for qr_batched
+        struct QrChunk {
+            std::vector< Tensor<double> >& A;
+            std::vector< Tensor<double> >& R;
+            std::vector<double> a, q;
+
+            QrChunk(std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& R) : A(A), R(R) {}
+
+            void operator()(const std::vector<long>& idx, long nvalid) {
+                const long W = idx.size();
+                const long m = A[idx[0]].dim(0), n = A[idx[0]].dim(1);
+                const long k = std::min(m,n);
+                a.resize(m*n*W);
+                q.resize(m*k*W);
+                for (long l=0; l<W; ++l) {
+                    const Tensor<double>& t = A[idx[l]];
+                    for (long i=0; i<m; ++i)
+                        for (long j=0; j<n; ++j) a[(j*m+i)*W+l] = t(i,j);
+                }
+                kernels.qr(m, n, &a[0], &q[0]);
+
+                for (long l=0; l<nvalid; ++l) {
+                    Tensor<double> qq(m,k), rr(k,n);
+                    for (long i=0; i<m; ++i)
+                        for (long j=0; j<k; ++j) qq(i,j) = q[(j*m+i)*W+l];
+                    for (long i=0; i<k; ++i)
+                        for (long j=i; j<n; ++j) rr(i,j) = a[(j*m+i)*W+l];
+                    A[idx[l]] = qq;
+                    R[idx[l]] = rr;
+                }
+            }
+        };
+
+        // Only real double precision matrices have kernels; the others are left to LAPACK
+
+        template <typename T>
+        void syev_kernels(const std::vector< Tensor<T> >&, std::vector< Tensor<T> >&,
+                          std::vector< Tensor<typename Tensor<T>::scalar_type> >&, std::vector<bool>&) {}
+
+        void syev_kernels(const std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& V,
+                          std::vector< Tensor<double> >& e, std::vector<bool>& done) {
+            if (!kernels.lanes) return;
+            LaneChunks chunks;
+            for (size_t i=0; i<A.size(); ++i) {
+                const long n = A[i].dim(0);
+                if (n >= 2 && n <= syev_max_n) chunks.add(n, n, i);
+            }
+            SyevChunk op(A, V, e);
+            chunks.run(kernels.lanes, true, 32, op, done);
+        }
+
+        template <typename T>
+        void svd_kernels(const std::vector< Tensor<T> >&, std::vector< Tensor<T> >&,
+                         std::vector< Tensor<typename Tensor<T>::scalar_type> >&,
+                         std::vector< Tensor<T> >&, std::vector<bool>&) {}
+
+        void svd_kernels(const std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& U,
+                         std::vector< Tensor<double> >& s, std::vector< Tensor<double> >& VT,
+                         std::vector<bool>& done) {
+            if (!kernels.lanes) return;
+            LaneChunks chunks;
+            for (size_t i=0; i<A.size(); ++i) {
+                const long m = std::max(A[i].dim(0), A[i].dim(1)), n = std::min(A[i].dim(0), A[i].dim(1));
+                if (n >= 1 && n <= svd_max_n && m <= svd_max_m) chunks.add(n, m, i);
+            }
+            SvdChunk op(A, U, s, VT);
+            chunks.run(kernels.lanes, true, 32, op, done);
+        }
+
+        template <typename T>
+        void qr_kernels(std::vector< Tensor<T> >&, std::vector< Tensor<T> >&, std::vector<bool>&) {}
+
+        void qr_kernels(std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& R,
+                        std::vector<bool>& done) {
+            if (!kernels.lanes) return;
+            LaneChunks chunks;
+            for (size_t i=0; i<A.size(); ++i) {
+                const long m = A[i].dim(0), n = A[i].dim(1);
+                if (std::min(m,n) >= 1 && std::min(m,n) <= qr_max_n) chunks.add(std::min(m,n), (m<<20) + n, i);
+            }
+            QrChunk op(A, R);
+            chunks.run(kernels.lanes, false, 64, op, done);
+        }
+
+    } // namespace
+
+    MTxmqISA batched_linalg_isa() {
+        return current_isa;
+    }
+
+    MTxmqISA batched_linalg_set_isa(MTxmqISA isa) {
+        select_isa(isa);
+        return current_isa;
+    }
+
+    template <typename T>
+    void syev_batched(const std::vector< Tensor<T> >& A, std::vector< Tensor<T> >& V,
+                      std::vector< Tensor<typename Tensor<T>::scalar_type> >& e) {
+        for (size_t i=0; i<A.size(); ++i) {
+            TENSOR_ASSERT(A[i].ndim() == 2, "syev_batched requires matrices", A[i].ndim(), &A[i]);
+            TENSOR_ASSERT(A[i].dim(0) == A[i].dim(1), "syev_batched requires square matrices", i, &A[i]);
+        }
+        V.resize(A.size());
+        e.resize(A.size());
+        std::vector<bool> done(A.size(), false);
+        syev_kernels(A, V, e, done);
+        for (size_t i=0; i<A.size(); ++i) if (!done[i]) syev(A[i], V[i], e[i]);
+    }
+
+    template <typename T>
+    void svd_batched(const std::vector< Tensor<T> >& A, std::vector< Tensor<T> >& U,
+                     std::vector< Tensor<typename Tensor<T>::scalar_type> >& s, std::vector< Tensor<T> >& VT) {
+        for (size_t i=0; i<A.size(); ++i)
+            TENSOR_ASSERT(A[i].ndim() == 2, "svd_batched requires matrices", A[i].ndim(), &A[i]);
+        U.resize(A.size());
+        s.resize(A.size());
+        VT.resize(A.size());
+        std::vector<bool> done(A.size(), false);
+        svd_kernels(A, U, s, VT, done);
+        for (size_t i=0; i<A.size(); ++i) if (!done[i]) svd(A[i], U[i], s[i], VT[i]);
+    }
+
+    template <typename T>
+    void qr_batched(std::vector< Tensor<T> >& A, std::vector< Tensor<T> >& R) {
+        for (size_t i=0; i<A.size(); ++i)
+            TENSOR_ASSERT(A[i].ndim() == 2, "qr_batched requires matrices", A[i].ndim(), &A[i]);
+        R.resize(A.size());
+        std::vector<bool> done(A.size(), false);
+        qr_kernels(A, R, done);
+        for (size_t i=0; i<A.size(); ++i) if (!done[i]) qr(A[i], R[i]);
+    }
+
+    template
+    void syev_batched(const std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& V,
+                      std::vector< Tensor<double> >& e);
+    template
+    void syev_batched(const std::vector< Tensor<double_complex> >& A, std::vector< Tensor<double_complex> >& V,
+                      std::vector< Tensor<double> >& e);
+
+    template
+    void svd_batched(const std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& U,
+                     std::vector< Tensor<double> >& s, std::vector< Tensor<double> >& VT);
+    template
+    void svd_batched(const std::vector< Tensor<double_complex> >& A, std::vector< Tensor<double_complex> >& U,
+                     std::vector< Tensor<double> >& s, std::vector< Tensor<double_complex> >& VT);
+
+    template
+    void qr_batched(std::vector< Tensor<double> >& A, std::vector< Tensor<double> >& R);
+
+} // namespace madness
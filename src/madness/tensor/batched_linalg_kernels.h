@@ -0,0 +1,310 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/batched_linalg_kernels.h
+/// \brief Internal use only ... Jacobi eigensolver, Jacobi SVD and Householder QR for W small matrices at once
+
+// This file is included by batched_linalg.cc once per instruction set with
+// BATCHED_NS (namespace), BATCHED_TARGET (function attributes) and one of
+// BATCHED_AVX2 or BATCHED_AVX512 defined.  Don't include it anywhere else.
+//
+// Each kernel works on W matrices of the same shape stored lane
+// interleaved, i.e., element e of matrix l is at p[e*W+l], so that one
+// SIMD register holds the same element of all W matrices and the
+// algorithms run without any shuffles.  Rotations that are not needed in
+// some lanes are made the identity in those lanes, and a loop stops when
+// it is done in all lanes.
+//
+//   syev   cyclic Jacobi with the rotation skipped if |a(p,q)| is below
+//          eps*sqrt(|a(p,p)*a(q,q)|), until a sweep makes no rotation.
+//   svd    one-sided (Hestenes) Jacobi on the columns with the same test
+//          applied to the column overlaps, m >= n.
+//   qr     Householder reflections, then the thin Q by backward accumulation.
+
+namespace BATCHED_NS {
+
+#define BATCHED_INLINE static inline __attribute__((always_inline)) BATCHED_TARGET
+
+#if defined(BATCHED_AVX2)
+
+    typedef __m256d vec;
+    typedef __m256d mask;
+    const int W = 4;
+
+    BATCHED_INLINE vec vset(double x) { return _mm256_set1_pd(x); }
+    BATCHED_INLINE vec vload(const double* p) { return _mm256_loadu_pd(p); }
+    BATCHED_INLINE void vstore(double* p, vec v) { _mm256_storeu_pd(p, v); }
+    BATCHED_INLINE vec vadd(vec a, vec b) { return _mm256_add_pd(a, b); }
+    BATCHED_INLINE vec vsub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+    BATCHED_INLINE vec vmul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+    BATCHED_INLINE vec vdiv(vec a, vec b) { return _mm256_div_pd(a, b); }
+    BATCHED_INLINE vec vsqrt(vec a) { return _mm256_sqrt_pd(a); }
+    /// a*b + c
+    BATCHED_INLINE vec vfma(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+    /// c - a*b
+    BATCHED_INLINE vec vfnma(vec a, vec b, vec c) { return _mm256_fnmadd_pd(a, b, c); }
+    BATCHED_INLINE vec vabs(vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    /// a with the sign of b
+    BATCHED_INLINE vec vcopysign(vec a, vec b) {
+        const vec sign = _mm256_set1_pd(-0.0);
+        return _mm256_or_pd(_mm256_andnot_pd(sign, a), _mm256_and_pd(sign, b));
+    }
+    BATCHED_INLINE mask vgt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    BATCHED_INLINE mask vand(mask a, mask b) { return _mm256_and_pd(a, b); }
+    /// m ? a : b
+    BATCHED_INLINE vec vselect(mask m, vec a, vec b) { return _mm256_blendv_pd(b, a, m); }
+    /// One bit per element set in m
+    BATCHED_INLINE int vbits(mask m) { return _mm256_movemask_pd(m); }
+
+#elif defined(BATCHED_AVX512)
+
+    typedef __m512d vec;
+    typedef __mmask8 mask;
+    const int W = 8;
+
+    BATCHED_INLINE vec vset(double x) { return _mm512_set1_pd(x); }
+    BATCHED_INLINE vec vload(const double* p) { return _mm512_loadu_pd(p); }
+    BATCHED_INLINE void vstore(double* p, vec v) { _mm512_storeu_pd(p, v); }
+    BATCHED_INLINE vec vadd(vec a, vec b) { return _mm512_add_pd(a, b); }
+    BATCHED_INLINE vec vsub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+    BATCHED_INLINE vec vmul(vec a, vec b) { return _mm512_mul_pd(a, b); }
+    BATCHED_INLINE vec vdiv(vec a, vec b) { return _mm512_div_pd(a, b); }
+    BATCHED_INLINE vec vsqrt(vec a) { return _mm512_sqrt_pd(a); }
+    BATCHED_INLINE vec vfma(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+    BATCHED_INLINE vec vfnma(vec a, vec b, vec c) { return _mm512_fnmadd_pd(a, b, c); }
+    // The floating point logical operations need AVX-512DQ
+    BATCHED_INLINE vec vabs(vec a) {
+        return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a),
+                                                    _mm512_set1_epi64(0x7fffffffffffffffLL)));
+    }
+    BATCHED_INLINE vec vcopysign(vec a, vec b) {
+        const __m512i sign = _mm512_set1_epi64(0x8000000000000000LL);
+        return _mm512_castsi512_pd(_mm512_or_si512(_mm512_andnot_si512(sign, _mm512_castpd_si512(a)),
+                                                   _mm512_and_si512(sign, _mm512_castpd_si512(b))));
+    }
+    BATCHED_INLINE mask vgt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    BATCHED_INLINE mask vand(mask a, mask b) { return mask(a & b); }
+    BATCHED_INLINE vec vselect(mask m, vec a, vec b) { return _mm512_mask_blend_pd(m, b, a); }
+    BATCHED_INLINE int vbits(mask m) { return int(m); }
+
+#endif
+
+    const double EPS = 2.220446049250313e-16;
+    const double TINY = 2.2250738585072014e-308;
+
+    /// The rotation (c,s) with t = tan = sign(zeta)/(|zeta| + sqrt(1+zeta^2)), identity where \c m is not set
+    BATCHED_INLINE void vrotation(mask m, vec zeta, vec& c, vec& s) {
+        const vec one = vset(1.0);
+        vec t = vdiv(one, vadd(vabs(zeta), vsqrt(vfma(zeta, zeta, one))));
+        t = vcopysign(t, zeta);
+        c = vdiv(one, vsqrt(vfma(t, t, one)));
+        s = vmul(t, c);
+        c = vselect(m, c, one);
+        s = vselect(m, s, vset(0.0));
+    }
+
+    /// (x,y) <- (c*x - s*y, s*x + c*y) for n elements with strides \c incx and \c incy (in vectors)
+    BATCHED_INLINE void vrotate(long n, double* x, long incx, double* y, long incy, vec c, vec s) {
+        for (long i=0; i<n; ++i) {
+            const vec xi = vload(x + i*incx*W);
+            const vec yi = vload(y + i*incy*W);
+            vstore(x + i*incx*W, vfnma(s, yi, vmul(c, xi)));
+            vstore(y + i*incy*W, vfma(s, xi, vmul(c, yi)));
+        }
+    }
+
+    /// Eigenvalues and vectors of W symmetric matrices a(n,n)
+
+    /// On exit the diagonal of \c a holds the (unsorted) eigenvalues and the
+    /// columns of \c v(n,n) the eigenvectors.
+    BATCHED_TARGET
+    void syev_lanes(long n, double* a, double* v) {
+        const vec zero = vset(0.0);
+        for (long i=0; i<n*n; ++i) vstore(v + i*W, zero);
+        for (long i=0; i<n; ++i) vstore(v + (i*n+i)*W, vset(1.0));
+
+        // Rotations much below the norm of the matrix do not change the result
+        vec norm2 = zero;
+        for (long i=0; i<n*n; ++i) {
+            const vec x = vload(a + i*W);
+            norm2 = vfma(x, x, norm2);
+        }
+        const vec floor = vmul(vset(1e-3*EPS), vsqrt(norm2));
+        const vec tol = vset(EPS);
+
+        for (int sweep=0; sweep<50; ++sweep) {
+            int rotated = 0;
+            for (long p=0; p<n-1; ++p) {
+                for (long q=p+1; q<n; ++q) {
+                    const vec apq = vload(a + (p*n+q)*W);
+                    const vec app = vload(a + (p*n+p)*W);
+                    const vec aqq = vload(a + (q*n+q)*W);
+                    const vec aapq = vabs(apq);
+                    const mask m = vand(vgt(aapq, vmul(tol, vsqrt(vabs(vmul(app, aqq))))),
+                                        vgt(aapq, floor));
+                    if (!vbits(m)) continue;
+                    rotated = 1;
+
+                    // theta = (a(q,q)-a(p,p))/(2*a(p,q)) is finite where m is set
+                    const vec theta = vdiv(vsub(aqq, app), vadd(apq, apq));
+                    vec c, s;
+                    vrotation(m, theta, c, s);
+                    const vec t = vselect(m, vdiv(s, c), zero);
+
+                    vstore(a + (p*n+p)*W, vfnma(t, apq, app));
+                    vstore(a + (q*n+q)*W, vfma(t, apq, aqq));
+                    const vec apq_new = vselect(m, zero, apq);
+                    vstore(a + (p*n+q)*W, apq_new);
+                    vstore(a + (q*n+p)*W, apq_new);
+
+                    // Columns p and q, then mirror into rows p and q
+                    for (long r=0; r<n; ++r) {
+                        if (r == p || r == q) continue;
+                        const vec g = vload(a + (r*n+p)*W);
+                        const vec h = vload(a + (r*n+q)*W);
+                        const vec gp = vfnma(s, h, vmul(c, g));
+                        const vec hq = vfma(s, g, vmul(c, h));
+                        vstore(a + (r*n+p)*W, gp);
+                        vstore(a + (p*n+r)*W, gp);
+                        vstore(a + (r*n+q)*W, hq);
+                        vstore(a + (q*n+r)*W, hq);
+                    }
+                    vrotate(n, v + p*W, n, v + q*W, n, c, s);
+                }
+            }
+            if (!rotated) break;
+        }
+    }
+
+    /// One-sided Jacobi SVD of W matrices g(m,n) stored by columns, m >= n
+
+    /// On exit the columns of \c g are U*diag(s) (orthogonal but unnormalized
+    /// and unsorted) and \c v(n,n) holds V with A = U*diag(s)*V^T.
+    BATCHED_TARGET
+    void svd_lanes(long m, long n, double* g, double* v) {
+        const vec zero = vset(0.0);
+        for (long i=0; i<n*n; ++i) vstore(v + i*W, zero);
+        for (long i=0; i<n; ++i) vstore(v + (i*n+i)*W, vset(1.0));
+
+        const vec tol = vset(EPS*m);
+        const vec floor = vset(TINY);
+
+        for (int sweep=0; sweep<50; ++sweep) {
+            int rotated = 0;
+            for (long p=0; p<n-1; ++p) {
+                double* gp = g + p*m*W;
+                for (long q=p+1; q<n; ++q) {
+                    double* gq = g + q*m*W;
+                    vec alpha = zero, beta = zero, gamma = zero;
+                    for (long i=0; i<m; ++i) {
+                        const vec x = vload(gp + i*W);
+                        const vec y = vload(gq + i*W);
+                        alpha = vfma(x, x, alpha);
+                        beta = vfma(y, y, beta);
+                        gamma = vfma(x, y, gamma);
+                    }
+                    const vec agamma = vabs(gamma);
+                    const mask mrot = vand(vgt(agamma, vmul(tol, vmul(vsqrt(alpha), vsqrt(beta)))),
+                                           vgt(agamma, floor));
+                    if (!vbits(mrot)) continue;
+                    rotated = 1;
+
+                    const vec zeta = vdiv(vsub(beta, alpha), vadd(gamma, gamma));
+                    vec c, s;
+                    vrotation(mrot, zeta, c, s);
+                    vrotate(m, gp, 1, gq, 1, c, s);
+                    vrotate(n, v + p*W, n, v + q*W, n, c, s);
+                }
+            }
+            if (!rotated) break;
+        }
+    }
+
+    /// Householder QR of W matrices a(m,n) stored by columns
+
+    /// On exit the upper triangle of \c a holds R and \c q(m,k) with k=min(m,n),
+    /// stored by columns, the thin Q.
+    BATCHED_TARGET
+    void qr_lanes(long m, long n, double* a, double* q) {
+        const vec zero = vset(0.0);
+        const long k = (m < n) ? m : n;
+        // tau and the leading element of each reflector; the rest is kept below the diagonal of a
+        std::vector<double> tau(k*W), vlead(k*W);
+
+        for (long j=0; j<k; ++j) {
+            double* aj = a + (j*m)*W;
+            vec norm2 = zero;
+            for (long i=j; i<m; ++i) {
+                const vec x = vload(aj + i*W);
+                norm2 = vfma(x, x, norm2);
+            }
+            // alpha = -sign(x0)*|x|, v = x - alpha*e_j, H = I - tau*v*v^T
+            const vec x0 = vload(aj + j*W);
+            const vec alpha = vcopysign(vsqrt(norm2), vsub(zero, x0));
+            const vec v0 = vsub(x0, alpha);
+            const vec vnorm2 = vfma(v0, v0, vfnma(x0, x0, norm2));
+            const vec t = vselect(vgt(vnorm2, zero), vdiv(vset(2.0), vnorm2), zero);
+            vstore(&tau[j*W], t);
+            vstore(&vlead[j*W], v0);
+            vstore(aj + j*W, v0);
+
+            for (long c=j+1; c<n; ++c) {
+                double* ac = a + (c*m)*W;
+                vec w = zero;
+                for (long i=j; i<m; ++i) w = vfma(vload(aj + i*W), vload(ac + i*W), w);
+                w = vmul(w, t);
+                for (long i=j; i<m; ++i) vstore(ac + i*W, vfnma(w, vload(aj + i*W), vload(ac + i*W)));
+            }
+            vstore(aj + j*W, alpha);
+        }
+
+        // Q = H(0)...H(k-1) applied to the first k columns of the identity; H(j)
+        // leaves the columns c<j untouched since they are still e_c
+        for (long i=0; i<m*k; ++i) vstore(q + i*W, zero);
+        for (long c=0; c<k; ++c) vstore(q + (c*m+c)*W, vset(1.0));
+        for (long j=k-1; j>=0; --j) {
+            const double* aj = a + (j*m)*W;
+            const vec t = vload(&tau[j*W]);
+            const vec v0 = vload(&vlead[j*W]);
+            for (long c=j; c<k; ++c) {
+                double* qc = q + (c*m)*W;
+                vec w = vmul(v0, vload(qc + j*W));
+                for (long i=j+1; i<m; ++i) w = vfma(vload(aj + i*W), vload(qc + i*W), w);
+                w = vmul(w, t);
+                vstore(qc + j*W, vfnma(w, v0, vload(qc + j*W)));
+                for (long i=j+1; i<m; ++i) vstore(qc + i*W, vfnma(w, vload(aj + i*W), vload(qc + i*W)));
+            }
+        }
+    }
+
+#undef BATCHED_INLINE
+
+} // namespace BATCHED_NS
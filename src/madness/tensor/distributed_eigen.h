@@ -0,0 +1,302 @@
+#ifndef MADNESS_DISTRIBUTED_EIGEN_H
+#define MADNESS_DISTRIBUTED_EIGEN_H
+
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/distributed_eigen.h
+/// \brief Parallel symmetric (generalized) eigensolver for distributed matrices
+
+#include <madness/world/MADworld.h>
+#include <madness/world/topology.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/distributed_matrix.h>
+#include <madness/tensor/distributed_gemm.h>
+#include <madness/tensor/systolic.h>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+namespace madness {
+
+    namespace detail {
+
+        /// One-sided block Jacobi for the symmetric eigenproblem as a systolic loop
+
+        /// Each row of the (n,2n) working matrix holds a vector and its
+        /// image under A, [v_i, A v_i], which start as the unit vectors
+        /// and the rows of A.  The loop pairs blocks of rows I and J and
+        /// for the rows K = I+J forms G = V_K (A V_K)^T, applies one
+        /// cyclic Jacobi sweep to it (Golub and Van Loan, Algorithm 8.4.3)
+        /// and then the accumulated rotation Q to both halves of the rows,
+        /// which keeps the second half the image of the first.  Both the
+        /// Gram matrix and the update are matrix products, and the loop
+        /// converges in fewer sweeps than rotating single pairs.  Solving
+        /// the subproblem to convergence does not save further sweeps.
+        /// Rows are never combined with anything but other rows, so the
+        /// loop needs only the row exchange of
+        /// \c SystolicBlockMatrixAlgorithm.  On convergence v_i are the
+        /// eigenvectors and v_i.Av_i the eigenvalues.
+        template <typename T>
+        class SystolicJacobiEigensolver : public SystolicBlockMatrixAlgorithm<T> {
+            const int64_t n;
+            const double thresh;        ///< Off-diagonal elements below this are not rotated
+            const int maxsweep;
+            int nsweep;
+            bool& converged_flag;
+            AtomicInt nrot;             ///< No. of blocks rotated in the current sweep
+
+            /// One cyclic Jacobi sweep over the symmetric (m,m) matrix g accumulating the rotations in the rows of q
+
+            /// Returns true if an off-diagonal element exceeded the threshold
+            bool sweep(Tensor<T>& g, Tensor<T>& q) const {
+                const int64_t m = g.dim(0);
+                T * restrict pg = g.ptr();
+                T * restrict pq = q.ptr();
+                bool rotated = false;
+                for (int64_t i=0; i<m; ++i) {
+                    for (int64_t j=i+1; j<m; ++j) {
+                        const T gij = pg[i*m+j];
+                        if (std::abs(gij) <= 0.01*thresh) continue;
+                        if (std::abs(gij) > thresh) rotated = true;
+
+                        // Golub and Van Loan, Algorithm 8.4.1 (sym.schur2)
+                        const T tau = (pg[j*m+j] - pg[i*m+i])/(2*gij);
+                        const T t = (tau >= 0 ? T(1) : T(-1))/(std::abs(tau) + std::sqrt(T(1) + tau*tau));
+                        const T c = T(1)/std::sqrt(T(1) + t*t);
+                        const T s = t*c;
+                        T * restrict gi = pg + i*m;
+                        T * restrict gj = pg + j*m;
+                        for (int64_t k=0; k<m; ++k) {
+                            const T x = gi[k], y = gj[k];
+                            gi[k] = c*x - s*y;
+                            gj[k] = s*x + c*y;
+                        }
+                        for (int64_t k=0; k<m; ++k) {
+                            const T x = pg[k*m+i], y = pg[k*m+j];
+                            pg[k*m+i] = c*x - s*y;
+                            pg[k*m+j] = s*x + c*y;
+                        }
+                        T * restrict qi = pq + i*m;
+                        T * restrict qj = pq + j*m;
+                        for (int64_t k=0; k<m; ++k) {
+                            const T x = qi[k], y = qj[k];
+                            qi[k] = c*x - s*y;
+                            qj[k] = s*x + c*y;
+                        }
+                    }
+                }
+                return rotated;
+            }
+
+        public:
+            SystolicJacobiEigensolver(DistributedMatrix<T>& W, double thresh, int maxsweep, bool& converged_flag, int nthread,
+                                      int64_t blocksize=16)
+                : SystolicBlockMatrixAlgorithm<T>(W, W.get_world().mpi.unique_tag(), blocksize, nthread)
+                , n(W.coldim())
+                , thresh(thresh)
+                , maxsweep(maxsweep)
+                , nsweep(0)
+                , converged_flag(converged_flag)
+            {
+                MADNESS_ASSERT(W.rowdim() == 2*n);
+                nrot = 0;
+                converged_flag = false;
+            }
+
+            void start_iteration_hook(const TaskThreadEnv& env) {
+                if (env.id() == 0) nrot = 0;
+            }
+
+            void end_iteration_hook(const TaskThreadEnv& env) {
+                if (env.id() == 0) {
+                    int nr = nrot;
+                    SystolicBlockMatrixAlgorithm<T>::get_world().gop.sum(nr);
+                    nrot = nr;
+                    ++nsweep;
+                    converged_flag = (nr == 0);
+                }
+            }
+
+            bool converged(const TaskThreadEnv& env) const {
+                return nrot == 0 || nsweep >= maxsweep;
+            }
+
+            void block_kernel(int64_t ilo, int64_t ni, int64_t jlo, int64_t nj, T* rowi, T* rowj) {
+                const int64_t m = ni + nj;
+                Tensor<T> w(std::vector<long>{m, 2*n}, false);
+                std::memcpy(w.ptr(), rowi, ni*2*n*sizeof(T));
+                std::memcpy(w.ptr()+ni*2*n, rowj, nj*2*n*sizeof(T));
+
+                Tensor<T> g = inner(copy(w(_,Slice(0,n-1))), copy(w(_,Slice(n,-1))), 1, 1);
+                Tensor<T> q(m, m);
+                for (int64_t i=0; i<m; ++i) q(i,i) = 1;
+                if (!sweep(g, q)) return;
+                nrot++;
+
+                w = inner(q, w);
+                std::memcpy(rowi, w.ptr(), ni*2*n*sizeof(T));
+                std::memcpy(rowj, w.ptr()+ni*2*n, nj*2*n*sizeof(T));
+            }
+        };
+
+
+        /// Computes selected eigenpairs of a symmetric distributed matrix (collective call)
+
+        /// @param[in] A The symmetric (n,n) matrix with any distribution
+        /// @param[out] Vt Column distributed (ihi-ilo+1,n) matrix whose rows are the eigenvectors
+        /// @param[out] e The eigenvalues ilo..ihi in ascending order (replicated)
+        /// @param[in] ilo Index of the first eigenvalue
+        /// @param[in] ihi Index of the last eigenvalue
+        /// @param[in] tol Relative accuracy (to the Frobenius norm of A) of the off-diagonal elements
+        template <typename T>
+        void jacobi_eigenvectors(const DistributedMatrix<T>& A, DistributedMatrix<T>& Vt, Tensor<T>& e,
+                                 int64_t ilo, int64_t ihi, double tol) {
+            World& world = A.get_world();
+            const int64_t n = A.coldim();
+
+            const DistributedMatrix<T> Acol = redistribute(A, column_distributed_matrix_distribution(world, n, n));
+            DistributedMatrix<T> W = column_distributed_matrix<T>(world, n, 2*n);
+            double anorm = 0.0;
+            if (W.local_size() > 0) {
+                W.data()(_,Slice(n,-1)) = Acol.data();
+                for (int64_t i=W.local_ilow(); i<=W.local_ihigh(); ++i) W.data()(i-W.local_ilow(),i) = 1;
+                anorm = Acol.data().normf();
+                anorm *= anorm;
+            }
+            world.gop.sum(anorm);
+            anorm = std::sqrt(anorm);
+
+            // The sweeps synchronize threads with spinning barriers, so
+            // never run more threads than this process has cores
+            int nthread = ThreadPool::size()+1;
+            if (Topology::available()) nthread = std::max(1, std::min(nthread, Topology::num_process_cores()));
+
+            bool converged = false;
+            world.taskq.add(new SystolicJacobiEigensolver<T>(W, tol*anorm, 50, converged, nthread));
+            world.taskq.fence();
+            if (!converged) MADNESS_EXCEPTION("syev: Jacobi sweeps did not converge", 0);
+
+            // Eigenvalues are the diagonal elements v_i.Av_i
+            Tensor<T> all(n);
+            for (int64_t i=W.local_ilow(); i<=W.local_ihigh() && W.local_size()>0; ++i) {
+                const Tensor<T> w = W.data()(i-W.local_ilow(),_);
+                all(i) = w(Slice(0,n-1)).trace(w(Slice(n,-1)));
+            }
+            world.gop.sum(all.ptr(), n);
+
+            std::vector<int64_t> order(n);
+            std::iota(order.begin(), order.end(), int64_t(0));
+            std::stable_sort(order.begin(), order.end(),
+                             [&all](int64_t a, int64_t b) {return all(a) < all(b);});
+
+            const int64_t nsel = ihi - ilo + 1;
+            std::vector<int64_t> map(n, -1);
+            e = Tensor<T>(nsel);
+            for (int64_t k=0; k<nsel; ++k) {
+                map[order[ilo+k]] = k;
+                e(k) = all(order[ilo+k]);
+            }
+
+            Vt = column_distributed_matrix<T>(world, nsel, n);
+            DistributedMatrixCopier<T> copier(world, Vt);
+            copier.copy_rows(W, map, 0);
+        }
+    }
+
+
+    /// Computes selected eigenpairs of a real symmetric distributed matrix (collective call)
+
+    /// Solves A v = e v with the one-sided Jacobi method on the systolic
+    /// loop, which parallelizes over processes and over the threads of
+    /// each process.  ilo and ihi (as in the LAPACK routine syevx, but
+    /// counting from zero) select the eigenpairs returned.  Note that
+    /// Jacobi always converges the full spectrum, so a partial spectrum
+    /// saves only the memory and communication of the unwanted vectors,
+    /// not the cost of the sweeps.
+    /// @param[in] A The symmetric (n,n) matrix with any distribution
+    /// @param[out] V The (n,ihi-ilo+1) matrix with the eigenvectors as columns, distributed by rows
+    /// @param[out] e The selected eigenvalues in ascending order (replicated)
+    /// @param[in] ilo Index of the first eigenvalue returned
+    /// @param[in] ihi Index of the last eigenvalue returned (default is n-1)
+    /// @param[in] tol Accuracy of the off-diagonal elements relative to the Frobenius norm of A
+    template <typename T>
+    void syev(const DistributedMatrix<T>& A, DistributedMatrix<T>& V, Tensor<T>& e,
+              int64_t ilo=0, int64_t ihi=-1, double tol=1e-12) {
+        static_assert(!TensorTypeData<T>::iscomplex, "syev(DistributedMatrix) requires a real matrix");
+        const int64_t n = A.coldim();
+        if (ihi < 0) ihi = n-1;
+        MADNESS_ASSERT(A.rowdim()==n && ilo>=0 && ilo<=ihi && ihi<n);
+
+        DistributedMatrix<T> Vt;
+        detail::jacobi_eigenvectors(A, Vt, e, ilo, ihi, tol);
+        V = transpose(Vt);
+    }
+
+
+    /// Computes selected eigenpairs of a real symmetric-definite distributed problem (collective call)
+
+    /// Solves A v = e B v with B positive definite, the eigenvectors
+    /// being normalized so that V^T B V = 1.  The problem is reduced to
+    /// standard form by canonical orthogonalization, B = W s W^T, X = W
+    /// s^(-1/2), with the Jacobi solver and \c gemm.  As for \c syev
+    /// a partial spectrum does not shorten the sweeps, but only the
+    /// selected vectors are back-transformed.
+    /// @param[in] A The symmetric (n,n) matrix with any distribution
+    /// @param[in] B The symmetric positive definite (n,n) matrix with any distribution
+    /// @param[out] V The (n,ihi-ilo+1) matrix with the eigenvectors as columns, distributed by rows
+    /// @param[out] e The selected eigenvalues in ascending order (replicated)
+    /// @param[in] ilo Index of the first eigenvalue returned
+    /// @param[in] ihi Index of the last eigenvalue returned (default is n-1)
+    /// @param[in] tol Accuracy of the off-diagonal elements relative to the Frobenius norm
+    template <typename T>
+    void sygv(const DistributedMatrix<T>& A, const DistributedMatrix<T>& B, DistributedMatrix<T>& V, Tensor<T>& e,
+              int64_t ilo=0, int64_t ihi=-1, double tol=1e-12) {
+        static_assert(!TensorTypeData<T>::iscomplex, "sygv(DistributedMatrix) requires a real matrix");
+        World& world = A.get_world();
+        const int64_t n = A.coldim();
+        if (ihi < 0) ihi = n-1;
+        MADNESS_ASSERT(A.rowdim()==n && B.coldim()==n && B.rowdim()==n && ilo>=0 && ilo<=ihi && ihi<n);
+
+        DistributedMatrix<T> Xt;
+        Tensor<T> s;
+        detail::jacobi_eigenvectors(B, Xt, s, 0, n-1, tol);
+        if (s.min() <= 0) MADNESS_EXCEPTION("sygv: B is not positive definite", 0);
+        for (int64_t i=Xt.local_ilow(); i<=Xt.local_ihigh() && Xt.local_size()>0; ++i)
+            Xt.data()(i-Xt.local_ilow(),_).scale(T(1)/std::sqrt(s(i)));
+
+        DistributedMatrix<T> Yt;
+        detail::jacobi_eigenvectors(inner(inner(Xt, A), transpose(Xt)), Yt, e, ilo, ihi, tol);
+        V = redistribute(transpose(inner(Yt, Xt)), row_distributed_matrix_distribution(world, n, ihi-ilo+1));
+    }
+}
+
+#endif // MADNESS_DISTRIBUTED_EIGEN_H
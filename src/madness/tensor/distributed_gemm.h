@@ -0,0 +1,219 @@
+#ifndef MADNESS_DISTRIBUTED_GEMM_H
+#define MADNESS_DISTRIBUTED_GEMM_H
+
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/distributed_gemm.h
+/// \brief Parallel multiplication of distributed matrices (SUMMA)
+
+#include <madness/world/MADworld.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/distributed_matrix.h>
+
+namespace madness {
+
+    namespace detail {
+
+        /// SUMMA multiplication C = alpha*A*B + C of distributed matrices
+
+        /// The contracted dimension is cut into panels.  For each panel
+        /// the owners of A and B send the patches each process needs
+        /// for its block of C, which are gathered into two buffers
+        /// (one being filled while the other is multiplied).  The
+        /// local multiplication is split over tasks by rows of C.
+        ///
+        /// A, B and C may have any (and different) distributions, but
+        /// a 2D block distribution of C gives the least communication.
+        template <typename T>
+        class DistributedGemm : public WorldObject< DistributedGemm<T> > {
+            const DistributedMatrix<T>& A;
+            const DistributedMatrix<T>& B;
+            DistributedMatrix<T>& C;
+            const T alpha;
+            const int64_t k;            ///< Contracted dimension
+            const int64_t panel;        ///< Panel width
+            const int64_t cidim, cjdim; ///< Dimensions of the local block of C
+            Tensor<T> apanel[2];        ///< Flattened (cidim,width) panels of A
+            Tensor<T> bpanel[2];        ///< Flattened (width,cjdim) panels of B
+
+            int64_t width(int64_t ipanel) const {
+                return std::min(panel, k - ipanel*panel);
+            }
+
+            Tensor<T> a_view(int buf, int64_t kw, int64_t lo, int64_t hi) {
+                return apanel[buf](Slice(lo*kw,(hi+1)*kw-1)).reshape(hi-lo+1,kw);
+            }
+
+            Tensor<T> b_view(int buf, int64_t kw) {
+                return bpanel[buf](Slice(0,kw*cjdim-1)).reshape(kw,cjdim);
+            }
+
+            /// Receives a patch of A with first element (ilow,klow) relative to the panel
+            void put_a(int buf, int64_t kw, int64_t ilow, int64_t klow, const Tensor<T>& s) {
+                const int64_t i0 = ilow - C.local_ilow();
+                a_view(buf,kw,0,cidim-1)(Slice(i0,i0+s.dim(0)-1),Slice(klow,klow+s.dim(1)-1)) = s;
+            }
+
+            /// Receives a patch of B with first element (klow,jlow) relative to the panel
+            void put_b(int buf, int64_t kw, int64_t klow, int64_t jlow, const Tensor<T>& s) {
+                const int64_t j0 = jlow - C.local_jlow();
+                b_view(buf,kw)(Slice(klow,klow+s.dim(0)-1),Slice(j0,j0+s.dim(1)-1)) = s;
+            }
+
+            /// Sends the local patches of a panel of A and B to the processes holding C
+            void send_panel(int64_t ipanel) {
+                const int buf = ipanel%2;
+                const int64_t kw = width(ipanel);
+                const int64_t klo = ipanel*panel, khi = klo+kw-1;
+                const ProcessID nproc = C.get_world().size();
+
+                if (A.local_size() > 0) {
+                    const int64_t ailo = A.local_ilow(), aihi = A.local_ihigh();
+                    const int64_t k0 = std::max(klo,A.local_jlow()), k1 = std::min(khi,A.local_jhigh());
+                    for (ProcessID p=0; p<nproc && k0<=k1; p++) {
+                        int64_t ilow, ihigh, jlow, jhigh;
+                        C.get_range(p, ilow, ihigh, jlow, jhigh);
+                        const int64_t i0 = std::max(ailo,ilow), i1 = std::min(aihi,ihigh);
+                        if (i0>i1 || jlow>jhigh) continue;
+                        Tensor<T> s = copy(A.data()(Slice(i0-ailo,i1-ailo),Slice(k0-A.local_jlow(),k1-A.local_jlow())));
+                        if (alpha != T(1)) s.scale(alpha);
+                        this->send(p, &DistributedGemm<T>::put_a, buf, kw, i0, k0-klo, s);
+                    }
+                }
+
+                if (B.local_size() > 0) {
+                    const int64_t bjlo = B.local_jlow(), bjhi = B.local_jhigh();
+                    const int64_t k0 = std::max(klo,B.local_ilow()), k1 = std::min(khi,B.local_ihigh());
+                    for (ProcessID p=0; p<nproc && k0<=k1; p++) {
+                        int64_t ilow, ihigh, jlow, jhigh;
+                        C.get_range(p, ilow, ihigh, jlow, jhigh);
+                        const int64_t j0 = std::max(bjlo,jlow), j1 = std::min(bjhi,jhigh);
+                        if (j0>j1 || ilow>ihigh) continue;
+                        Tensor<T> s = copy(B.data()(Slice(k0-B.local_ilow(),k1-B.local_ilow()),Slice(j0-bjlo,j1-bjlo)));
+                        this->send(p, &DistributedGemm<T>::put_b, buf, kw, k0-klo, j0, s);
+                    }
+                }
+            }
+
+            /// Accumulates the product of the buffered panels into rows [lo,hi] of the local C
+            void multiply(int buf, int64_t kw, int64_t lo, int64_t hi) {
+                Tensor<T> c = C.data()(Slice(lo,hi),_);
+                inner_result(a_view(buf,kw,lo,hi), b_view(buf,kw), 1, 0, c);
+            }
+
+        public:
+            DistributedGemm(const DistributedMatrix<T>& A, const DistributedMatrix<T>& B,
+                            DistributedMatrix<T>& C, const T alpha, int64_t panel)
+                : WorldObject< DistributedGemm<T> >(C.get_world())
+                , A(A)
+                , B(B)
+                , C(C)
+                , alpha(alpha)
+                , k(A.rowdim())
+                , panel(std::min(panel,A.rowdim()))
+                , cidim(C.local_coldim())
+                , cjdim(C.local_rowdim())
+            {
+                if (C.local_size() > 0) {
+                    for (int buf=0; buf<2; buf++) {
+                        apanel[buf] = Tensor<T>(cidim*this->panel);
+                        bpanel[buf] = Tensor<T>(cjdim*this->panel);
+                    }
+                }
+                WorldObject< DistributedGemm<T> >::process_pending();
+            }
+
+            /// Runs the multiplication (collective call)
+            void run() {
+                World& world = C.get_world();
+                const int64_t npanel = (k-1)/panel + 1;
+                const int64_t nstrip = std::min(cidim, int64_t(2*(ThreadPool::size()+1)));
+
+                send_panel(0);
+                world.gop.fence();
+                for (int64_t ipanel=0; ipanel<npanel; ipanel++) {
+                    if (ipanel+1 < npanel) send_panel(ipanel+1);
+                    if (C.local_size() > 0) {
+                        for (int64_t strip=0; strip<nstrip; strip++) {
+                            const int64_t lo = strip*cidim/nstrip, hi = (strip+1)*cidim/nstrip - 1;
+                            if (lo <= hi) this->task(world.rank(), &DistributedGemm<T>::multiply,
+                                                     int(ipanel%2), width(ipanel), lo, hi);
+                        }
+                    }
+                    world.gop.fence();
+                }
+            }
+        };
+    }
+
+
+    /// Computes C = alpha*A*B + beta*C for distributed matrices (collective call)
+
+    /// The matrices may have any distribution, but a 2D block distribution
+    /// of C (see \c block_distributed_matrix) gives the least communication
+    /// since each process then receives only the rows of A and columns of
+    /// B that contribute to its block.  Use \c transpose and \c redistribute
+    /// for products with transposed matrices or to convert the result to
+    /// another layout.
+    /// @param[in] alpha Scale factor of the product
+    /// @param[in] A The (n,k) matrix
+    /// @param[in] B The (k,m) matrix
+    /// @param[in] beta Scale factor of C
+    /// @param[in,out] C The (n,m) result matrix
+    /// @param[in] panel Width of the panels of the contracted dimension that are sent at once
+    template <typename T>
+    void gemm(const T alpha, const DistributedMatrix<T>& A, const DistributedMatrix<T>& B,
+              const T beta, DistributedMatrix<T>& C, int64_t panel=256) {
+        MADNESS_ASSERT(A.rowdim()==B.coldim() && A.coldim()==C.coldim() && B.rowdim()==C.rowdim());
+        MADNESS_ASSERT(panel > 0);
+
+        if (beta != T(1)) C.data().scale(beta);
+        if (A.rowdim() == 0) return;
+        detail::DistributedGemm<T> summa(A, B, C, alpha, panel);
+        summa.run();
+    }
+
+
+    /// Returns the product A*B of distributed matrices as a 2D block distributed matrix (collective call)
+
+    /// @param[in] A The (n,k) matrix
+    /// @param[in] B The (k,m) matrix
+    /// @return The (n,m) product
+    template <typename T>
+    DistributedMatrix<T> inner(const DistributedMatrix<T>& A, const DistributedMatrix<T>& B) {
+        DistributedMatrix<T> C = block_distributed_matrix<T>(A.get_world(), A.coldim(), B.rowdim());
+        gemm(T(1), A, B, T(0), C);
+        return C;
+    }
+}
+
+#endif // MADNESS_DISTRIBUTED_GEMM_H
@@ -58,6 +58,7 @@ namespace madness {
     
     static inline DistributedMatrixDistribution column_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t coltile=0);
     static inline DistributedMatrixDistribution row_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t rowtile=0);
+    static inline DistributedMatrixDistribution block_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t coltile=0, int64_t rowtile=0);
 
     template <typename T>
     DistributedMatrix<T> concatenate_rows(const DistributedMatrix<T>& a, const DistributedMatrix<T>& b);
@@ -68,6 +69,7 @@ namespace madness {
     class DistributedMatrixDistribution {
         friend DistributedMatrixDistribution column_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t coltile);
         friend DistributedMatrixDistribution row_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t rowtile);
+        friend DistributedMatrixDistribution block_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t coltile, int64_t rowtile);
         template <typename T> friend class DistributedMatrix;
 
     protected:
@@ -708,6 +710,173 @@ namespace madness {
     }
 
 
+    /// Generates an (n,m) matrix distribution tiled over a 2D grid of processes
+
+    /// If both tile sizes are not positive the process grid is chosen
+    /// to minimize the sum of the tile dimensions, which is what
+    /// limits the communication in gemm, preferring grids that use
+    /// more processes.  If only one is given the other is chosen to
+    /// use as many processes as the given one leaves.
+    /// @param[in] world The world
+    /// @param[in] n The column (first) dimension
+    /// @param[in] m The row (second) dimension
+    /// @param[in] coltile Tile size for columns (default is to choose the grid)
+    /// @param[in] rowtile Tile size for rows (default is to choose the grid)
+    /// @return An object encoding the dimension and distribution information
+    static inline DistributedMatrixDistribution
+    block_distributed_matrix_distribution(World& world, int64_t n, int64_t m, int64_t coltile, int64_t rowtile) { // default tiles=0 above
+        const int64_t P = world.size();
+        if (coltile <= 0 && rowtile > 0) {
+            const int64_t pm = (m-1)/rowtile + 1;
+            MADNESS_ASSERT(pm <= P);
+            coltile = (n-1)/(P/pm) + 1;
+        }
+        else if (rowtile <= 0 && coltile > 0) {
+            const int64_t pn = (n-1)/coltile + 1;
+            MADNESS_ASSERT(pn <= P);
+            rowtile = (m-1)/(P/pn) + 1;
+        }
+        else if (coltile <= 0 && rowtile <= 0) {
+            int64_t best = -1;
+            for (int64_t pn=1; pn<=P; pn++) {
+                const int64_t pm = P/pn;
+                const int64_t tn = (n-1)/pn + 1;
+                const int64_t tm = (m-1)/pm + 1;
+                const int64_t cost = tn + tm;
+                if (best < 0 || cost < best || (cost == best && ((n-1)/tn+1)*((m-1)/tm+1) > ((n-1)/coltile+1)*((m-1)/rowtile+1))) {
+                    best = cost;
+                    coltile = tn;
+                    rowtile = tm;
+                }
+            }
+        }
+        coltile = std::min(coltile,n);
+        rowtile = std::min(rowtile,m);
+        MADNESS_ASSERT(((n-1)/coltile+1)*((m-1)/rowtile+1) <= P);
+
+        return DistributedMatrixDistribution(world, n, m, coltile, rowtile);
+    }
+
+
+    /// Generates an (n,m) matrix tiled over a 2D grid of processes
+
+    /// @param[in] world The world
+    /// @param[in] n The column (first) dimension
+    /// @param[in] m The row (second) dimension
+    /// @param[in] coltile Tile size for columns (default is to choose the grid)
+    /// @param[in] rowtile Tile size for rows (default is to choose the grid)
+    /// @return A new zero matrix with the requested dimensions and distribution
+    template <typename T>
+    DistributedMatrix<T> block_distributed_matrix(World& world, int64_t n, int64_t m, int64_t coltile=0, int64_t rowtile=0) {
+        return DistributedMatrix<T>(block_distributed_matrix_distribution(world, n, m, coltile, rowtile));
+    }
+
+
+    namespace detail {
+
+        /// Receives patches of a matrix being redistributed
+        template <typename T>
+        class DistributedMatrixCopier : public WorldObject< DistributedMatrixCopier<T> > {
+            DistributedMatrix<T>& B;
+
+        public:
+            DistributedMatrixCopier(World& world, DistributedMatrix<T>& B)
+                : WorldObject< DistributedMatrixCopier<T> >(world)
+                , B(B)
+            {
+                WorldObject< DistributedMatrixCopier<T> >::process_pending();
+            }
+
+            /// Copies the patch with first element (ilow,jlow) into the local data
+            void put(int64_t ilow, int64_t jlow, const Tensor<T>& s) {
+                const int64_t i0 = ilow - B.local_ilow();
+                const int64_t j0 = jlow - B.local_jlow();
+                B.data()(Slice(i0,i0+s.dim(0)-1),Slice(j0,j0+s.dim(1)-1)) = s;
+            }
+
+            /// Sends the local data of A to the owners in B (collective call)
+
+            /// If \c trans is true then B is the transpose of A.
+            void copy(const DistributedMatrix<T>& A, bool trans) {
+                if (A.local_size() > 0) {
+                    const int64_t ailo = A.local_ilow(), aihi = A.local_ihigh();
+                    const int64_t ajlo = A.local_jlow(), ajhi = A.local_jhigh();
+                    for (ProcessID p=0; p<B.get_world().size(); p++) {
+                        int64_t ilow, ihigh, jlow, jhigh;
+                        if (trans) B.get_range(p, jlow, jhigh, ilow, ihigh);
+                        else B.get_range(p, ilow, ihigh, jlow, jhigh);
+                        const int64_t i0 = std::max(ailo,ilow), i1 = std::min(aihi,ihigh);
+                        const int64_t j0 = std::max(ajlo,jlow), j1 = std::min(ajhi,jhigh);
+                        if (i0>i1 || j0>j1) continue;
+
+                        const Tensor<T> s = A.data()(Slice(i0-ailo,i1-ailo),Slice(j0-ajlo,j1-ajlo));
+                        if (trans) this->send(p, &DistributedMatrixCopier<T>::put, j0, i0, madness::copy(madness::transpose(s)));
+                        else this->send(p, &DistributedMatrixCopier<T>::put, i0, j0, madness::copy(s));
+                    }
+                }
+                B.get_world().gop.fence();
+            }
+
+            /// Sends rows of A to possibly different rows in B (collective call)
+
+            /// Local row i of A, starting at column \c jlow, becomes row
+            /// map[i] of B unless map[i] is negative.
+            void copy_rows(const DistributedMatrix<T>& A, const std::vector<int64_t>& map, int64_t jlow) {
+                if (A.local_size() > 0) {
+                    const int64_t ailo = A.local_ilow(), ajlo = A.local_jlow();
+                    const int64_t j0 = std::max(ajlo,jlow), j1 = std::min(A.local_jhigh(),jlow+B.rowdim()-1);
+                    for (int64_t i=ailo; i<=A.local_ihigh() && j0<=j1; i++) {
+                        if (map[i] < 0) continue;
+                        for (ProcessID p=0; p<B.get_world().size(); p++) {
+                            int64_t ilow, ihigh, bjlow, bjhigh;
+                            B.get_range(p, ilow, ihigh, bjlow, bjhigh);
+                            const int64_t k0 = std::max(j0-jlow,bjlow), k1 = std::min(j1-jlow,bjhigh);
+                            if (map[i]<ilow || map[i]>ihigh || k0>k1) continue;
+                            const Tensor<T> s = A.data()(Slice(i-ailo,i-ailo),Slice(k0+jlow-ajlo,k1+jlow-ajlo));
+                            this->send(p, &DistributedMatrixCopier<T>::put, map[i], k0, madness::copy(s));
+                        }
+                    }
+                }
+                B.get_world().gop.fence();
+            }
+        };
+    }
+
+
+    /// Copies a matrix into a new distribution (collective call)
+
+    /// This converts between any of the layouts, e.g., from the 2D
+    /// block layout used by gemm to the column distributed layout
+    /// used by the systolic algorithms and \c transform of function vectors.
+    /// @param[in] A The matrix to be copied
+    /// @param[in] d The distribution of the result, which must have the dimensions of \c A
+    /// @return A new matrix with the content of \c A and distribution \c d
+    template <typename T>
+    DistributedMatrix<T> redistribute(const DistributedMatrix<T>& A, const DistributedMatrixDistribution& d) {
+        MADNESS_ASSERT(A.coldim()==d.coldim() && A.rowdim()==d.rowdim());
+        DistributedMatrix<T> B(d);
+        detail::DistributedMatrixCopier<T> copier(A.get_world(), B);
+        copier.copy(A, false);
+        return B;
+    }
+
+
+    /// Returns the transpose of a distributed matrix (collective call)
+
+    /// The result of an (n,m) matrix with tiles (tn,tm) is an (m,n)
+    /// matrix with tiles (tm,tn), i.e., a column distributed matrix
+    /// becomes row distributed and vice versa.
+    /// @param[in] A The matrix to be transposed
+    /// @return A new matrix holding the transpose of \c A
+    template <typename T>
+    DistributedMatrix<T> transpose(const DistributedMatrix<T>& A) {
+        DistributedMatrix<T> B(block_distributed_matrix_distribution(A.get_world(), A.rowdim(), A.coldim(), A.rowtile(), A.coltile()));
+        detail::DistributedMatrixCopier<T> copier(A.get_world(), B);
+        copier.copy(A, true);
+        return B;
+    }
+
+
     /// Generates a distributed matrix with rows of \c a and \c b interleaved
 
     /// I.e., the even rows of the result will be rows of \c a , and the
@@ -200,12 +200,14 @@ namespace madness {
 		size_t real_size() const {return this->size();}
 
         void reduce_rank(const double& eps) {return;};
+        static void reduce_rank(const std::vector<GenTensor<T>*>& g, const double& eps) {return;};
         void normalize() {return;}
 
         std::string what_am_i() const {return "GenTensor, aliased to Tensor";};
 		TensorType tensor_type() const {return TT_FULL;}
 
 		void add_SVD(const GenTensor<T>& rhs, const double& eps) {*this+=rhs;}
+		void add_randomized(const GenTensor<T>& rhs, const double& eps) {*this+=rhs;}
 
 		SRConf<T> config() const {MADNESS_EXCEPTION("no SRConf in complex GenTensor",1);}
         SRConf<T> get_configs(const int& start, const int& end) const {MADNESS_EXCEPTION("no SRConf in complex GenTensor",1);}
@@ -1274,6 +1276,13 @@ public:
     operator LowRankTensor<T>() const {return *this;}
     operator LowRankTensor<T>() {return *this;}
 
+    using LowRankTensor<T>::reduce_rank;
+
+    /// reduce the rank of several GenTensors together, see LowRankTensor
+    static void reduce_rank(const std::vector<GenTensor<T>*>& g, const double& eps) {
+        LowRankTensor<T>::reduce_rank(std::vector<LowRankTensor<T>*>(g.begin(),g.end()),eps);
+    }
+
     /// general slicing, shallow; for temporary use only!
     SliceGenTensor<T> operator()(const std::vector<Slice>& s) {
         return SliceGenTensor<T>(*this,s);
@@ -938,6 +938,77 @@ namespace madness {
     }
 
 
+    /// Test code for the batched decompositions
+
+    /// Mixed sizes, so that matrices go both to the SIMD kernels (several per
+    /// kernel call) and to LAPACK
+    template <typename T>
+    double test_syev_batched() {
+        std::vector< Tensor<T> > a, V;
+        std::vector< Tensor< typename Tensor<T>::scalar_type > > e;
+        for (int i=0; i<40; ++i) {
+            const long n=1+(i*7)%30;
+            Tensor<T> t(n,n);
+            t.fillrandom();
+            t+=my_conj_transpose(t);
+            a.push_back(t);
+        }
+        syev_batched(a,V,e);
+        double err = 0.0;
+        for (size_t k=0; k<a.size(); ++k) {
+            for (long i=0; i<a[k].dim(0); ++i) {
+                err = max(err,(double) (inner(a[k],V[k](_,i)) - V[k](_,i)*e[k](i)).normf());
+                if (i>0 && e[k](i)<e[k](i-1)) err = max(err,1.0);
+            }
+        }
+        return err;
+    }
+
+    template <typename T>
+    double test_svd_batched() {
+        std::vector< Tensor<T> > a, U, VT;
+        std::vector< Tensor< typename Tensor<T>::scalar_type > > s;
+        for (int i=0; i<40; ++i) {
+            Tensor<T> t(1+(i*5)%23,1+(i*3)%17);
+            t.fillrandom();
+            if (i%7==0) t(_,0)=0.0;     // a zero singular value
+            a.push_back(t);
+        }
+        svd_batched(a,U,s,VT);
+        double err = 0.0;
+        for (size_t k=0; k<a.size(); ++k) {
+            const long rank = s[k].dim(0);
+            Tensor<T> b=copy(a[k]);
+            for (long i=0; i<a[k].dim(0); ++i)
+                for (long j=0; j<a[k].dim(1); ++j)
+                    for (long r=0; r<rank; ++r)
+                        b(i,j) -= U[k](i,r) * T(s[k](r)) * VT[k](r,j);
+            Tensor<T> uu=inner(my_conj_transpose(U[k]),U[k]);
+            for (long r=0; r<rank; ++r) uu(r,r)-=1.0;
+            err = max(err,(double) (b.absmax() + uu.absmax()));
+        }
+        return err;
+    }
+
+    template <typename T>
+    double test_qr_batched() {
+        std::vector< Tensor<T> > a, q, R;
+        for (int i=0; i<40; ++i) {
+            Tensor<T> t(2+(i%3)*3,2+(i%4)*2);
+            t.fillrandom();
+            a.push_back(t);
+            q.push_back(copy(t));
+        }
+        qr_batched(q,R);
+        double err = 0.0;
+        for (size_t k=0; k<a.size(); ++k) {
+            Tensor<T> qq=inner(q[k],q[k],0,0);
+            for (long r=0; r<qq.dim(0); ++r) qq(r,r)-=1.0;
+            err = max(err,(double) ((inner(q[k],R[k])-a[k]).absmax() + qq.absmax()));
+        }
+        return err;
+    }
+
     void init_tensor_lapack() {
 	char e[] = "e";
 	dlamch_(e,1);
@@ -991,6 +1062,19 @@ namespace madness {
             cout << "error in double QR/LQ " << test_qr<double>() << endl;
             cout << endl;
 
+            const MTxmqISA save=batched_linalg_isa();
+            for (int isa=MTXMQ_ISA_REFERENCE; isa<=MTXMQ_ISA_AVX512; ++isa) {
+                if (batched_linalg_set_isa(MTxmqISA(isa)) != isa) continue;
+                const char* name=mTxmq_isa_name(MTxmqISA(isa));
+                cout << "error in double syev_batched (" << name << ") " << test_syev_batched<double>() << endl;
+                cout << "error in double svd_batched (" << name << ") " << test_svd_batched<double>() << endl;
+                cout << "error in double qr_batched (" << name << ") " << test_qr_batched<double>() << endl;
+            }
+            batched_linalg_set_isa(save);
+            cout << "error in double_complex syev_batched " << test_syev_batched<double_complex>() << endl;
+            cout << "error in double_complex svd_batched " << test_svd_batched<double_complex>() << endl;
+            cout << endl;
+
             cout << "error in double inverse " << test_inverse<double>(32) << endl;
             cout << "error in double inverse " << test_inverse<double>(47) << endl;
             cout << endl;
@@ -598,6 +598,19 @@ public:
         }
     }
 
+    /// add other to this in SVD form using a randomized range finder
+
+    /// other need not be rank-reduced, and the rank of the result is chosen
+    /// adaptively for the threshold
+    void add_randomized(const LowRankTensor& other, const double& thresh) {
+        if (type==TT_FULL) impl.full->operator+=(*other.impl.full);
+        else if (type==TT_2D) impl.svd->add_randomized((*other.impl.svd),thresh*facReduce());
+        else if (type==TT_TENSORTRAIN) impl.tt->operator+=(*other.impl.tt);
+        else {
+            MADNESS_EXCEPTION("you should not be here",1);
+        }
+    }
+
     /// Inplace multiply by corresponding elements of argument Tensor
     LowRankTensor<T>& emul(const LowRankTensor<T>& other) {
 
@@ -631,6 +644,25 @@ public:
         }
     }
 
+    /// reduce the rank of several tensors
+
+    /// the TT_2D tensors are reduced together, so that the small
+    /// decompositions of all of them are batched (see SRConf)
+    static void reduce_rank(const std::vector<LowRankTensor<T>*>& t, const double& thresh) {
+        std::vector<SRConf<T>*> confs;
+        for (size_t i=0; i<t.size(); ++i) {
+            if (t[i]->type==TT_2D) confs.push_back(t[i]->impl.svd.get());
+            else t[i]->reduce_rank(thresh);
+        }
+        SRConf<T>::divide_and_conquer_reduce(confs,thresh*facReduce());
+    }
+
+    /// reduce the rank using a randomized range finder, TT_2D only
+    void reduce_rank_randomized(const double& thresh) {
+        if (type==TT_2D) impl.svd->randomized_reduce(thresh*facReduce());
+        else reduce_rank(thresh);
+    }
+
     /// Returns a pointer to the internal data
 
     /// @param[in]  ivec    index of core vector to which the return values points
@@ -0,0 +1,196 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/mtxmq_simd.cc
+/// \brief Instruction set selection for the SIMD mTxmq kernels
+
+#include <madness/tensor/mtxmq_simd.h>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+
+#include <immintrin.h>
+
+#define MTXMQ_NS mtxmq_avx2
+#define MTXMQ_TARGET __attribute__((target("avx2,fma")))
+#define MTXMQ_AVX2
+#include <madness/tensor/mtxmq_simd_kernels.h>
+#undef MTXMQ_AVX2
+#undef MTXMQ_TARGET
+#undef MTXMQ_NS
+
+#define MTXMQ_NS mtxmq_avx512
+#define MTXMQ_TARGET __attribute__((target("avx512f,avx2,fma")))
+#define MTXMQ_AVX512
+#include <madness/tensor/mtxmq_simd_kernels.h>
+#undef MTXMQ_AVX512
+#undef MTXMQ_TARGET
+#undef MTXMQ_NS
+
+#endif // MADNESS_HAVE_MTXMQ_SIMD
+
+namespace madness {
+
+    namespace {
+
+        typedef void (*kernelT)(long dimi, long dimj, long dimk, double* c,
+                                const double* a, const double* b, long ldb);
+
+        typedef void (*kernelsT)(long dimi, long dimj, long dimk, float* c,
+                                 const float* a, const float* b, long ldb);
+
+        /// One kernel per type combination (c = a*b): dd, zz, dz, zd, and ss for floats
+        struct MTxmqKernels {
+            kernelT dd, zz, dz, zd;
+            kernelsT ss;
+        };
+
+        MTxmqISA detect_isa() {
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return MTXMQ_ISA_AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return MTXMQ_ISA_AVX2;
+#endif
+            return MTXMQ_ISA_REFERENCE;
+        }
+
+        MTxmqISA best_isa = MTXMQ_ISA_REFERENCE;
+
+        // Zero initialized (no kernels, i.e., reference) until the
+        // selection below runs during static initialization
+        MTxmqISA current_isa = MTXMQ_ISA_REFERENCE;
+        MTxmqKernels kernels;
+
+        void select_isa(MTxmqISA isa) {
+            if (isa > best_isa) isa = best_isa;
+            MTxmqKernels k = {0, 0, 0, 0, 0};
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+            if (isa == MTXMQ_ISA_AVX2) {
+                MTxmqKernels t = {mtxmq_avx2::mtxmq_dd, mtxmq_avx2::mtxmq_zz,
+                                  mtxmq_avx2::mtxmq_dz, mtxmq_avx2::mtxmq_zd,
+                                  mtxmq_avx2::mtxmq_ss};
+                k = t;
+            }
+            else if (isa == MTXMQ_ISA_AVX512) {
+                MTxmqKernels t = {mtxmq_avx512::mtxmq_dd, mtxmq_avx512::mtxmq_zz,
+                                  mtxmq_avx512::mtxmq_dz, mtxmq_avx512::mtxmq_zd,
+                                  mtxmq_avx512::mtxmq_ss};
+                k = t;
+            }
+#endif
+            kernels = k;
+            current_isa = isa;
+        }
+
+        struct MTxmqInit {
+            MTxmqInit() {
+                best_isa = detect_isa();
+                MTxmqISA isa = best_isa;
+                const char* s = std::getenv("MAD_MTXMQ_ISA");
+                if (s) {
+                    if (std::strcmp(s, "reference") == 0) isa = MTXMQ_ISA_REFERENCE;
+                    else if (std::strcmp(s, "avx2") == 0) isa = MTXMQ_ISA_AVX2;
+                    else if (std::strcmp(s, "avx512") == 0) isa = MTXMQ_ISA_AVX512;
+                }
+                select_isa(isa);
+            }
+        } mtxmq_init;
+
+    } // namespace
+
+    MTxmqISA mTxmq_isa() {
+        return current_isa;
+    }
+
+    MTxmqISA mTxmq_best_isa() {
+        return best_isa;
+    }
+
+    MTxmqISA mTxmq_set_isa(MTxmqISA isa) {
+        select_isa(isa);
+        return current_isa;
+    }
+
+    const char* mTxmq_isa_name(MTxmqISA isa) {
+        switch (isa) {
+        case MTXMQ_ISA_AVX2: return "avx2";
+        case MTXMQ_ISA_AVX512: return "avx512";
+        default: return "reference";
+        }
+    }
+
+    namespace detail {
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        double* c, const double* a, const double* b, long ldb) {
+            if (!kernels.dd) return false;
+            kernels.dd(dimi, dimj, dimk, c, a, b, ldb);
+            return true;
+        }
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        std::complex<double>* c, const std::complex<double>* a,
+                        const std::complex<double>* b, long ldb) {
+            if (!kernels.zz) return false;
+            kernels.zz(dimi, dimj, dimk, reinterpret_cast<double*>(c),
+                       reinterpret_cast<const double*>(a), reinterpret_cast<const double*>(b), ldb);
+            return true;
+        }
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        std::complex<double>* c, const double* a,
+                        const std::complex<double>* b, long ldb) {
+            if (!kernels.dz) return false;
+            kernels.dz(dimi, dimj, dimk, reinterpret_cast<double*>(c),
+                       a, reinterpret_cast<const double*>(b), ldb);
+            return true;
+        }
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        std::complex<double>* c, const std::complex<double>* a,
+                        const double* b, long ldb) {
+            if (!kernels.zd) return false;
+            kernels.zd(dimi, dimj, dimk, reinterpret_cast<double*>(c),
+                       reinterpret_cast<const double*>(a), b, ldb);
+            return true;
+        }
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        float* c, const float* a, const float* b, long ldb) {
+            if (!kernels.ss) return false;
+            kernels.ss(dimi, dimj, dimk, c, a, b, ldb);
+            return true;
+        }
+
+    } // namespace detail
+
+} // namespace madness
@@ -0,0 +1,104 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_TENSOR_MTXMQ_SIMD_H__INCLUDED
+#define MADNESS_TENSOR_MTXMQ_SIMD_H__INCLUDED
+
+/// \file tensor/mtxmq_simd.h
+/// \brief Runtime dispatched AVX2 and AVX-512 kernels for mTxmq on x86-64
+
+/// The kernels are compiled for every instruction set regardless of the
+/// compiler flags and the best one the processor supports is chosen via
+/// CPUID when the library is loaded.  Set \c MAD_MTXMQ_ISA to
+/// \c reference, \c avx2 or \c avx512 to override the choice (the request
+/// is lowered to what the processor supports).  Define \c DISABLE_MTXMQ_SIMD
+/// to compile them out.
+
+#include <madness/madness_config.h>
+#include <complex>
+
+#if defined(X86_64) && (defined(__GNUC__) || defined(__clang__)) && !defined(DISABLE_MTXMQ_SIMD)
+#define MADNESS_HAVE_MTXMQ_SIMD 1
+#endif
+
+namespace madness {
+
+    /// Instruction sets with mTxmq kernels
+    enum MTxmqISA {
+        MTXMQ_ISA_REFERENCE = 0, ///< Portable reference loops
+        MTXMQ_ISA_AVX2 = 1,      ///< AVX2 and FMA3
+        MTXMQ_ISA_AVX512 = 2     ///< AVX-512F
+    };
+
+    /// Returns the instruction set currently used by mTxmq
+    MTxmqISA mTxmq_isa();
+
+    /// Returns the best instruction set supported by this processor
+    MTxmqISA mTxmq_best_isa();
+
+    /// Selects the instruction set used by mTxmq (lowered to \c mTxmq_best_isa() if necessary)
+
+    /// Not thread safe ... intended for testing and benchmarking
+    /// \return The instruction set actually selected
+    MTxmqISA mTxmq_set_isa(MTxmqISA isa);
+
+    /// Returns a printable name of an instruction set
+    const char* mTxmq_isa_name(MTxmqISA isa);
+
+    namespace detail {
+
+        /// c(i,j) = sum(k) a(k,i)*b(k,j) with the selected SIMD kernel
+
+        /// \c ldb is the row stride of \c b in elements.
+        /// \return False if the reference kernel is selected, in which case nothing was done
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        double* c, const double* a, const double* b, long ldb);
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        std::complex<double>* c, const std::complex<double>* a,
+                        const std::complex<double>* b, long ldb);
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        std::complex<double>* c, const double* a,
+                        const std::complex<double>* b, long ldb);
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        std::complex<double>* c, const std::complex<double>* a,
+                        const double* b, long ldb);
+
+        bool mTxmq_simd(long dimi, long dimj, long dimk,
+                        float* c, const float* a, const float* b, long ldb);
+
+    } // namespace detail
+
+} // namespace madness
+
+#endif // MADNESS_TENSOR_MTXMQ_SIMD_H__INCLUDED
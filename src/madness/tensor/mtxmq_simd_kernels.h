@@ -0,0 +1,423 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/mtxmq_simd_kernels.h
+/// \brief Internal use only ... register blocked mTxmq kernels for one instruction set
+
+// This file is included by mtxmq_simd.cc once per instruction set with
+// MTXMQ_NS (namespace), MTXMQ_TARGET (function attributes) and one of
+// MTXMQ_AVX2 or MTXMQ_AVX512 defined.  Don't include it anywhere else.
+//
+// The double precision kernels work on rows of doubles.  A complex row of n elements is a
+// real row of 2n doubles, so the only differences between the four type
+// combinations are how a(k,i) is broadcast and how the row of b is loaded:
+//
+//   real*real       broadcast a, load b
+//   real*complex    the same with twice as many columns
+//   complex*real    broadcast the pair (ar,ai), load b duplicating each element
+//   complex*complex accumulate ar*b and ai*b separately and combine at the end
+//
+// The output is computed in panels of at most NVMAX vectors.  Each panel is
+// swept by blocks of MR rows of c held in registers for the whole k loop,
+// with the last vector of the panel masked if the row is not a multiple of
+// the vector length.
+//
+// mtxmq_ss is the real*real kernel again for rows of floats.
+
+namespace MTXMQ_NS {
+
+#define MTXMQ_INLINE static inline __attribute__((always_inline)) MTXMQ_TARGET
+
+#if defined(MTXMQ_AVX2)
+
+    typedef __m256d vec;
+    const int W = 4;            // doubles per vector
+    const int NACC = 12;        // accumulator registers per block (of 16)
+    const int NVMAX = 6;        // max. vectors per panel
+
+    MTXMQ_INLINE vec vzero() { return _mm256_setzero_pd(); }
+    MTXMQ_INLINE vec vbcast(const double* p) { return _mm256_broadcast_sd(p); }
+    MTXMQ_INLINE vec vbcast2(const double* p) { return _mm256_broadcast_pd((const __m128d*) p); }
+    MTXMQ_INLINE vec vfma(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+    MTXMQ_INLINE vec vload(const double* p) { return _mm256_loadu_pd(p); }
+    MTXMQ_INLINE void vstore(double* p, vec v) { _mm256_storeu_pd(p, v); }
+    MTXMQ_INLINE __m256i vmask(int n) {
+        return _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), _mm256_set_epi64x(3,2,1,0));
+    }
+    MTXMQ_INLINE vec vload_n(const double* p, int n) { return _mm256_maskload_pd(p, vmask(n)); }
+    MTXMQ_INLINE void vstore_n(double* p, vec v, int n) { _mm256_maskstore_pd(p, vmask(n), v); }
+    /// [p0,p0,p1,p1]
+    MTXMQ_INLINE vec vdup(const double* p) {
+        return _mm256_permute4x64_pd(_mm256_castpd128_pd256(_mm_loadu_pd(p)), 0x50);
+    }
+    /// Swaps the real and imaginary parts of each element
+    MTXMQ_INLINE vec vswap(vec v) { return _mm256_permute_pd(v, 0x5); }
+    /// [a0-b0, a1+b1, ...]
+    MTXMQ_INLINE vec vaddsub(vec a, vec b) { return _mm256_addsub_pd(a, b); }
+
+#elif defined(MTXMQ_AVX512)
+
+    typedef __m512d vec;
+    const int W = 8;
+    const int NACC = 24;        // of 32
+    const int NVMAX = 5;
+
+    MTXMQ_INLINE vec vzero() { return _mm512_setzero_pd(); }
+    MTXMQ_INLINE vec vbcast(const double* p) { return _mm512_set1_pd(*p); }
+    MTXMQ_INLINE vec vbcast2(const double* p) {
+        return _mm512_broadcast_f64x4(_mm256_broadcast_pd((const __m128d*) p));
+    }
+    MTXMQ_INLINE vec vfma(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+    MTXMQ_INLINE vec vload(const double* p) { return _mm512_loadu_pd(p); }
+    MTXMQ_INLINE void vstore(double* p, vec v) { _mm512_storeu_pd(p, v); }
+    MTXMQ_INLINE vec vload_n(const double* p, int n) { return _mm512_maskz_loadu_pd(__mmask8((1u<<n)-1), p); }
+    MTXMQ_INLINE void vstore_n(double* p, vec v, int n) { _mm512_mask_storeu_pd(p, __mmask8((1u<<n)-1), v); }
+    MTXMQ_INLINE vec vdup(const double* p) {
+        return _mm512_permutexvar_pd(_mm512_set_epi64(3,3,2,2,1,1,0,0),
+                                     _mm512_castpd256_pd512(_mm256_loadu_pd(p)));
+    }
+    MTXMQ_INLINE vec vswap(vec v) { return _mm512_permute_pd(v, 0x55); }
+    MTXMQ_INLINE vec vaddsub(vec a, vec b) { return _mm512_fmaddsub_pd(a, _mm512_set1_pd(1.0), b); }
+
+#endif
+
+    /// vdup() reading only the first \c n doubles of the output (n/2 of the input)
+    MTXMQ_INLINE vec vdup_n(const double* p, int n) {
+        double tmp[W/2];
+        for (int i=0; i<W/2; ++i) tmp[i] = (2*i < n) ? p[i] : 0.0;
+        return vdup(tmp);
+    }
+
+    /// Rows per block for \c NV vectors and \c NB accumulators per element
+    template <int NV, int NB>
+    struct Rows {
+        static const int n = (NACC/(NV*NB) > 8) ? 8 : ((NACC/(NV*NB) < 1) ? 1 : NACC/(NV*NB));
+    };
+
+    // ---------------------------------------------------------------------
+    // Micro kernels ... c(r,0:(NV-1)*W+last) for MR rows.  The row of b and
+    // the a(k,i) elements advance by ldb and lda doubles per k.
+
+    /// real*real and real*complex
+    template <int MR, int NV>
+    MTXMQ_TARGET void kern_r(long dimk, const double* a, long lda, const double* b, long ldb,
+                             double* c, long ldc, int last) {
+        vec acc[MR][NV];
+        for (int r=0; r<MR; ++r)
+            for (int v=0; v<NV; ++v) acc[r][v] = vzero();
+
+        for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+            vec bv[NV];
+            for (int v=0; v<NV-1; ++v) bv[v] = vload(b+v*W);
+            bv[NV-1] = (last == W) ? vload(b+(NV-1)*W) : vload_n(b+(NV-1)*W, last);
+            for (int r=0; r<MR; ++r) {
+                const vec ar = vbcast(a+r);
+                for (int v=0; v<NV; ++v) acc[r][v] = vfma(ar, bv[v], acc[r][v]);
+            }
+        }
+
+        for (int r=0; r<MR; ++r, c+=ldc) {
+            for (int v=0; v<NV-1; ++v) vstore(c+v*W, acc[r][v]);
+            if (last == W) vstore(c+(NV-1)*W, acc[r][NV-1]);
+            else vstore_n(c+(NV-1)*W, acc[r][NV-1], last);
+        }
+    }
+
+    /// complex*real ... b is real with half as many columns as c has doubles
+    template <int MR, int NV>
+    MTXMQ_TARGET void kern_cr(long dimk, const double* a, long lda, const double* b, long ldb,
+                              double* c, long ldc, int last) {
+        vec acc[MR][NV];
+        for (int r=0; r<MR; ++r)
+            for (int v=0; v<NV; ++v) acc[r][v] = vzero();
+
+        for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+            vec bv[NV];
+            for (int v=0; v<NV-1; ++v) bv[v] = vdup(b+v*(W/2));
+            bv[NV-1] = (last == W) ? vdup(b+(NV-1)*(W/2)) : vdup_n(b+(NV-1)*(W/2), last);
+            for (int r=0; r<MR; ++r) {
+                const vec ar = vbcast2(a+2*r);
+                for (int v=0; v<NV; ++v) acc[r][v] = vfma(ar, bv[v], acc[r][v]);
+            }
+        }
+
+        for (int r=0; r<MR; ++r, c+=ldc) {
+            for (int v=0; v<NV-1; ++v) vstore(c+v*W, acc[r][v]);
+            if (last == W) vstore(c+(NV-1)*W, acc[r][NV-1]);
+            else vstore_n(c+(NV-1)*W, acc[r][NV-1], last);
+        }
+    }
+
+    /// complex*complex
+    template <int MR, int NV>
+    MTXMQ_TARGET void kern_cc(long dimk, const double* a, long lda, const double* b, long ldb,
+                              double* c, long ldc, int last) {
+        vec accr[MR][NV], acci[MR][NV];
+        for (int r=0; r<MR; ++r)
+            for (int v=0; v<NV; ++v) accr[r][v] = acci[r][v] = vzero();
+
+        for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+            vec bv[NV];
+            for (int v=0; v<NV-1; ++v) bv[v] = vload(b+v*W);
+            bv[NV-1] = (last == W) ? vload(b+(NV-1)*W) : vload_n(b+(NV-1)*W, last);
+            for (int r=0; r<MR; ++r) {
+                const vec ar = vbcast(a+2*r);
+                const vec ai = vbcast(a+2*r+1);
+                for (int v=0; v<NV; ++v) {
+                    accr[r][v] = vfma(ar, bv[v], accr[r][v]);
+                    acci[r][v] = vfma(ai, bv[v], acci[r][v]);
+                }
+            }
+        }
+
+        for (int r=0; r<MR; ++r, c+=ldc) {
+            for (int v=0; v<NV-1; ++v) vstore(c+v*W, vaddsub(accr[r][v], vswap(acci[r][v])));
+            const vec t = vaddsub(accr[r][NV-1], vswap(acci[r][NV-1]));
+            if (last == W) vstore(c+(NV-1)*W, t);
+            else vstore_n(c+(NV-1)*W, t, last);
+        }
+    }
+
+    // ---------------------------------------------------------------------
+    // Drivers
+
+    /// Selects the micro kernel ... KIND is 0 for real a, 1 for complex*real, 2 for complex*complex
+    template <int KIND, int MR, int NV> struct Kern;
+
+    template <int MR, int NV> struct Kern<0,MR,NV> {
+        MTXMQ_TARGET static void run(long dimk, const double* a, long lda, const double* b, long ldb,
+                                     double* c, long ldc, int last) {
+            kern_r<MR,NV>(dimk, a, lda, b, ldb, c, ldc, last);
+        }
+    };
+
+    template <int MR, int NV> struct Kern<1,MR,NV> {
+        MTXMQ_TARGET static void run(long dimk, const double* a, long lda, const double* b, long ldb,
+                                     double* c, long ldc, int last) {
+            kern_cr<MR,NV>(dimk, a, lda, b, ldb, c, ldc, last);
+        }
+    };
+
+    template <int MR, int NV> struct Kern<2,MR,NV> {
+        MTXMQ_TARGET static void run(long dimk, const double* a, long lda, const double* b, long ldb,
+                                     double* c, long ldc, int last) {
+            kern_cc<MR,NV>(dimk, a, lda, b, ldb, c, ldc, last);
+        }
+    };
+
+    /// Rows left over after the blocks of MR, one kernel instance per count
+    template <int R, int NV, int KIND>
+    struct RowTail {
+        MTXMQ_TARGET static void run(int nrow, long dimk, const double* a, long lda,
+                                     const double* b, long ldb, double* c, long ldc, int last) {
+            if (nrow == R) Kern<KIND,R,NV>::run(dimk, a, lda, b, ldb, c, ldc, last);
+            else RowTail<R-1,NV,KIND>::run(nrow, dimk, a, lda, b, ldb, c, ldc, last);
+        }
+    };
+
+    template <int NV, int KIND>
+    struct RowTail<0,NV,KIND> {
+        MTXMQ_TARGET static void run(int, long, const double*, long, const double*, long, double*, long, int) {}
+    };
+
+    /// All rows of c for one panel of columns
+    template <int NV, int KIND>
+    MTXMQ_TARGET void panel(long dimi, long dimk, const double* a, long lda,
+                            const double* b, long ldb, double* c, long ldc, int last) {
+        const int MR = Rows<NV, (KIND==2 ? 2 : 1)>::n;
+        const int as = (KIND == 0) ? 1 : 2; // doubles per element of a
+        long i = 0;
+        for (; i+MR<=dimi; i+=MR)
+            Kern<KIND,MR,NV>::run(dimk, a+i*as, lda, b, ldb, c+i*ldc, ldc, last);
+        if (i < dimi)
+            RowTail<MR-1,NV,KIND>::run(dimi-i, dimk, a+i*as, lda, b, ldb, c+i*ldc, ldc, last);
+    }
+
+    /// Sweeps the panels of columns of c
+
+    /// \c ncol and \c ldc are in doubles of c, \c ldb in doubles of b, \c lda
+    /// in doubles of a.  For complex*real b advances half as fast as c.
+    template <int KIND>
+    MTXMQ_TARGET void mtxmq(long dimi, long ncol, long dimk, double* c, long ldc,
+                            const double* a, long lda, const double* b, long ldb) {
+        const long PW = NVMAX*W;
+        for (long j0=0; j0<ncol; j0+=PW) {
+            const long jn = (ncol-j0 < PW) ? ncol-j0 : PW;
+            const int nv = (jn+W-1)/W;
+            const int last = jn - (nv-1)*W;
+            const double* bj = b + ((KIND == 1) ? j0/2 : j0);
+            double* cj = c + j0;
+            switch (nv) {
+            case 1: panel<1,KIND>(dimi, dimk, a, lda, bj, ldb, cj, ldc, last); break;
+            case 2: panel<2,KIND>(dimi, dimk, a, lda, bj, ldb, cj, ldc, last); break;
+            case 3: panel<3,KIND>(dimi, dimk, a, lda, bj, ldb, cj, ldc, last); break;
+            case 4: panel<4,KIND>(dimi, dimk, a, lda, bj, ldb, cj, ldc, last); break;
+            case 5: panel<5,KIND>(dimi, dimk, a, lda, bj, ldb, cj, ldc, last); break;
+#if defined(MTXMQ_AVX2)
+            case 6: panel<6,KIND>(dimi, dimk, a, lda, bj, ldb, cj, ldc, last); break;
+#endif
+            }
+        }
+    }
+
+    // ---------------------------------------------------------------------
+    // Entry points for the dispatch table
+
+    MTXMQ_TARGET void mtxmq_dd(long dimi, long dimj, long dimk, double* c,
+                               const double* a, const double* b, long ldb) {
+        mtxmq<0>(dimi, dimj, dimk, c, dimj, a, dimi, b, ldb);
+    }
+
+    MTXMQ_TARGET void mtxmq_zz(long dimi, long dimj, long dimk, double* c,
+                               const double* a, const double* b, long ldb) {
+        mtxmq<2>(dimi, 2*dimj, dimk, c, 2*dimj, a, 2*dimi, b, 2*ldb);
+    }
+
+    MTXMQ_TARGET void mtxmq_dz(long dimi, long dimj, long dimk, double* c,
+                               const double* a, const double* b, long ldb) {
+        mtxmq<0>(dimi, 2*dimj, dimk, c, 2*dimj, a, dimi, b, 2*ldb);
+    }
+
+    MTXMQ_TARGET void mtxmq_zd(long dimi, long dimj, long dimk, double* c,
+                               const double* a, const double* b, long ldb) {
+        mtxmq<1>(dimi, 2*dimj, dimk, c, 2*dimj, a, 2*dimi, b, ldb);
+    }
+
+    // ---------------------------------------------------------------------
+    // Single precision real*real, the same scheme with float vectors
+
+    namespace sp {
+
+#if defined(MTXMQ_AVX2)
+
+        typedef __m256 vec;
+        const int W = 8;            // floats per vector
+
+        MTXMQ_INLINE vec vzero() { return _mm256_setzero_ps(); }
+        MTXMQ_INLINE vec vbcast(const float* p) { return _mm256_broadcast_ss(p); }
+        MTXMQ_INLINE vec vfma(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+        MTXMQ_INLINE vec vload(const float* p) { return _mm256_loadu_ps(p); }
+        MTXMQ_INLINE void vstore(float* p, vec v) { _mm256_storeu_ps(p, v); }
+        MTXMQ_INLINE __m256i vmask(int n) {
+            return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_set_epi32(7,6,5,4,3,2,1,0));
+        }
+        MTXMQ_INLINE vec vload_n(const float* p, int n) { return _mm256_maskload_ps(p, vmask(n)); }
+        MTXMQ_INLINE void vstore_n(float* p, vec v, int n) { _mm256_maskstore_ps(p, vmask(n), v); }
+
+#elif defined(MTXMQ_AVX512)
+
+        typedef __m512 vec;
+        const int W = 16;
+
+        MTXMQ_INLINE vec vzero() { return _mm512_setzero_ps(); }
+        MTXMQ_INLINE vec vbcast(const float* p) { return _mm512_set1_ps(*p); }
+        MTXMQ_INLINE vec vfma(vec a, vec b, vec c) { return _mm512_fmadd_ps(a, b, c); }
+        MTXMQ_INLINE vec vload(const float* p) { return _mm512_loadu_ps(p); }
+        MTXMQ_INLINE void vstore(float* p, vec v) { _mm512_storeu_ps(p, v); }
+        MTXMQ_INLINE vec vload_n(const float* p, int n) { return _mm512_maskz_loadu_ps(__mmask16((1u<<n)-1), p); }
+        MTXMQ_INLINE void vstore_n(float* p, vec v, int n) { _mm512_mask_storeu_ps(p, __mmask16((1u<<n)-1), v); }
+
+#endif
+
+        template <int MR, int NV>
+        MTXMQ_TARGET void kern(long dimk, const float* a, long lda, const float* b, long ldb,
+                               float* c, long ldc, int last) {
+            vec acc[MR][NV];
+            for (int r=0; r<MR; ++r)
+                for (int v=0; v<NV; ++v) acc[r][v] = vzero();
+
+            for (long k=0; k<dimk; ++k, a+=lda, b+=ldb) {
+                vec bv[NV];
+                for (int v=0; v<NV-1; ++v) bv[v] = vload(b+v*W);
+                bv[NV-1] = (last == W) ? vload(b+(NV-1)*W) : vload_n(b+(NV-1)*W, last);
+                for (int r=0; r<MR; ++r) {
+                    const vec ar = vbcast(a+r);
+                    for (int v=0; v<NV; ++v) acc[r][v] = vfma(ar, bv[v], acc[r][v]);
+                }
+            }
+
+            for (int r=0; r<MR; ++r, c+=ldc) {
+                for (int v=0; v<NV-1; ++v) vstore(c+v*W, acc[r][v]);
+                if (last == W) vstore(c+(NV-1)*W, acc[r][NV-1]);
+                else vstore_n(c+(NV-1)*W, acc[r][NV-1], last);
+            }
+        }
+
+        template <int R, int NV>
+        struct RowTail {
+            MTXMQ_TARGET static void run(int nrow, long dimk, const float* a, long lda,
+                                         const float* b, long ldb, float* c, long ldc, int last) {
+                if (nrow == R) kern<R,NV>(dimk, a, lda, b, ldb, c, ldc, last);
+                else RowTail<R-1,NV>::run(nrow, dimk, a, lda, b, ldb, c, ldc, last);
+            }
+        };
+
+        template <int NV>
+        struct RowTail<0,NV> {
+            MTXMQ_TARGET static void run(int, long, const float*, long, const float*, long, float*, long, int) {}
+        };
+
+        template <int NV>
+        MTXMQ_TARGET void panel(long dimi, long dimk, const float* a, const float* b, long ldb,
+                                float* c, long ldc, int last) {
+            const int MR = Rows<NV,1>::n;
+            long i = 0;
+            for (; i+MR<=dimi; i+=MR)
+                kern<MR,NV>(dimk, a+i, dimi, b, ldb, c+i*ldc, ldc, last);
+            if (i < dimi)
+                RowTail<MR-1,NV>::run(dimi-i, dimk, a+i, dimi, b, ldb, c+i*ldc, ldc, last);
+        }
+
+    } // namespace sp
+
+    MTXMQ_TARGET void mtxmq_ss(long dimi, long dimj, long dimk, float* c,
+                               const float* a, const float* b, long ldb) {
+        const long PW = NVMAX*sp::W;
+        for (long j0=0; j0<dimj; j0+=PW) {
+            const long jn = (dimj-j0 < PW) ? dimj-j0 : PW;
+            const int nv = (jn+sp::W-1)/sp::W;
+            const int last = jn - (nv-1)*sp::W;
+            switch (nv) {
+            case 1: sp::panel<1>(dimi, dimk, a, b+j0, ldb, c+j0, dimj, last); break;
+            case 2: sp::panel<2>(dimi, dimk, a, b+j0, ldb, c+j0, dimj, last); break;
+            case 3: sp::panel<3>(dimi, dimk, a, b+j0, ldb, c+j0, dimj, last); break;
+            case 4: sp::panel<4>(dimi, dimk, a, b+j0, ldb, c+j0, dimj, last); break;
+            case 5: sp::panel<5>(dimi, dimk, a, b+j0, ldb, c+j0, dimj, last); break;
+#if defined(MTXMQ_AVX2)
+            case 6: sp::panel<6>(dimi, dimk, a, b+j0, ldb, c+j0, dimj, last); break;
+#endif
+            }
+        }
+    }
+
+#undef MTXMQ_INLINE
+
+} // namespace MTXMQ_NS
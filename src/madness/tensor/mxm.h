@@ -39,6 +39,8 @@
 
 #ifdef HAVE_INTEL_MKL
 #include <madness/tensor/cblas.h>
+#else
+#include <madness/tensor/mtxmq_simd.h>
 #endif
 
 /// \file tensor/mxm.h
@@ -597,25 +599,81 @@ namespace madness {
         bgpmTxmq(ni, nj, nk, c, a, b);
     }
 
-// #elif defined(X86_64) && !defined(DISABLE_SSE3)
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double* restrict c, const double* a, const double* b);
-
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double_complex* restrict c, const double_complex* a, const double_complex* b);
-
-// #ifndef __INTEL_COMPILER
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double_complex* restrict c, const double_complex* a, const double* b);
-// #endif
-
-// #elif defined(X86_32)
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double* restrict c, const double* a, const double* b);
+#elif defined(MADNESS_HAVE_MTXMQ_SIMD)
+    // AVX2/AVX-512 kernels selected at startup (see mtxmq_simd.h); the
+    // reference loops are used if the processor has neither
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      double* restrict c, const double* a, const double* b, long ldb) {
+        if (ldb == -1) ldb=dimj;
+        MADNESS_ASSERT(ldb>=dimj);
+        if (!detail::mTxmq_simd(dimi, dimj, dimk, c, a, b, ldb))
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      std::complex<double>* restrict c, const std::complex<double>* a, const std::complex<double>* b, long ldb) {
+        if (ldb == -1) ldb=dimj;
+        MADNESS_ASSERT(ldb>=dimj);
+        if (!detail::mTxmq_simd(dimi, dimj, dimk, c, a, b, ldb))
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      std::complex<double>* restrict c, const double* a, const std::complex<double>* b, long ldb) {
+        if (ldb == -1) ldb=dimj;
+        MADNESS_ASSERT(ldb>=dimj);
+        if (!detail::mTxmq_simd(dimi, dimj, dimk, c, a, b, ldb))
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      std::complex<double>* restrict c, const std::complex<double>* a, const double* b, long ldb) {
+        if (ldb == -1) ldb=dimj;
+        MADNESS_ASSERT(ldb>=dimj);
+        if (!detail::mTxmq_simd(dimi, dimj, dimk, c, a, b, ldb))
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    inline void mTxmq(long dimi, long dimj, long dimk,
+                      float* restrict c, const float* a, const float* b, long ldb) {
+        if (ldb == -1) ldb=dimj;
+        MADNESS_ASSERT(ldb>=dimj);
+        if (!detail::mTxmq_simd(dimi, dimj, dimk, c, a, b, ldb))
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    // The kernels take the stride of b directly so no padded copies are needed
+
+    template <>
+    inline void mTxmq_padding(long ni, long nj, long nk, long ej,
+                              double* c, const double* a, const double* b) {
+        mTxmq(ni, nj, nk, c, a, b, ej);
+    }
+
+    template <>
+    inline void mTxmq_padding(long ni, long nj, long nk, long ej,
+                              std::complex<double>* c, const std::complex<double>* a, const std::complex<double>* b) {
+        mTxmq(ni, nj, nk, c, a, b, ej);
+    }
+
+    template <>
+    inline void mTxmq_padding(long ni, long nj, long nk, long ej,
+                              std::complex<double>* c, const double* a, const std::complex<double>* b) {
+        mTxmq(ni, nj, nk, c, a, b, ej);
+    }
+
+    template <>
+    inline void mTxmq_padding(long ni, long nj, long nk, long ej,
+                              std::complex<double>* c, const std::complex<double>* a, const double* b) {
+        mTxmq(ni, nj, nk, c, a, b, ej);
+    }
+
 #endif // HAVE_IBMBGQ
 
 #endif // HAVE_INTEL_MKL
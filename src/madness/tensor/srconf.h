@@ -409,72 +409,137 @@ namespace madness {
 
 		/// reduce the rank using a divide-and-conquer approach
 		void divide_and_conquer_reduce(const double& thresh) {
+			divide_and_conquer_reduce(std::vector<SRConf<T>*>(1,this),thresh);
+		}
 
-			if (has_no_data()) return;
-			if (rank()==1) {
-				normalize();
-				return;
-			}
+		/// reduce the rank of several SRConfs using a divide-and-conquer approach
+
+		/// the configurations are split into chunks of at most chunksize
+		/// configurations, which are orthonormalized and then added pairwise
+		/// level by level; all chunks of one level are processed together, so
+		/// that their small decompositions are batched (see ortho3 and ortho5)
+		static void divide_and_conquer_reduce(const std::vector<SRConf<T>*>& confs, const double& thresh) {
 
-			// divide the SRConf into two
 			const long chunksize=8;
-			if (rank()>chunksize) {
-        		SRConf<T> chunk1=this->get_configs(0,rank()/2);
-        		SRConf<T> chunk2=this->get_configs(rank()/2+1,rank()-1);
-        		chunk1.divide_and_conquer_reduce(thresh*0.5);
-        		chunk2.divide_and_conquer_reduce(thresh*0.5);
 
-        		// collect the two SRConfs
-        		*this=chunk1;
-        		this->add_SVD(chunk2,thresh);
+			// the tree of chunks, split breadth first; the children of chunk i
+			// are child[i] and child[i]+1, or child[i]<0 for a leaf
+			std::vector<SRConf<T> > chunk;
+			std::vector<double> chunk_thresh;
+			std::vector<long> child, level, root;
+			for (size_t i=0; i<confs.size(); ++i) {
+				if (confs[i]->has_no_data()) continue;
+				root.push_back(chunk.size());
+				chunk.push_back(*confs[i]);
+				chunk_thresh.push_back(thresh);
+				level.push_back(0);
+			}
+			long maxlevel=0;
+			for (size_t i=0; i<chunk.size(); ++i) {
+				child.push_back(-1);
+				const long rank=chunk[i].rank();
+				if (chunk[i].type()==TT_FULL or rank<=chunksize) continue;
+
+				// divide the SRConf into two
+				SRConf<T> chunk1=chunk[i].get_configs(0,rank/2);
+				SRConf<T> chunk2=chunk[i].get_configs(rank/2+1,rank-1);
+				child[i]=chunk.size();
+				chunk.push_back(chunk1);
+				chunk.push_back(chunk2);
+				chunk_thresh.push_back(chunk_thresh[i]*0.5);
+				chunk_thresh.push_back(chunk_thresh[i]*0.5);
+				level.push_back(level[i]+1);
+				level.push_back(level[i]+1);
+				maxlevel=std::max(maxlevel,level[i]+1);
+			}
 
-			} else {
+			// reduce the rank of the leaves
+			std::vector<SRConf<T>*> leaves;
+			std::vector<double> leaf_thresh;
+			for (size_t i=0; i<chunk.size(); ++i) {
+				if (child[i]>=0) continue;
+				leaves.push_back(&chunk[i]);
+				leaf_thresh.push_back(chunk_thresh[i]);
+			}
+			orthonormalize(leaves,leaf_thresh);
+
+			// collect the two SRConfs of each split, deepest level first
+			for (long l=maxlevel-1; l>=0; --l) {
+				std::vector<SRConf<T>*> lhs;
+				std::vector<const SRConf<T>*> rhs;
+				std::vector<double> add_thresh;
+				for (size_t i=0; i<chunk.size(); ++i) {
+					if (level[i]!=l or child[i]<0) continue;
+					chunk[i]=chunk[child[i]];
+					lhs.push_back(&chunk[i]);
+					rhs.push_back(&chunk[child[i]+1]);
+					add_thresh.push_back(chunk_thresh[i]);
+				}
+				add_SVD(lhs,rhs,add_thresh);
+			}
 
-				// and reduce the rank
-				this->orthonormalize(thresh);
+			for (size_t i=0, r=0; i<confs.size(); ++i) {
+				if (confs[i]->has_no_data()) continue;
+				*confs[i]=chunk[root[r++]];
+				MADNESS_ASSERT(confs[i]->has_structure());
 			}
-            MADNESS_ASSERT(has_structure());
 		}
 
 	public:
 		/// orthonormalize this
 		void orthonormalize(const double& thresh) {
+			orthonormalize(std::vector<SRConf<T>*>(1,this),std::vector<double>(1,thresh));
+		}
+
+		/// orthonormalize several SRConfs, each with its own threshold
+		static void orthonormalize(const std::vector<SRConf<T>*>& confs, const std::vector<double>& thresh) {
 
-			if (type()==TT_FULL) return;
-			if (has_no_data()) return;
-			if (rank()==1) {
-				normalize();
-				return;
-			}
 #ifdef BENCH
 			double cpu0=wall_time();
 #endif
-//			vector_[0]=copy(vector_[0](c0()));
-//			vector_[1]=copy(vector_[1](c0()));
-//			weights_=weights_(Slice(0,rank()-1));
-            normalize();
+			std::vector<SRConf<T>*> todo;
+			std::vector<double> todo_thresh;
+			for (size_t i=0; i<confs.size(); ++i) {
+				SRConf<T>& c=*confs[i];
+				if (c.type()==TT_FULL) continue;
+				if (c.has_no_data()) continue;
+				c.normalize();
+				if (c.rank()==1) continue;
+				c.weights_=c.weights_(Slice(0,c.rank()-1));
+				todo.push_back(&c);
+				todo_thresh.push_back(thresh[i]);
+			}
 #ifdef BENCH
 			double cpu1=wall_time();
 #endif
-//            this->undo_structure();
-			weights_=weights_(Slice(0,rank()-1));
-//			ortho3(vector_[0],vector_[1],weights_,thresh);
-            tensorT v0=flat_vector(0);
-            tensorT v1=flat_vector(1);
+			const long n=todo.size();
+			std::vector<tensorT> v0(n), v1(n);
+			std::vector<tensorT*> pv0(n), pv1(n);
+			std::vector<Tensor<double>*> pw(n);
+			for (long i=0; i<n; ++i) {
+				v0[i]=todo[i]->flat_vector(0);
+				v1[i]=todo[i]->flat_vector(1);
+				pv0[i]=&v0[i];
+				pv1[i]=&v1[i];
+				pw[i]=&todo[i]->weights_;
+			}
 #ifdef BENCH
 			double cpu2=wall_time();
 #endif
-			ortho3(v0,v1,weights_,thresh);
-            std::swap(vector_[0],v0);
-            std::swap(vector_[1],v1);
+			ortho3(pv0,pv1,pw,todo_thresh);
 #ifdef BENCH
 			double cpu3=wall_time();
 #endif
-			rank_=weights_.size();
-			MADNESS_ASSERT(rank_>=0);
-			this->make_structure();
-			make_slices();
-            MADNESS_ASSERT(has_structure());
+			for (long i=0; i<n; ++i) {
+				SRConf<T>& c=*todo[i];
+				std::swap(c.vector_[0],v0[i]);
+				std::swap(c.vector_[1],v1[i]);
+				c.rank_=c.weights_.size();
+				MADNESS_ASSERT(c.rank_>=0);
+				c.make_structure();
+				c.make_slices();
+				MADNESS_ASSERT(c.has_structure());
+			}
 #ifdef BENCH
 			double cpu4=wall_time();
 			SRConf<T>::time(21)+=cpu1-cpu0;
@@ -528,25 +593,105 @@ namespace madness {
 
 		/// add two orthonormal configurations, yielding an optimal SVD decomposition
 		void add_SVD(const SRConf<T>& rhs, const double& thresh) {
-#ifdef BENCH
-			double cpu0=wall_time();
-#endif
+			add_SVD(std::vector<SRConf<T>*>(1,this),std::vector<const SRConf<T>*>(1,&rhs),
+					std::vector<double>(1,thresh));
+		}
+
+		/// reduce the rank using a randomized range finder (see ortho_randomized)
+		void randomized_reduce(const double& thresh) {
+			if (type()==TT_FULL or has_no_data()) return;
+			randomized_update(0,thresh);
+		}
+
+		/// add rhs to this orthonormal configuration using a randomized range finder
+
+		/// rhs need not be orthonormal; only its configurations are sampled,
+		/// the subspace of this is kept as a starting point
+		void add_randomized(const SRConf<T>& rhs, const double& thresh) {
 			if (rhs.has_no_data()) return;
 			if (has_no_data()) {
-				*this=rhs;
+				*this=copy(rhs);
+				randomized_reduce(thresh);
 				return;
 			}
-
 			if (check_orthonormality) check_right_orthonormality();
-            if (check_orthonormality) rhs.check_right_orthonormality();
+			const long northo=rank();
+			append(rhs,1.0);
+			randomized_update(northo,thresh);
+		}
 
-            this->undo_structure();
-            ortho5(ref_vector(0),ref_vector(1),weights_,
-					rhs.flat_vector(0),rhs.flat_vector(1),rhs.weights_,thresh);
+		/// reduce the rank, the first northo configurations being orthonormal
+		void randomized_update(const long northo, const double& thresh) {
+#ifdef BENCH
+			double cpu0=wall_time();
+#endif
+			tensorT x=flat_vector(0);
+			tensorT y=flat_vector(1);
+			Tensor<double> w=weights_(Slice(0,rank()-1));
+			ortho_randomized(x,y,w,northo,thresh);
+			vector_[0]=x;
+			vector_[1]=y;
+			weights_=w;
 			rank_=weights_.size();
 			make_structure();
 			make_slices();
-            MADNESS_ASSERT(has_structure());
+			MADNESS_ASSERT(has_structure());
+#ifdef BENCH
+			double cpu1=wall_time();
+			time(26)+=cpu1-cpu0;
+#endif
+		}
+
+		/// lhs[i] += rhs[i] for orthonormal configurations, yielding optimal SVD decompositions
+		static void add_SVD(const std::vector<SRConf<T>*>& lhs, const std::vector<const SRConf<T>*>& rhs,
+				const std::vector<double>& thresh) {
+#ifdef BENCH
+			double cpu0=wall_time();
+#endif
+			std::vector<SRConf<T>*> todo;
+			std::vector<double> todo_thresh;
+			std::vector<tensorT> x2, y2;
+			std::vector<const Tensor<double>*> w2;
+			for (size_t i=0; i<lhs.size(); ++i) {
+				SRConf<T>& l=*lhs[i];
+				const SRConf<T>& r=*rhs[i];
+				if (r.has_no_data()) continue;
+				if (l.has_no_data()) {
+					l=r;
+					continue;
+				}
+
+				if (check_orthonormality) l.check_right_orthonormality();
+				if (check_orthonormality) r.check_right_orthonormality();
+
+				l.undo_structure();
+				todo.push_back(&l);
+				todo_thresh.push_back(thresh[i]);
+				x2.push_back(r.flat_vector(0));
+				y2.push_back(r.flat_vector(1));
+				w2.push_back(&r.weights_);
+			}
+
+			const long n=todo.size();
+			std::vector<tensorT*> x1(n), y1(n);
+			std::vector<Tensor<double>*> w1(n);
+			std::vector<const tensorT*> px2(n), py2(n);
+			for (long i=0; i<n; ++i) {
+				x1[i]=&todo[i]->ref_vector(0);
+				y1[i]=&todo[i]->ref_vector(1);
+				w1[i]=&todo[i]->weights_;
+				px2[i]=&x2[i];
+				py2[i]=&y2[i];
+			}
+			ortho5(x1,y1,w1,px2,py2,w2,todo_thresh);
+
+			for (long i=0; i<n; ++i) {
+				SRConf<T>& l=*todo[i];
+				l.rank_=l.weights_.size();
+				l.make_structure();
+				l.make_slices();
+				MADNESS_ASSERT(l.has_structure());
+			}
 #ifdef BENCH
 			double cpu1=wall_time();
 			time(25)+=cpu1-cpu0;
@@ -1283,385 +1428,479 @@ protected:
 
 	};
 
-	/// sophisticated version of ortho2
+	/// ortho3 for several configurations at once
 
-	/// after calling this we will have an optimally rank-reduced representation
-	/// with the left and right subspaces being bi-orthogonal and normalized;
-	/// outline of the algorithm:
-	///  - canonical orthogonalization of the subspaces (screen for small eigenvalues)
-	///  - SVD of the modified overlap (incorporates the roots of eigenvalues)
-	/// operation count is O(kr^2 + r^3)
-	///
-	/// @param[in,out]	x normalized left subspace
-	/// @param[in,out]	y normalize right subspace
-	/// @param[in,out]	weights weights
-	/// @param[in]		thresh	truncation threshold
+	/// the small eigenvalue and singular value decompositions of all
+	/// configurations are done together by syev_batched and svd_batched
 	template<typename T>
-	void ortho3(Tensor<T>& x, Tensor<T>& y, Tensor<double>& weights, const double& thresh) {
+	void ortho3(const std::vector<Tensor<T>*>& x, const std::vector<Tensor<T>*>& y,
+			const std::vector<Tensor<double>*>& weights, const std::vector<double>& thresh) {
 
 #ifdef BENCH
 		double cpu0=wall_time();
 #endif
 		typedef Tensor<T> tensorT;
-
-		const long rank=x.dim(0);
-		const double w_max=weights.absmax()*rank;		// max Frobenius norm
-
+		const long nconf=x.size();
 
 		// overlap of 1 and 2
-		tensorT S1=inner(x,x,1,1);
-		tensorT S2=inner(y,y,1,1);	// 0.5 / 2.1
+		std::vector<tensorT> S(2*nconf);
+		for (long c=0; c<nconf; ++c) {
+			S[2*c]=inner(*x[c],*x[c],1,1);
+			S[2*c+1]=inner(*y[c],*y[c],1,1);	// 0.5 / 2.1
+		}
 #ifdef BENCH
 		double cpu1=wall_time();
 		SRConf<T>::time(1)+=(cpu1-cpu0);
 #endif
 
-//	    print("norm(S1)",S1.normf());
-//	    print("norm(S2)",S2.normf());
-
 		// diagonalize
-		tensorT U1, U2;
-		Tensor<double> e1, e2;
-	    syev(S1,U1,e1);
-	    syev(S2,U2,e2);										// 2.3 / 4.0
+		std::vector<tensorT> U;
+		std::vector<Tensor<double> > e;
+		syev_batched(S,U,e);								// 2.3 / 4.0
 #ifdef BENCH
 		double cpu3=wall_time();
 		SRConf<T>::time(3)+=cpu3-cpu1;
 #endif
 
-	    const double e1_max=e1.absmax();
-	    const double e2_max=e2.absmax();
-
-		// fast return if possible
-		if ((e1_max*w_max<thresh) or (e2_max*w_max<thresh)) {
-			x.clear();
-			y.clear();
-			weights.clear();
-			return;
-		}
-
-	    // remove small negative eigenvalues
-	    e1.screen(1.e-13);
-	    e2.screen(1.e-13);
-	    Tensor<double> sqrt_e1(rank), sqrt_e2(rank);
-
+		std::vector<long> active;
+		std::vector<tensorT> M, U1, U2;
+		for (long c=0; c<nconf; ++c) {
+			const long rank=x[c]->dim(0);
+			const double w_max=weights[c]->absmax()*rank;		// max Frobenius norm
+			Tensor<double>& e1=e[2*c];
+			Tensor<double>& e2=e[2*c+1];
 
-	    // shrink U1, U2
-	    int lo1=0;
-	    int lo2=0;
-	    for (unsigned int r=0; r<rank; r++) {
-	    	if (e1(r)*w_max<thresh) lo1=r+1;
-	    	if (e2(r)*w_max<thresh) lo2=r+1;
-	    	sqrt_e1(r)=sqrt(std::abs(e1(r)));
-	    	sqrt_e2(r)=sqrt(std::abs(e2(r)));
-	    }
-
-	    U1=U1(Slice(_),Slice(lo1,-1));
-	    U2=U2(Slice(_),Slice(lo2,-1));
-	    sqrt_e1=sqrt_e1(Slice(lo1,-1));
-	    sqrt_e2=sqrt_e2(Slice(lo2,-1));
-	    unsigned int rank1=rank-lo1;
-	    unsigned int rank2=rank-lo2;						// 0.0 / 0.0
+			const double e1_max=e1.absmax();
+			const double e2_max=e2.absmax();
 
+			// fast return if possible
+			if ((e1_max*w_max<thresh[c]) or (e2_max*w_max<thresh[c])) {
+				x[c]->clear();
+				y[c]->clear();
+				weights[c]->clear();
+				continue;
+			}
 
-	    MADNESS_ASSERT(sqrt_e1.size()==rank1);
-	    MADNESS_ASSERT(sqrt_e2.size()==rank2);
-#ifdef BENCH
-		double cpu4=wall_time();
-		SRConf<T>::time(4)+=cpu4-cpu3;
-#endif
+			// remove small negative eigenvalues
+			e1.screen(1.e-13);
+			e2.screen(1.e-13);
+			Tensor<double> sqrt_e1(rank), sqrt_e2(rank);
+
+			// shrink U1, U2
+			int lo1=0;
+			int lo2=0;
+			for (unsigned int r=0; r<rank; r++) {
+				if (e1(r)*w_max<thresh[c]) lo1=r+1;
+				if (e2(r)*w_max<thresh[c]) lo2=r+1;
+				sqrt_e1(r)=sqrt(std::abs(e1(r)));
+				sqrt_e2(r)=sqrt(std::abs(e2(r)));
+			}
 
+			tensorT u1=U[2*c](Slice(_),Slice(lo1,-1));
+			tensorT u2=U[2*c+1](Slice(_),Slice(lo2,-1));
+			sqrt_e1=sqrt_e1(Slice(lo1,-1));
+			sqrt_e2=sqrt_e2(Slice(lo2,-1));
+			unsigned int rank1=rank-lo1;
+			unsigned int rank2=rank-lo2;
+
+			MADNESS_ASSERT(sqrt_e1.size()==rank1);
+			MADNESS_ASSERT(sqrt_e2.size()==rank2);
+
+			// set up overlap M; include X+
+			const Tensor<double>& w=*weights[c];
+			tensorT m(rank1,rank2);
+			for (unsigned int i=0; i<rank1; i++) {
+				for (unsigned int j=0; j<rank2; j++) {
+					for (unsigned int r=0; r<rank; r++) {
+						m(i,j)+=u1(r,i)*sqrt_e1(i)*w(r)*u2(r,j) * sqrt_e2(j);
+					}
+				}
+			}
 
-	    // set up overlap M; include X+
-	    tensorT M(rank1,rank2);
-	    for (unsigned int i=0; i<rank1; i++) {
-	    	for (unsigned int j=0; j<rank2; j++) {
-	    		for (unsigned int r=0; r<rank; r++) {
-		    		M(i,j)+=U1(r,i)*sqrt_e1(i)*weights(r)*U2(r,j) * sqrt_e2(j);
-//			    		M(i,j)+=U1(r,i)*weights(r)*U2(r,j);
-	    		}
-	    	}
-	    }
-
-
-	    // include X-
-    	for (unsigned int r=0; r<rank1; r++) {
-    		double fac=1.0/sqrt_e1(r);
-    		for (unsigned int t=0; t<rank; t++) {
-	    		U1(t,r)*=fac;
-//	    		if (sqrt_e1(r)<thresh) throw;
-    		}
-    	}
+			// include X-
+			for (unsigned int r=0; r<rank1; r++) {
+				double fac=1.0/sqrt_e1(r);
+				for (unsigned int t=0; t<rank; t++) u1(t,r)*=fac;
+			}
+			for (unsigned int r=0; r<rank2; r++) {
+				double fac=1.0/sqrt_e2(r);
+				for (unsigned int t=0; t<rank; t++) u2(t,r)*=fac;
+			}
 
-	   	for (unsigned int r=0; r<rank2; r++) {
-    		double fac=1.0/sqrt_e2(r);
-    		for (unsigned int t=0; t<rank; t++) {
-	    		U2(t,r)*=fac;
-//	    		if (sqrt_e2(r)<thresh) throw;
-	    	}
-	    }													// 0.2 / 0.6
+			active.push_back(c);
+			M.push_back(m);
+			U1.push_back(u1);
+			U2.push_back(u2);
+		}
 #ifdef BENCH
 		double cpu5=wall_time();
-		SRConf<T>::time(5)+=cpu5-cpu4;
+		SRConf<T>::time(5)+=cpu5-cpu3;
 #endif
 
-	    // decompose M
-		tensorT Up,VTp;
-		Tensor<double> Sp;
-		svd(M,Up,Sp,VTp);									// 1.5 / 3.0
+		// decompose M
+		std::vector<tensorT> Up,VTp;
+		std::vector<Tensor<double> > Sp;
+		svd_batched(M,Up,Sp,VTp);							// 1.5 / 3.0
 #ifdef BENCH
 		double cpu6=wall_time();
 		SRConf<T>::time(6)+=cpu6-cpu5;
 #endif
 
-		// make transformation matrices
-		Up=inner(Up,U1,0,1);
-		VTp=inner(VTp,U2,1,1);
-
-
-
-//		// find the maximal singular value that's supposed to contribute
-//		// singular values are ordered (largest first)
-//		double residual=0.0;
-//		long i;
-//		for (i=Sp.dim(0)-1; i>=0; i--) {
-//			residual+=Sp(i)*Sp(i);
-//			if (residual>thresh*thresh) break;
-//		}
-		long i=SRConf<T>::max_sigma(thresh,Sp.dim(0),Sp);
+		for (size_t a=0; a<active.size(); ++a) {
+			const long c=active[a];
 
-#ifdef BENCH
-		double cpu7=wall_time();
-		SRConf<T>::time(7)+=cpu7-cpu6;
-#endif
+			// make transformation matrices
+			tensorT up=inner(Up[a],U1[a],0,1);
+			tensorT vtp=inner(VTp[a],U2[a],1,1);
 
-//		i=std::min(i,long(0));
+			long i=SRConf<T>::max_sigma(thresh[c],Sp[a].dim(0),Sp[a]);
 
-	    Up=Up(Slice(0,i),Slice(_));
-	    VTp=VTp(Slice(0,i),Slice(_));
+			// convert SVD output to our convention
+			if (i>=0) {
 
+				// transform 1 and 2
+				*x[c]=inner(up(Slice(0,i),Slice(_)),*x[c],1,0);
+				*y[c]=inner(vtp(Slice(0,i),Slice(_)),*y[c],1,0);	// 0.5 / 2.5
+				*weights[c]=Sp[a](Slice(0,i));
 
-		// convert SVD output to our convention
-		if (i>=0) {
-
-			// transform 1 and 2
-		    x=inner(Up,x,1,0);
-		    y=inner(VTp,y,1,0);				// 0.5 / 2.5
-		    weights=Sp(Slice(0,i));
-
-		} else {
-			x.clear();
-			y.clear();
-			weights.clear();
+			} else {
+				x[c]->clear();
+				y[c]->clear();
+				weights[c]->clear();
+			}
 		}
 #ifdef BENCH
 		double cpu8=wall_time();
-		SRConf<T>::time(8)+=cpu8-cpu7;
+		SRConf<T>::time(8)+=cpu8-cpu6;
 		SRConf<T>::time(0)+=cpu8-cpu0;
 #endif
-		return;
 	}
 
-	/// specialized version of ortho3
+	/// sophisticated version of ortho2
 
-	/// does the same as ortho3, but takes two bi-orthonormal configs as input
-	/// and saves on the inner product. Result will be written onto the first config
+	/// after calling this we will have an optimally rank-reduced representation
+	/// with the left and right subspaces being bi-orthogonal and normalized;
+	/// outline of the algorithm:
+	///  - canonical orthogonalization of the subspaces (screen for small eigenvalues)
+	///  - SVD of the modified overlap (incorporates the roots of eigenvalues)
+	/// operation count is O(kr^2 + r^3)
 	///
-	/// @param[in,out]	x1	left subspace, will hold the result on exit
-	/// @param[in,out]	y1	right subspace, will hold the result on exit
-	/// @param[in]		x2	left subspace, will be accumulated onto x1
-	/// @param[in]		y2	right subspace, will be accumulated onto y1
+	/// @param[in,out]	x normalized left subspace
+	/// @param[in,out]	y normalize right subspace
+	/// @param[in,out]	weights weights
+	/// @param[in]		thresh	truncation threshold
 	template<typename T>
-	void ortho5(Tensor<T>& x1, Tensor<T>& y1, Tensor<double>& w1,
-				const Tensor<T>& x2, const Tensor<T>& y2, const Tensor<double>& w2,
-				const double& thresh) {
+	void ortho3(Tensor<T>& x, Tensor<T>& y, Tensor<double>& weights, const double& thresh) {
+		ortho3(std::vector<Tensor<T>*>(1,&x),std::vector<Tensor<T>*>(1,&y),
+				std::vector<Tensor<double>*>(1,&weights),std::vector<double>(1,thresh));
+	}
+
+	/// ortho5 for several pairs of configurations at once
+
+	/// the small eigenvalue and singular value decompositions of all
+	/// pairs are done together by syev_batched and svd_batched
+	template<typename T>
+	void ortho5(const std::vector<Tensor<T>*>& x1, const std::vector<Tensor<T>*>& y1,
+				const std::vector<Tensor<double>*>& w1,
+				const std::vector<const Tensor<T>*>& x2, const std::vector<const Tensor<T>*>& y2,
+				const std::vector<const Tensor<double>*>& w2, const std::vector<double>& thresh) {
 
 #ifdef BENCH
 		double cpu0=wall_time();
 #endif
 		typedef Tensor<T> tensorT;
-
-		const long rank1=x1.dim(0);
-		const long rank2=x2.dim(0);
-		const long rank=rank1+rank2;
-
-		// for convenience: blocks of the matrices
-		const Slice s0(0,rank1-1), s1(rank1,rank-1);
-
-		const double w_max=std::max(w1.absmax(),w2.absmax());
-		const double norm_max=w_max*rank;		// max Frobenius norm
+		const long nconf=x1.size();
 
 		// the overlap between 1 and 2;
 		// the overlap of 1 and 1, and 2 and 2 is assumed to be the identity matrix
-		tensorT Sx12=inner(x1,x2,1,1);
-		tensorT Sy12=inner(y1,y2,1,1);
-#ifdef BENCH
-		double cpu1=wall_time();
-		SRConf<T>::time(11)+=cpu1-cpu0;
-#endif
+		std::vector<tensorT> S(2*nconf);
+		for (long c=0; c<nconf; ++c) {
+			const long rank1=x1[c]->dim(0);
+			const long rank=rank1+x2[c]->dim(0);
 
-		tensorT Sx(rank,rank);
-		tensorT Sy(rank,rank);
+			// for convenience: blocks of the matrices
+			const Slice s0(0,rank1-1), s1(rank1,rank-1);
 
-		// the identity matrix (half of it)
-		for (long i=0; i<rank; i++) {
-			Sx(i,i)=0.5;
-			Sy(i,i)=0.5;
-		}
-		Sx(s0,s1)=Sx12;
-		Sy(s0,s1)=Sy12;
-		Sx+=transpose(Sx);
-		Sy+=transpose(Sy);
+			tensorT Sx(rank,rank);
+			tensorT Sy(rank,rank);
 
-		// overlap of 1 and 2
-//		tensorT S1=inner(x,x,1,1);
-//		tensorT S2=inner(y,y,1,1);	// 0.5 / 2.1
+			// the identity matrix (half of it)
+			for (long i=0; i<rank; i++) {
+				Sx(i,i)=0.5;
+				Sy(i,i)=0.5;
+			}
+			Sx(s0,s1)=inner(*x1[c],*x2[c],1,1);
+			Sy(s0,s1)=inner(*y1[c],*y2[c],1,1);
+			Sx+=transpose(Sx);
+			Sy+=transpose(Sy);
+			S[2*c]=Sx;
+			S[2*c+1]=Sy;
+		}
 #ifdef BENCH
 		double cpu2=wall_time();
-		SRConf<T>::time(12)+=cpu2-cpu1;
+		SRConf<T>::time(12)+=cpu2-cpu0;
 #endif
 
 		// diagonalize
-		tensorT U1, U2;
-		Tensor<double> e1, e2;
-	    syev(Sx,U1,e1);
-	    syev(Sy,U2,e2);										// 2.3 / 4.0
+		std::vector<tensorT> U;
+		std::vector<Tensor<double> > e;
+		syev_batched(S,U,e);								// 2.3 / 4.0
 #ifdef BENCH
 		double cpu3=wall_time();
 		SRConf<T>::time(13)+=cpu3-cpu2;
 #endif
 
-//	    print("norm(Sx)",Sx.normf());
-//	    print("norm(Sy)",Sy.normf());
+		std::vector<long> active;
+		std::vector<tensorT> M, U1, U2;
+		for (long c=0; c<nconf; ++c) {
+			const long rank1=x1[c]->dim(0);
+			const long rank=rank1+x2[c]->dim(0);
+			const double w_max=std::max(w1[c]->absmax(),w2[c]->absmax());
+			const double norm_max=w_max*rank;		// max Frobenius norm
+			Tensor<double>& e1=e[2*c];
+			Tensor<double>& e2=e[2*c+1];
 
-	    const double e1_max=e1.absmax();
-	    const double e2_max=e2.absmax();
+			const double e1_max=e1.absmax();
+			const double e2_max=e2.absmax();
 
-		// fast return if possible
-		if ((e1_max*norm_max<thresh) or (e2_max*norm_max<thresh)) {
-			x1.clear();
-			y1.clear();
-			w1.clear();
-			return;
-		}
+			// fast return if possible
+			if ((e1_max*norm_max<thresh[c]) or (e2_max*norm_max<thresh[c])) {
+				x1[c]->clear();
+				y1[c]->clear();
+				w1[c]->clear();
+				continue;
+			}
 
-	    // remove small negative eigenvalues
-	    e1.screen(1.e-13);
-	    e2.screen(1.e-13);
-	    Tensor<double> sqrt_e1(rank), sqrt_e2(rank);
-
-
-	    // shrink U1, U2
-	    int lo1=0;
-	    int lo2=0;
-	    for (unsigned int r=0; r<rank; r++) {
-	    	if (e1(r)<thresh/norm_max) lo1=r+1;
-	    	else sqrt_e1(r)=sqrt(std::abs(e1(r)));
-	    	if (e2(r)<thresh/norm_max) lo2=r+1;
-	    	else sqrt_e2(r)=sqrt(std::abs(e2(r)));
-	    }
-
-	    U1=U1(Slice(_),Slice(lo1,-1));
-	    U2=U2(Slice(_),Slice(lo2,-1));
-	    sqrt_e1=sqrt_e1(Slice(lo1,-1));
-	    sqrt_e2=sqrt_e2(Slice(lo2,-1));
-	    unsigned int rank_x=rank-lo1;
-	    unsigned int rank_y=rank-lo2;						// 0.0 / 0.0
-
-
-//	    MADNESS_ASSERT(sqrt_e1.size()==rank_x);
-//	    MADNESS_ASSERT(sqrt_e2.size()==rank_y);
-
-	    // set up overlap M; include X+
-
-//	    for (unsigned int i=0; i<rank_x; ++i) U(i,_)*=sqrt_e1(i);
-//	    for (unsigned int i=0; i<rank_y; ++i) U(i,_)*=sqrt_e2(i);
-
-	    tensorT UU1=copy(U1);
-	    for (unsigned int i=0; i<rank1; ++i) UU1(i,_)*=w1(i);
-	    for (unsigned int i=rank1; i<rank; ++i) UU1(i,_)*=w2(i-rank1);
-
-	    tensorT M=inner(UU1,U2,0,0);
-	    tensorT ee=outer(sqrt_e1,sqrt_e2);
-	    M.emul(ee);
-
-	    // include X-
-    	for (unsigned int r=0; r<rank_x; r++) {
-    		double fac=1.0/sqrt_e1(r);
-    		U1(_,r)*=fac;
-//    		for (unsigned int t=0; t<rank; t++) {
-//	    		U1(t,r)*=fac;
-////	    		if (sqrt_e1(r)<thresh) throw;
-//    		}
-    	}
+			// remove small negative eigenvalues
+			e1.screen(1.e-13);
+			e2.screen(1.e-13);
+			Tensor<double> sqrt_e1(rank), sqrt_e2(rank);
+
+			// shrink U1, U2
+			int lo1=0;
+			int lo2=0;
+			for (unsigned int r=0; r<rank; r++) {
+				if (e1(r)<thresh[c]/norm_max) lo1=r+1;
+				else sqrt_e1(r)=sqrt(std::abs(e1(r)));
+				if (e2(r)<thresh[c]/norm_max) lo2=r+1;
+				else sqrt_e2(r)=sqrt(std::abs(e2(r)));
+			}
 
-	   	for (unsigned int r=0; r<rank_y; r++) {
-    		double fac=1.0/sqrt_e2(r);
-    		U2(_,r)*=fac;
-//    		for (unsigned int t=0; t<rank; t++) {
-//	    		U2(t,r)*=fac;
-////	    		if (sqrt_e2(r)<thresh) throw;
-//	    	}
-	    }													// 0.2 / 0.6
+			tensorT u1=U[2*c](Slice(_),Slice(lo1,-1));
+			tensorT u2=U[2*c+1](Slice(_),Slice(lo2,-1));
+			sqrt_e1=sqrt_e1(Slice(lo1,-1));
+			sqrt_e2=sqrt_e2(Slice(lo2,-1));
+			unsigned int rank_x=rank-lo1;
+			unsigned int rank_y=rank-lo2;
+
+			// set up overlap M; include X+
+			tensorT UU1=copy(u1);
+			for (unsigned int i=0; i<rank1; ++i) UU1(i,_)*=(*w1[c])(i);
+			for (unsigned int i=rank1; i<rank; ++i) UU1(i,_)*=(*w2[c])(i-rank1);
+
+			tensorT m=inner(UU1,u2,0,0);
+			tensorT ee=outer(sqrt_e1,sqrt_e2);
+			m.emul(ee);
+
+			// include X-
+			for (unsigned int r=0; r<rank_x; r++) {
+				double fac=1.0/sqrt_e1(r);
+				u1(_,r)*=fac;
+			}
+			for (unsigned int r=0; r<rank_y; r++) {
+				double fac=1.0/sqrt_e2(r);
+				u2(_,r)*=fac;
+			}
+
+			active.push_back(c);
+			M.push_back(m);
+			U1.push_back(u1);
+			U2.push_back(u2);
+		}
 #ifdef BENCH
 		double cpu4=wall_time();
 		SRConf<T>::time(14)+=cpu4-cpu3;
 #endif
 
-
-	    // decompose M
-		tensorT Up,VTp;
-		Tensor<double> Sp;
-		svd(M,Up,Sp,VTp);									// 1.5 / 3.0
+		// decompose M
+		std::vector<tensorT> Up,VTp;
+		std::vector<Tensor<double> > Sp;
+		svd_batched(M,Up,Sp,VTp);							// 1.5 / 3.0
 #ifdef BENCH
 		double cpu5=wall_time();
 		SRConf<T>::time(15)+=cpu5-cpu4;
 #endif
 
-		// make transformation matrices
-		Up=inner(Up,U1,0,1);
-		VTp=inner(VTp,U2,1,1);
-#ifdef BENCH
-		double cpu6=wall_time();
-		SRConf<T>::time(16)+=cpu6-cpu5;
-#endif
+		for (size_t a=0; a<active.size(); ++a) {
+			const long c=active[a];
+			const long rank1=x1[c]->dim(0);
+			const long rank=rank1+x2[c]->dim(0);
+			const Slice s0(0,rank1-1), s1(rank1,rank-1);
 
-		// find the maximal singular value that's supposed to contribute
-		// singular values are ordered (largest first)
-		double residual=0.0;
-		long i;
-		for (i=Sp.dim(0)-1; i>=0; i--) {
-			residual+=Sp(i)*Sp(i);
-			if (residual>thresh*thresh) break;
-		}
+			// make transformation matrices
+			tensorT up=inner(Up[a],U1[a],0,1);
+			tensorT vtp=inner(VTp[a],U2[a],1,1);
 
-		// convert SVD output to our convention
-		if (i>=0) {
+			// find the maximal singular value that's supposed to contribute
+			// singular values are ordered (largest first)
+			long i=SRConf<T>::max_sigma(thresh[c],Sp[a].dim(0),Sp[a]);
 
-			// make it contiguous
-		    tensorT Up1=transpose(Up(Slice(0,i),s0));
-		    tensorT Up2=transpose(Up(Slice(0,i),s1));
-		    tensorT VTp1=transpose(VTp(Slice(0,i),s0));
-		    tensorT VTp2=transpose(VTp(Slice(0,i),s1));
+			// convert SVD output to our convention
+			if (i>=0) {
 
-			// transform 1 and 2
-		    x1=inner(Up1,x1,0,0);
-		    inner_result(Up2,x2,0,0,x1);
-		    y1=inner(VTp1,y1,0,0);
-		    inner_result(VTp2,y2,0,0,y1);
-		    w1=Sp(Slice(0,i));
+				// make it contiguous
+				tensorT Up1=transpose(up(Slice(0,i),s0));
+				tensorT Up2=transpose(up(Slice(0,i),s1));
+				tensorT VTp1=transpose(vtp(Slice(0,i),s0));
+				tensorT VTp2=transpose(vtp(Slice(0,i),s1));
 
-		} else {
-			x1.clear();
-			y1.clear();
-			w1.clear();
+				// transform 1 and 2
+				*x1[c]=inner(Up1,*x1[c],0,0);
+				inner_result(Up2,*x2[c],0,0,*x1[c]);
+				*y1[c]=inner(VTp1,*y1[c],0,0);
+				inner_result(VTp2,*y2[c],0,0,*y1[c]);
+				*w1[c]=Sp[a](Slice(0,i));
+
+			} else {
+				x1[c]->clear();
+				y1[c]->clear();
+				w1[c]->clear();
+			}
 		}
 #ifdef BENCH
 		double cpu7=wall_time();
-		SRConf<T>::time(17)+=cpu7-cpu6;
+		SRConf<T>::time(17)+=cpu7-cpu5;
 		SRConf<T>::time(10)+=cpu7-cpu0;
 #endif
-		return;
+	}
+
+	/// specialized version of ortho3
+
+	/// does the same as ortho3, but takes two bi-orthonormal configs as input
+	/// and saves on the inner product. Result will be written onto the first config
+	///
+	/// @param[in,out]	x1	left subspace, will hold the result on exit
+	/// @param[in,out]	y1	right subspace, will hold the result on exit
+	/// @param[in]		x2	left subspace, will be accumulated onto x1
+	/// @param[in]		y2	right subspace, will be accumulated onto y1
+	template<typename T>
+	void ortho5(Tensor<T>& x1, Tensor<T>& y1, Tensor<double>& w1,
+				const Tensor<T>& x2, const Tensor<T>& y2, const Tensor<double>& w2,
+				const double& thresh) {
+		ortho5(std::vector<Tensor<T>*>(1,&x1),std::vector<Tensor<T>*>(1,&y1),
+				std::vector<Tensor<double>*>(1,&w1),
+				std::vector<const Tensor<T>*>(1,&x2),std::vector<const Tensor<T>*>(1,&y2),
+				std::vector<const Tensor<double>*>(1,&w2),std::vector<double>(1,thresh));
+	}
+
+	/// randomized version of ortho3
+
+	/// the left subspace of A = sum_r w(r) x(r) y(r) is found by sampling A
+	/// with random vectors, a block at a time, until the norm of the part of A
+	/// outside the subspace is estimated to be below thresh/10. The estimate is
+	/// then checked with oversample fresh vectors, which are kept in the
+	/// subspace (Halko, Martinsson and Tropp, SIAM Rev. 53, 217 (2011)); only if
+	/// they confirm it is the projection of A onto the subspace decomposed by an
+	/// SVD and truncated as in ortho3. If the first northo configurations are orthonormal (e.g. an
+	/// SVD to which terms have been appended) they are taken as the initial
+	/// subspace, and only the remaining configurations need to be sampled.
+	/// operation count is O(kpr + kp^2) with p the rank of the result
+	///
+	/// @param[in,out]	x		left subspace, holds the result on exit
+	/// @param[in,out]	y		right subspace, holds the result on exit
+	/// @param[in,out]	weights	weights
+	/// @param[in]		northo	number of leading orthonormal configurations
+	/// @param[in]		thresh	truncation threshold
+	template<typename T>
+	void ortho_randomized(Tensor<T>& x, Tensor<T>& y, Tensor<double>& weights,
+			const long northo, const double& thresh) {
+
+		if (TensorTypeData<T>::iscomplex) MADNESS_EXCEPTION("no complex in ortho_randomized",1);
+		typedef Tensor<T> tensorT;
+
+		const long blocksize=8, oversample=10;
+		const long rank=x.dim(0);
+		const long kx=x.dim(1);
+		const long ky=y.dim(1);
+		const long pmax=std::min(rank,std::min(kx,ky));
+		const double tol=0.1*thresh;
+
+		// the new configurations with the weights folded into y
+		tensorT xnew, ynew;
+		if (northo<rank) {
+			xnew=x(Slice(northo,-1),_);
+			ynew=copy(y(Slice(northo,-1),_));
+			for (long r=northo; r<rank; ++r) ynew(r-northo,_).scale(weights(r));
+		}
+
+		// grow the orthonormal rows of Q until the sampled residual is small,
+		// and stays small for the oversample vectors of the final check
+		tensorT Q;
+		if (northo>0) Q=copy(x(Slice(0,northo-1),_));
+		long p=northo;
+		bool check=false;
+		while (p<pmax and northo<rank) {
+			const long b=std::min(check ? oversample : blocksize,pmax-p);
+			tensorT omega(b,ky);
+			omega.fillrandom();
+			omega.scale(2.0*std::sqrt(3.0));
+			omega-=std::sqrt(3.0);								// unit variance
+			tensorT s=inner(inner(omega,ynew,1,1),xnew,1,0);
+
+			// project out the current subspace twice for stability
+			for (int pass=0; pass<2 and p>0; ++pass) s-=inner(inner(s,Q,1,1),Q,1,0);
+
+			// mean of |(1-QQ^T) A omega|^2 estimates |(1-QQ^T) A|^2
+			const double residual=s.normf()/std::sqrt(double(b));
+			const bool converged=(residual<tol and check);
+			if (residual<tol and not check) {
+				check=true;
+				continue;
+			}
+			check=false;
+
+			tensorT L;
+			lq(s,L);
+			if (p>0) {
+				s-=inner(inner(s,Q,1,1),Q,1,0);
+				lq(s,L);
+			}
+
+			tensorT Qnew(p+b,kx);
+			if (p>0) Qnew(Slice(0,p-1),_)=Q;
+			Qnew(Slice(p,p+b-1),_)=s;
+			Q=Qnew;
+			p+=b;
+			if (converged) break;
+		}
+
+		if (p==0) {
+			x.clear();
+			y.clear();
+			weights.clear();
+			return;
+		}
+
+		// project A onto Q: the orthonormal configurations are the first rows
+		// of Q, and the rows added later are orthogonal to them
+		tensorT B(p,ky);
+		if (northo<rank) B=inner(inner(Q,xnew,1,1),ynew,1,0);
+		for (long r=0; r<northo; ++r) B(r,_).gaxpy(1.0,y(r,_),weights(r));
+
+		tensorT U, VT;
+		Tensor<double> s;
+		svd(B,U,s,VT);
+
+		const long i=SRConf<T>::max_sigma(thresh,s.dim(0),s);
+		if (i>=0) {
+			x=inner(U(_,Slice(0,i)),Q,0,0);
+			y=copy(VT(Slice(0,i),_));
+			weights=s(Slice(0,i));
+		} else {
+			x.clear();
+			y.clear();
+			weights.clear();
+		}
 	}
 
 	template<typename T>
@@ -34,6 +34,8 @@
 
 #include <madness/world/MADworld.h>
 #include <utility>
+#include <algorithm>
+#include <cstring>
 #include <madness/tensor/tensor.h>
 #include <madness/tensor/distributed_matrix.h>
 
@@ -457,6 +459,163 @@ namespace madness {
             return rank;
         }
     };
+
+    namespace detail {
+
+        /// Holds the rows of a column distributed matrix packed into blocks for \c SystolicBlockMatrixAlgorithm
+
+        /// Each row of \c B is a block of up to \c bsize consecutive rows of
+        /// \c A, so that the systolic loop moves and pairs blocks.  The rows
+        /// of each process are split into an even number of blocks which
+        /// never straddle processes; blocks are padded with zero rows that
+        /// are never passed to the kernels.  Packing and unpacking are local
+        /// copies.
+        template <typename T>
+        class SystolicRowBlocks {
+        protected:
+            DistributedMatrix<T>& A;
+            const int64_t bsize;        ///< Rows per block (the last block of a process may have fewer)
+            const int64_t nbtile;       ///< Blocks per process (except possibly the last)
+            DistributedMatrix<T> B;     ///< (no. of blocks, bsize*A.rowdim()) matrix of blocks
+
+            /// Returns the no. of blocks with bs rows needed for nrow rows, rounded up to even
+            static int64_t nblock(int64_t nrow, int64_t bs) {
+                const int64_t nb = (nrow-1)/bs + 1;
+                return nb + (nb&0x1);
+            }
+
+            /// Returns the rows per block for the given block size and column tile of A
+            static int64_t block_size(const DistributedMatrix<T>& A, int64_t bs) {
+                const int64_t tile = A.process_coldim()>1 ? A.coltile() : A.coldim();
+                return (tile-1)/nblock(tile,bs) + 1;
+            }
+
+            /// Returns the no. of blocks of the process owning column tile \c p
+            int64_t nblock_process(int64_t p) const {
+                int64_t ilo, ihi;
+                A.get_colrange(p, ilo, ihi);
+                return (ihi >= ilo) ? nblock(ihi-ilo+1, bsize) : 0;
+            }
+
+            /// Returns the no. of blocks in all
+            int64_t nblock_total() const {
+                const int64_t np = A.process_coldim();
+                return (np-1)*nbtile + nblock_process(np-1);
+            }
+
+            SystolicRowBlocks(DistributedMatrix<T>& A, int64_t bs)
+                : A(A)
+                , bsize(block_size(A,bs))
+                , nbtile(nblock(A.process_coldim()>1 ? A.coltile() : A.coldim(), bsize))
+                , B(column_distributed_matrix<T>(A.get_world(), nblock_total(), bsize*A.rowdim(), nbtile))
+            {
+                MADNESS_ASSERT(A.is_column_distributed() && bs > 0);
+                pack();
+            }
+
+            /// Copies the local rows of A into the blocks
+            void pack() {
+                const int64_t m = A.rowdim();
+                for (int64_t i=0; i<A.local_coldim(); ++i)
+                    std::memcpy(&B.data()(i/bsize,(i%bsize)*m), &A.data()(i,0), m*sizeof(T));
+            }
+
+            /// Copies the blocks back into the local rows of A
+            void unpack() {
+                const int64_t m = A.rowdim();
+                for (int64_t i=0; i<A.local_coldim(); ++i)
+                    std::memcpy(&A.data()(i,0), &B.data()(i/bsize,(i%bsize)*m), m*sizeof(T));
+            }
+
+            /// Returns the first row of A and the no. of rows in block \c ib
+            void block_range(int64_t ib, int64_t& ilo, int64_t& nrow) const {
+                const int64_t p = ib/nbtile;
+                int64_t lo, hi;
+                A.get_colrange(p, lo, hi);
+                ilo = lo + (ib - p*nbtile)*bsize;
+                nrow = std::max(std::min(bsize, hi+1-ilo), int64_t(0));
+            }
+        };
+    }
+
+
+    /// Base class for systolic loops over blocks of rows
+
+    /// The rows of the column distributed matrix are grouped into blocks
+    /// of up to \c blocksize rows and the systolic loop generates all pairs
+    /// of blocks, handing each pair to \c block_kernel with one virtual
+    /// call.  The kernel sees two contiguous sets of rows and is expected
+    /// to treat all pairs of rows among them, so that the rows of a block
+    /// also meet each other.  A kernel can then use matrix-matrix
+    /// operations on the blocks, and since each step does more work on
+    /// data that is in cache, typically fewer sweeps are needed than by
+    /// \c SystolicMatrixAlgorithm with the same pairwise operation.  The
+    /// pairs of blocks are shared between the threads of the task as in
+    /// \c SystolicMatrixAlgorithm.  Any column tile may be used, the
+    /// blocks are fitted into the tile of each process.
+    template <typename T>
+    class SystolicBlockMatrixAlgorithm : private detail::SystolicRowBlocks<T>, public SystolicMatrixAlgorithm<T> {
+        typedef detail::SystolicRowBlocks<T> blocksT;
+
+        void kernel(int ib, int jb, T* rowi, T* rowj) {
+            int64_t ilo, ni, jlo, nj;
+            blocksT::block_range(ib, ilo, ni);
+            blocksT::block_range(jb, jlo, nj);
+            if (ni+nj > 0) block_kernel(ilo, ni, jlo, nj, rowi, rowj);
+        }
+
+    public:
+        /// A must be a column distributed matrix
+
+        /// @param[in,out] A The matrix on which the algorithm is performed and modified in-place
+        /// @param[in] tag The MPI tag used for communication (obtain from \c world.mpi.comm().unique_tag() )
+        /// @param[in] blocksize The maximum no. of rows in a block
+        /// @param[in] nthread The number of local threads to use (default is main thread all threads in the pool)
+        SystolicBlockMatrixAlgorithm(DistributedMatrix<T>& A, int tag, int64_t blocksize, int nthread=ThreadPool::size()+1)
+            : blocksT(A, blocksize)
+            , SystolicMatrixAlgorithm<T>(blocksT::B, tag, nthread)
+        {}
+
+        virtual ~SystolicBlockMatrixAlgorithm() {}
+
+        /// Threadsafe routine to apply the operation to a pair of blocks of rows
+
+        /// The rows ilo..ilo+ni-1 are stored one after the other at \c rowi
+        /// and the rows jlo..jlo+nj-1 at \c rowj, each of length \c get_rowdim().
+        /// One of the blocks may be empty.
+        /// @param[in] ilo Index of the first row of the first block
+        /// @param[in] ni No. of rows in the first block
+        /// @param[in] jlo Index of the first row of the second block
+        /// @param[in] nj No. of rows in the second block
+        /// @param[in] rowi Pointer to the rows of the first block (to be modified by kernel in-place)
+        /// @param[in] rowj Pointer to the rows of the second block (to be modified by kernel in-place)
+        virtual void block_kernel(int64_t ilo, int64_t ni, int64_t jlo, int64_t nj, T* rowi, T* rowj) = 0;
+
+#ifdef HAVE_INTEL_TBB
+        /// Invoked by the task queue to run the algorithm with multiple threads
+
+        /// This is a collective call ... all processes in world should submit this task
+        void run(World& world, const TaskThreadEnv& env) {
+            SystolicMatrixAlgorithm<T>::run(world, env);
+            blocksT::unpack();
+        }
+#else
+        /// Invoked by the task queue to run the algorithm with multiple threads
+
+        /// This is a collective call ... all processes in world should submit this task
+        void run(World& world, const TaskThreadEnv& env) {
+            SystolicMatrixAlgorithm<T>::run(world, env);
+            if (env.id() == 0) blocksT::unpack();
+            env.barrier();
+        }
+#endif // HAVE_INTEL_TBB
+
+        /// Returns length of a row of the original matrix
+        int64_t get_rowdim() const {return blocksT::A.rowdim();}
+
+        /// Returns the no. of rows of the original matrix
+        int64_t get_coldim() const {return blocksT::A.coldim();}
+    };
 }
 
 #endif
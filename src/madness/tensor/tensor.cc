@@ -77,6 +77,67 @@ namespace madness {
 
     template <class T> class SliceGenTensor;
 
+#ifdef TENSOR_USE_SHARED_ALIGNED_ARRAY
+    namespace detail {
+
+#ifndef TENSOR_SMALL_BLOCK_BYTES
+#define TENSOR_SMALL_BLOCK_BYTES 8192
+#endif
+
+        // Blocks are binned by size in units of TENSOR_ALIGNMENT.  Each
+        // thread keeps at most small_block_depth free blocks per bin so
+        // the cache cannot grow without bound.  A block freed by a thread
+        // other than the one that allocated it just migrates to the free
+        // list of the freeing thread, so no locking is needed.
+        static const std::size_t small_block_nbin = (TENSOR_SMALL_BLOCK_BYTES + TENSOR_ALIGNMENT)/TENSOR_ALIGNMENT + 1;
+        static const int small_block_depth = 16;
+
+        static thread_local void* small_block_head[small_block_nbin];
+        static thread_local int small_block_count[small_block_nbin];
+        static thread_local unsigned long small_block_nhit;
+        static thread_local unsigned long small_block_nmiss;
+
+        static inline std::size_t small_block_bin(std::size_t nbyte) {
+            return (nbyte + TENSOR_ALIGNMENT - 1)/TENSOR_ALIGNMENT;
+        }
+
+        void* tensor_small_alloc(std::size_t nbyte) {
+            void* p = 0;
+            std::size_t bin = small_block_bin(nbyte);
+            if (bin < small_block_nbin) {
+                p = small_block_head[bin];
+                if (p) {
+                    small_block_head[bin] = *(void**)(p);
+                    --small_block_count[bin];
+                    ++small_block_nhit;
+                    return p;
+                }
+                ++small_block_nmiss;
+                nbyte = bin*TENSOR_ALIGNMENT; // So the block can be reused by any request in this bin
+            }
+            if (posix_memalign(&p, TENSOR_ALIGNMENT, nbyte)) return 0;
+            return p;
+        }
+
+        void tensor_small_free(void* p, std::size_t nbyte) {
+            std::size_t bin = small_block_bin(nbyte);
+            if (bin < small_block_nbin && small_block_count[bin] < small_block_depth) {
+                *(void**)(p) = small_block_head[bin];
+                small_block_head[bin] = p;
+                ++small_block_count[bin];
+            }
+            else {
+                free(p);
+            }
+        }
+
+        void tensor_small_stats(unsigned long& nhit, unsigned long& nmiss) {
+            nhit = small_block_nhit;
+            nmiss = small_block_nmiss;
+        }
+    }
+#endif
+
     std::ostream& operator<<(std::ostream& stream, const Slice& s) {
         stream << "Slice(" << s.start << "," << s.end << "," << s.step << ")";
         return stream;
@@ -36,6 +36,8 @@
 #include <madness/misc/ran.h>
 #include <madness/world/posixmem.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <complex>
 #include <vector>
@@ -267,6 +269,8 @@ namespace madness {
 
     template <class T> class SliceTensor;
 
+    template <typename E> class TensorExpr;
+
 
     /// low rank representations of tensors (see gentensor.h)
 	enum TensorType {TT_NONE, TT_FULL, TT_2D, TT_TENSORTRAIN};
@@ -283,7 +287,22 @@ namespace madness {
         return s;
     }
 
-    //#define TENSOR_USE_SHARED_ALIGNED_ARRAY
+#if HAVE_IBMBGP
+#define TENSOR_ALIGNMENT 16
+#elif HAVE_IBMBGQ
+#define TENSOR_ALIGNMENT 32
+#elif MADNESS_HAVE_AVX2
+/* 32B alignment is best for performance according to
+ * http://www.nas.nasa.gov/hecc/support/kb/haswell-processors_492.html */
+#define TENSOR_ALIGNMENT 32
+#elif MADNESS_HAVE_AVX512
+/* One can infer from the AVX2 case that 64B alignment helps with 512b SIMD. */
+#define TENSOR_ALIGNMENT 64
+#else
+// Typical cache line size
+#define TENSOR_ALIGNMENT 64
+#endif
+
 #ifdef TENSOR_USE_SHARED_ALIGNED_ARRAY
 #define TENSOR_SHARED_PTR detail::SharedAlignedArray
     // this code has been tested and seems to work correctly on all
@@ -291,29 +310,78 @@ namespace madness {
     // to measure improvement in thread scaling (from 20 to 60 threads
     // on cn-mem) and no change in the modest thread count (20)
     // execution time with tbballoc.  hence we are not presently using
-    // it but will test more in the future with different allocators
+    // it by default but it can be enabled at configure time.
+    //
+    // Small blocks (data up to TENSOR_SMALL_BLOCK_BYTES, which by
+    // default holds k^3 double_complex coefficients for k<=8) are
+    // recycled through per-thread free lists (see tensor.cc) so that
+    // the short-lived coefficient tensors passed between tasks neither
+    // hit malloc nor share a control block with anything else.
     namespace detail {
-        // Minimal ref-counted array with data+counter in one alloc
+
+        /// Allocate \c nbyte bytes aligned to \c TENSOR_ALIGNMENT, using the per-thread small-block cache if possible
+        void* tensor_small_alloc(std::size_t nbyte);
+
+        /// Return memory obtained from \c tensor_small_alloc (\c nbyte must be the same value)
+        void tensor_small_free(void* p, std::size_t nbyte);
+
+        /// Returns the number of allocations/frees satisfied by the calling thread's small-block cache
+        void tensor_small_stats(unsigned long& nhit, unsigned long& nmiss);
+
+        // Minimal intrusively ref-counted array with data+counter in one alloc.
+        //
+        // The counter lives in a header of TENSOR_ALIGNMENT bytes in
+        // front of the data so the data keeps its alignment.  Copies
+        // share the data (shallow copy semantics of Tensor are
+        // unchanged) and cost one increment on the header, which is
+        // adjacent to the data rather than in a separate control block.
         template <typename T> class SharedAlignedArray {
-            T* volatile p;
-            AtomicInt* cnt;
-            void dec() {if (p && ((*cnt)-- == 1)) {free(p); p = 0;}}
-            void inc() {if (p) (*cnt)++;}
+            struct header {
+#ifdef TENSOR_NONATOMIC_REFCOUNT
+                long cnt; // Only valid if tensors are never shared between threads
+#else
+                std::atomic<long> cnt;
+#endif
+                std::size_t nbyte;
+            };
+            header* h;
+
+#ifdef TENSOR_NONATOMIC_REFCOUNT
+            void dec() {
+                if (h && (--(h->cnt) == 0)) tensor_small_free((void*) h, h->nbyte);
+                h = 0;
+            }
+            void inc() {if (h) ++(h->cnt);}
+#else
+            // Increments need no ordering, the final decrement must see all prior writes to the data
+            void dec() {
+                if (h && (h->cnt.fetch_sub(1, std::memory_order_acq_rel) == 1)) tensor_small_free((void*) h, h->nbyte);
+                h = 0;
+            }
+            void inc() {if (h) h->cnt.fetch_add(1, std::memory_order_relaxed);}
+#endif
         public:
-            SharedAlignedArray() : p(0), cnt(0) {}
+            SharedAlignedArray() : h(0) {}
+
+            SharedAlignedArray(const SharedAlignedArray<T>& other) : h(other.h) {inc();}
+
             T* allocate(std::size_t size, unsigned int alignment) {
-                std::size_t offset = (size*sizeof(T)-1)/sizeof(AtomicInt) + 1; // Where the counter will be
-                std::size_t nbyte = (offset+1)*sizeof(AtomicInt);
-                if (posix_memalign((void **) &p, alignment, nbyte)) throw 1;
-                cnt = (AtomicInt*)(p) + offset;
-                *cnt = 1;
-                return p;
+                static_assert(sizeof(header) <= TENSOR_ALIGNMENT, "tensor header does not fit in the alignment padding");
+                MADNESS_ASSERT(alignment == TENSOR_ALIGNMENT);
+                dec();
+                std::size_t nbyte = TENSOR_ALIGNMENT + size*sizeof(T);
+                h = (header*) tensor_small_alloc(nbyte);
+                if (!h) throw 1;
+                new (&(h->cnt)) decltype(h->cnt)(1);
+                h->nbyte = nbyte;
+                return (T*)((char*)(h) + TENSOR_ALIGNMENT);
             }
             SharedAlignedArray<T>& operator=(const SharedAlignedArray<T>& other) {
-                if (this != &other) {dec(); p = other.p; cnt = other.cnt; inc();}
+                if (h != other.h) {dec(); h = other.h; inc();}
                 return *this;
             }
-            void reset() {dec(); p = 0;}
+            void reset() {dec();}
+            long use_count() const {return h ? long(h->cnt) : 0;}
             ~SharedAlignedArray() {dec();}
         };
     }
@@ -350,22 +418,6 @@ namespace madness {
             if (_size) {
                 TENSOR_ASSERT(_size>=0 && _size<268435456, "invalid size in new tensor",_size,0);
                 try {
-#if HAVE_IBMBGP
-#define TENSOR_ALIGNMENT 16
-#elif HAVE_IBMBGQ
-#define TENSOR_ALIGNMENT 32
-#elif MADNESS_HAVE_AVX2
-/* 32B alignment is best for performance according to
- * http://www.nas.nasa.gov/hecc/support/kb/haswell-processors_492.html */
-#define TENSOR_ALIGNMENT 32
-#elif MADNESS_HAVE_AVX512
-/* One can infer from the AVX2 case that 64B alignment helps with 512b SIMD. */
-#define TENSOR_ALIGNMENT 64
-#else
-// Typical cache line size
-#define TENSOR_ALIGNMENT 64
-#endif
-
 #ifdef TENSOR_USE_SHARED_ALIGNED_ARRAY
                     _p = _shptr.allocate(_size, TENSOR_ALIGNMENT);
 #elif defined WORLD_GATHER_MEM_STATS
@@ -567,6 +619,34 @@ namespace madness {
             return *this;
         }
 
+        /// Construct from a fused element-wise expression (see tensor_expr.h)
+
+        /// @param[in] e Expression evaluated in a single pass into new storage
+        template <typename E>
+        Tensor(const TensorExpr<E>& e);
+
+        /// Assign a fused element-wise expression (see tensor_expr.h)
+
+        /// Like the other assignments this binds to a new tensor
+        /// @param[in] e Expression evaluated in a single pass
+        /// @return %Reference to this tensor
+        template <typename E>
+        Tensor<T>& operator=(const TensorExpr<E>& e);
+
+        /// Inplace addition of a fused element-wise expression (see tensor_expr.h)
+
+        /// @param[in] e Conforming expression evaluated in a single pass
+        /// @return %Reference to this tensor
+        template <typename E>
+        Tensor<T>& operator+=(const TensorExpr<E>& e);
+
+        /// Inplace subtraction of a fused element-wise expression (see tensor_expr.h)
+
+        /// @param[in] e Conforming expression evaluated in a single pass
+        /// @return %Reference to this tensor
+        template <typename E>
+        Tensor<T>& operator-=(const TensorExpr<E>& e);
+
         /// Inplace addition of two tensors
 
         /// @param[in] t Conforming tensor to be added in-place to this tensor
@@ -1787,6 +1867,14 @@ namespace madness {
             return *this;
         }
 
+        /// Inplace multiply by corresponding elements of a fused expression (see tensor_expr.h)
+        template <typename E>
+        Tensor<T>& emul(const TensorExpr<E>& e);
+
+        /// Inplace generalized saxpy with a fused expression ... this = this*alpha + e*beta (see tensor_expr.h)
+        template <typename E>
+        Tensor<T>& gaxpy(T alpha, const TensorExpr<E>& e, T beta);
+
         /// Inplace generalized saxpy ... this = this*alpha + other*beta
         Tensor<T>& gaxpy(T alpha, const Tensor<T>& t, T beta) {
             if (iscontiguous() && t.iscontiguous()) {
@@ -1824,7 +1912,7 @@ namespace madness {
 
         /// Returns a pointer to the base class
         const BaseTensor* base() const {
-            return static_cast<BaseTensor*>(this);
+            return static_cast<const BaseTensor*>(this);
         }
 
         /// Return iterator over single tensor
@@ -1872,6 +1960,9 @@ namespace madness {
 
         bool has_data() const {return size()!=0;};
 
+        /// Returns true if no other tensor (copy or slice) refers to the data of this tensor
+        bool is_unique() const {return _shptr.use_count()==1;}
+
     };
 
     template <class T>
@@ -2195,6 +2286,17 @@ namespace madness {
     }
 
 
+    namespace detail {
+        /// Below this many elements in both operands inner() keeps its iterator loop
+        static const long contract_min_size = 256;
+
+        template <class T, class Q>
+        void contract_result(const Tensor<T>& left, const Tensor<Q>& right,
+                             const std::vector<long>& bl, const std::vector<long>& br,
+                             const std::vector<long>& kl, const std::vector<long>& kr,
+                             Tensor<TENSOR_RESULT_TYPE(T,Q)>& result, bool accumulate);
+    }
+
     /// Inner product ... result(i,j,...,p,q,...) = sum(z) left(i,j,...,z)*right(z,p,q,...)
 
     /// \ingroup tensor
@@ -2203,6 +2305,10 @@ namespace madness {
     /// changed by specifying \c k0 and \c k1 , the index to contract in
     /// the left and right side tensors, respectively.  The defaults
     /// correspond to (\c k0=-1 and \c k1=0 ).
+    ///
+    /// Any pair of indices is contracted with a single matrix multiply,
+    /// after copying the operands into a suitable order if they are not
+    /// already in one (see tensor_contract.h).
     template <class T, class Q>
     Tensor<TENSOR_RESULT_TYPE(T,Q)> inner(const Tensor<T>& left, const Tensor<Q>& right,
                                           long k0=-1, long k1=0) {
@@ -2229,10 +2335,15 @@ namespace madness {
         base--;
         for (long i=k1+1; i<right.ndim(); ++i) d[i+base] = right.dim(i);
 
-        Tensor<TENSOR_RESULT_TYPE(T,Q)> result(nd,d);
-
-        inner_result(left,right,k0,k1,result);
+        if (left.size() + right.size() < detail::contract_min_size) {
+            Tensor<TENSOR_RESULT_TYPE(T,Q)> result(nd,d);
+            inner_result(left,right,k0,k1,result);
+            return result;
+        }
 
+        Tensor<TENSOR_RESULT_TYPE(T,Q)> result(nd,d,false);
+        detail::contract_result(left, right, std::vector<long>(), std::vector<long>(),
+                                std::vector<long>(1,k0), std::vector<long>(1,k1), result, false);
         return result;
     }
 
@@ -2295,6 +2406,12 @@ namespace madness {
             }
         }
 
+        if (left.size() + right.size() >= detail::contract_min_size) {
+            detail::contract_result(left, right, std::vector<long>(), std::vector<long>(),
+                                    std::vector<long>(1,k0), std::vector<long>(1,k1), result, true);
+            return;
+        }
+
         long dimj = left.dim(k0);
         TensorIterator<Q> iter1=right.unary_iterator(1,false,false,k1);
 
@@ -2440,6 +2557,105 @@ namespace madness {
         return result;
     }
 
+    /// Applies transform() to a batch of tensors of the same shape with the same matrix
+
+    /// \ingroup tensor
+    /// \code
+    ///     result[n](i,j,k,...) <-- sum(i',j',k',...) t[n](i',j',k',...)  c(i',i) c(j',j) c(k',k) ...
+    /// \endcode
+    ///
+    /// The tensors in a chunk of up to \c nbatch are interleaved so that
+    /// the batch index runs fastest.  Each dimension is then transformed by
+    /// a single mTxmq over the whole chunk, as in fast_transform(), and
+    /// since the batch index cycles to the front with the transformed
+    /// indices behind it, the last step leaves the results one after the
+    /// other.  This replaces many small matrix products by a few large ones
+    /// and amortizes the allocation of the workspace, which pays off for
+    /// small tensors where the cost of each product is dominated by
+    /// overhead.  By default (\c nbatch=0) the chunk is as large as
+    /// possible with the workspace still fitting in a typical level 2 cache.
+    ///
+    /// All input tensors must be contiguous with the same number of
+    /// dimensions all equal to the first dimension of \c c.  Unlike
+    /// fast_transform(), \c c need not be square.
+    ///
+    /// Tensors in \c result that already have the shape of the output and
+    /// do not share their data with any other tensor are overwritten in
+    /// place (so that the results of one batch may be reused for the
+    /// next).  Others are replaced by new tensors, leaving any tensor
+    /// that shared their data untouched.
+    template <class T, class Q>
+    std::vector< Tensor<TENSOR_RESULT_TYPE(T,Q)> >&
+    fast_transform_batch(const std::vector< Tensor<T> >& t, const Tensor<Q>& c,
+                         std::vector< Tensor<TENSOR_RESULT_TYPE(T,Q)> >& result, long nbatch=0) {
+        typedef TENSOR_RESULT_TYPE(T,Q) resultT;
+        result.resize(t.size());
+        if (t.empty()) return result;
+
+        TENSOR_ASSERT(c.ndim() == 2 && c.iscontiguous(), "fast_transform_batch: c must be a contiguous matrix", c.ndim(), &c);
+        const long ndim = t[0].ndim();
+        const long kin = c.dim(0), kout = c.dim(1);
+        long sizein = 1, sizeout = 1;
+        long dims[TENSOR_MAXDIM];
+        for (long d=0; d<ndim; ++d) {
+            sizein *= kin;
+            sizeout *= kout;
+            dims[d] = kout;
+        }
+        const long sizemax = std::max(sizein, sizeout);
+        if (nbatch <= 0) nbatch = (256*1024)/(2*sizemax*sizeof(resultT));
+        if (nbatch < 1) nbatch = 1;
+        if (nbatch > long(t.size())) nbatch = t.size();
+
+        Tensor<resultT> work0(nbatch*sizemax), work1(nbatch*sizemax);
+        for (std::size_t n0=0; n0<t.size(); n0+=nbatch) {
+            const long m = std::min(nbatch, long(t.size()-n0));
+
+            // Interleave the chunk ... w0(i,n) = t[n0+n](i)
+            std::vector<const T*> p(m);
+            for (long n=0; n<m; ++n) {
+                const Tensor<T>& tn = t[n0+n];
+                TENSOR_ASSERT(tn.iscontiguous() && tn.ndim() == ndim && tn.size() == sizein,
+                              "fast_transform_batch: inconsistent or noncontiguous input", n0+n, &tn);
+                p[n] = tn.ptr();
+            }
+            resultT* restrict w0 = work0.ptr();
+            for (long i=0; i<sizein; ++i, w0+=m)
+                for (long n=0; n<m; ++n) w0[n] = p[n][i];
+
+            // Contract the leading index and cycle it to the end
+            resultT *in = work0.ptr(), *out = work1.ptr();
+            long nin = sizein*m;
+            for (long d=0; d<ndim; ++d) {
+                const long dimi = nin/kin;
+                mTxmq(dimi, kout, kin, out, in, c.ptr());
+                nin = dimi*kout;
+                std::swap(in, out);
+            }
+
+            for (long n=0; n<m; ++n) {
+                Tensor<resultT>& r = result[n0+n];
+                bool reuse = (r.ndim() == ndim) && r.iscontiguous() && r.is_unique();
+                for (long d=0; reuse && d<ndim; ++d) reuse = (r.dim(d) == kout);
+                if (!reuse) r = Tensor<resultT>(ndim, dims, false);
+                std::copy(in + n*sizeout, in + (n+1)*sizeout, r.ptr());
+            }
+        }
+        return result;
+    }
+
+    /// Applies transform() to a batch of tensors of the same shape returning new results
+
+    /// \ingroup tensor
+    /// See the in place version of fast_transform_batch().
+    template <class T, class Q>
+    std::vector< Tensor<TENSOR_RESULT_TYPE(T,Q)> >
+    fast_transform_batch(const std::vector< Tensor<T> >& t, const Tensor<Q>& c, long nbatch=0) {
+        std::vector< Tensor<TENSOR_RESULT_TYPE(T,Q)> > result;
+        fast_transform_batch(t, c, result, nbatch);
+        return result;
+    }
+
     /// Return a new tensor holding the absolute value of each element of t
 
     /// \ingroup tensor
@@ -2495,6 +2711,9 @@ namespace madness {
     }
 }
 
+#include <madness/tensor/tensor_expr.h>
+#include <madness/tensor/tensor_contract.h>
+
 #undef TENSOR_SHARED_PTR
 
 #endif // MADNESS_TENSOR_TENSOR_H__INCLUDED
@@ -0,0 +1,241 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/tensor_contract.cc
+/// \brief Parsing and contraction order of einsum specifications
+
+#include <madness/tensor/tensor.h>
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+namespace madness {
+    namespace detail {
+
+        namespace {
+
+            /// Letters of the operands in \c set that are needed outside it
+            std::string einsum_kept(unsigned set, const std::vector<std::string>& reduced,
+                                    const std::string& output) {
+                std::string kept;
+                for (size_t n=0; n<reduced.size(); ++n) {
+                    if (!(set & (1u<<n))) continue;
+                    for (size_t i=0; i<reduced[n].size(); ++i) {
+                        const char c = reduced[n][i];
+                        if (kept.find(c) != std::string::npos) continue;
+                        bool needed = output.find(c) != std::string::npos;
+                        for (size_t m=0; m<reduced.size() && !needed; ++m) {
+                            if (!(set & (1u<<m)) && reduced[m].find(c) != std::string::npos) needed = true;
+                        }
+                        if (needed) kept += c;
+                    }
+                }
+                return kept;
+            }
+
+            /// Multiply-adds to contract operands with indices \c a and \c b
+            double einsum_flops(const std::string& a, const std::string& b, const long* dimof) {
+                double flops = 1.0;
+                for (size_t i=0; i<a.size(); ++i) flops *= dimof[(unsigned char)(a[i])];
+                for (size_t i=0; i<b.size(); ++i)
+                    if (a.find(b[i]) == std::string::npos) flops *= dimof[(unsigned char)(b[i])];
+                return flops;
+            }
+
+            /// Indices of the result of contracting \c a with \c b in the order made by contract_result
+            std::string einsum_merge(const std::string& a, const std::string& b, const std::string& kept) {
+                std::string r;
+                for (size_t i=0; i<a.size(); ++i)
+                    if (b.find(a[i]) != std::string::npos && kept.find(a[i]) != std::string::npos) r += a[i];
+                for (size_t i=0; i<a.size(); ++i) if (b.find(a[i]) == std::string::npos) r += a[i];
+                for (size_t i=0; i<b.size(); ++i) if (a.find(b[i]) == std::string::npos) r += b[i];
+                return r;
+            }
+
+            /// Emit the steps of the optimal tree for \c set and return the id of its result
+            int einsum_emit(unsigned set, const std::vector<unsigned>& split, EinsumPlan& plan) {
+                if ((set & (set-1)) == 0) {
+                    int n = 0;
+                    while (!(set & (1u<<n))) ++n;
+                    return n;
+                }
+                const unsigned a = split[set];
+                const int ia = einsum_emit(a, split, plan);
+                const int ib = einsum_emit(set ^ a, split, plan);
+                const int nop = plan.inputs.size();
+                const std::string& sa = ia<nop ? plan.reduced[ia] : plan.intermediates[ia-nop];
+                const std::string& sb = ib<nop ? plan.reduced[ib] : plan.intermediates[ib-nop];
+                const std::string kept = einsum_kept(set, plan.reduced, plan.output);
+                const std::string sr = einsum_merge(sa, sb, kept);
+                plan.steps.push_back(std::make_pair(ia, ib));
+                plan.intermediates.push_back(sr);
+                return nop + plan.steps.size() - 1;
+            }
+        }
+
+        EinsumPlan einsum_plan(const std::string& spec, const std::vector< std::vector<long> >& dims) {
+            EinsumPlan plan;
+            plan.flops = 0.0;
+
+            // Split "ab,bc->ac" into operands and result
+            std::string s;
+            for (size_t i=0; i<spec.size(); ++i) if (!std::isspace((unsigned char)(spec[i]))) s += spec[i];
+            const size_t arrow = s.find("->");
+            const std::string lhs = s.substr(0, arrow);
+            size_t start = 0;
+            while (true) {
+                const size_t comma = lhs.find(',', start);
+                plan.inputs.push_back(lhs.substr(start, comma==std::string::npos ? comma : comma-start));
+                if (comma == std::string::npos) break;
+                start = comma+1;
+            }
+            const long nop = plan.inputs.size();
+            if (nop != long(dims.size()))
+                TENSOR_EXCEPTION("einsum: number of operands does not match the specification", dims.size(), 0);
+
+            long dimof[256];
+            int count[256];
+            for (int c=0; c<256; ++c) {
+                dimof[c] = -1;
+                count[c] = 0;
+            }
+            for (long n=0; n<nop; ++n) {
+                const std::string& in = plan.inputs[n];
+                if (in.size() != dims[n].size())
+                    TENSOR_EXCEPTION("einsum: operand has the wrong number of dimensions", n, 0);
+                for (size_t i=0; i<in.size(); ++i) {
+                    const unsigned char c = in[i];
+                    if (!std::isalpha(c)) TENSOR_EXCEPTION("einsum: indices must be letters", i, 0);
+                    if (in.find(c, i+1) != std::string::npos)
+                        TENSOR_EXCEPTION("einsum: repeated index within an operand is not supported", n, 0);
+                    if (dimof[c] >= 0 && dimof[c] != dims[n][i])
+                        TENSOR_EXCEPTION("einsum: index has inconsistent dimensions", dims[n][i], 0);
+                    dimof[c] = dims[n][i];
+                    ++count[c];
+                }
+            }
+
+            if (arrow == std::string::npos) {
+                for (int c=0; c<256; ++c) if (count[c] == 1) plan.output += char(c);
+            }
+            else {
+                plan.output = s.substr(arrow+2);
+                for (size_t i=0; i<plan.output.size(); ++i) {
+                    const unsigned char c = plan.output[i];
+                    if (count[c] == 0 || plan.output.find(c, i+1) != std::string::npos)
+                        TENSOR_EXCEPTION("einsum: result index is repeated or not in any operand", i, 0);
+                }
+            }
+            if (plan.output.empty())
+                TENSOR_EXCEPTION("einsum: result is a scalar but cannot return one ... use dot or trace", 0, 0);
+            if (long(plan.output.size()) > TENSOR_MAXDIM || nop > 31)
+                TENSOR_EXCEPTION("einsum: too many dimensions or operands", plan.output.size(), 0);
+
+            // Indices used by a single operand and not in the result are summed first
+            for (long n=0; n<nop; ++n) {
+                std::string r;
+                const std::string& in = plan.inputs[n];
+                for (size_t i=0; i<in.size(); ++i) {
+                    const unsigned char c = in[i];
+                    if (count[c] > 1 || plan.output.find(c) != std::string::npos) r += c;
+                }
+                plan.reduced.push_back(r);
+            }
+            if (nop == 1) return plan;
+
+            if (nop <= 10) {
+                // Exhaustive search over the binary contraction trees of each subset
+                const unsigned full = (1u<<nop) - 1;
+                std::vector<double> best(full+1, 0.0);
+                std::vector<unsigned> split(full+1, 0);
+                std::vector<std::string> kept(full+1);
+                for (unsigned set=1; set<=full; ++set) kept[set] = einsum_kept(set, plan.reduced, plan.output);
+                for (unsigned set=1; set<=full; ++set) {
+                    if ((set & (set-1)) == 0) continue;
+                    const unsigned low = set & (~set + 1);
+                    best[set] = std::numeric_limits<double>::max();
+                    for (unsigned a=(set-1)&set; a; a=(a-1)&set) {
+                        if (!(a & low)) continue;
+                        const unsigned b = set ^ a;
+                        const double cost = best[a] + best[b] + einsum_flops(kept[a], kept[b], dimof);
+                        if (cost < best[set]) {
+                            best[set] = cost;
+                            split[set] = a;
+                        }
+                    }
+                }
+                einsum_emit(full, split, plan);
+                plan.flops = best[full];
+            }
+            else {
+                // Greedy: repeatedly contract the pair that costs least
+                std::vector<int> id(nop);
+                std::vector<unsigned> set(nop);
+                for (long n=0; n<nop; ++n) {
+                    id[n] = n;
+                    set[n] = 1u<<n;
+                }
+                while (id.size() > 1) {
+                    size_t ba = 0, bb = 1;
+                    double bcost = std::numeric_limits<double>::max();
+                    for (size_t a=0; a<id.size(); ++a) {
+                        for (size_t b=a+1; b<id.size(); ++b) {
+                            const std::string& sa = id[a]<nop ? plan.reduced[id[a]] : plan.intermediates[id[a]-nop];
+                            const std::string& sb = id[b]<nop ? plan.reduced[id[b]] : plan.intermediates[id[b]-nop];
+                            const double cost = einsum_flops(sa, sb, dimof);
+                            if (cost < bcost) {
+                                bcost = cost;
+                                ba = a;
+                                bb = b;
+                            }
+                        }
+                    }
+                    const std::string sa = id[ba]<nop ? plan.reduced[id[ba]] : plan.intermediates[id[ba]-nop];
+                    const std::string sb = id[bb]<nop ? plan.reduced[id[bb]] : plan.intermediates[id[bb]-nop];
+                    const unsigned merged = set[ba] | set[bb];
+                    plan.steps.push_back(std::make_pair(id[ba], id[bb]));
+                    plan.intermediates.push_back(einsum_merge(sa, sb, einsum_kept(merged, plan.reduced, plan.output)));
+                    plan.flops += bcost;
+                    id[ba] = nop + plan.steps.size() - 1;
+                    set[ba] = merged;
+                    id.erase(id.begin()+bb);
+                    set.erase(set.begin()+bb);
+                }
+            }
+
+            for (size_t n=0; n<plan.intermediates.size(); ++n)
+                if (long(plan.intermediates[n].size()) > TENSOR_MAXDIM)
+                    TENSOR_EXCEPTION("einsum: intermediate has too many dimensions", plan.intermediates[n].size(), 0);
+            return plan;
+        }
+    }
+}
@@ -0,0 +1,496 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_TENSOR_TENSOR_CONTRACT_H__INCLUDED
+#define MADNESS_TENSOR_TENSOR_CONTRACT_H__INCLUDED
+
+/// \file tensor/tensor_contract.h
+/// \brief General tensor contraction by transpose-transpose-GEMM and einsum
+
+/// A contraction over any set of index pairs is mapped onto matrix
+/// multiplication by copying each operand (if necessary) into a layout
+/// where its contracted indices are adjacent, then calling one of the
+/// mxm kernels once per batch.  Of the four layouts (contracted indices
+/// first or last in each operand) the one with the least estimated
+/// cost, counting both copies and the speed of the kernel, is chosen.
+/// Operands that are already dense in a usable layout are not copied.
+/// The copies use a cache-blocked permutation kernel.
+///
+/// \c inner() and \c inner_result() use this engine for the index pairs
+/// they cannot hand directly to mxm, and \c einsum() builds multi-operand
+/// contractions from it, choosing the pairwise order that minimizes the
+/// operation count.
+
+#include <string>
+#include <vector>
+
+namespace madness {
+
+    namespace detail {
+
+        /// Copy a strided array into dense storage with permuted dimensions
+
+        /// The output is dense with dimensions \c dims[0..nd-1] and element
+        /// \c (i0,i1,...) of it is read from \c in[i0*stride[0]+i1*stride[1]+...].
+        /// Dimensions that are also adjacent in the input are fused, and if
+        /// the fastest output dimension is strided in the input the copy is
+        /// done in square tiles so that both sides stream through cache.
+        template <typename T>
+        void permute_copy(long nd, const long* dims, const long* stride,
+                          const T* restrict in, T* restrict out) {
+            long d[TENSOR_MAXDIM], s[TENSOR_MAXDIM];
+            long n = 0;
+            for (long i=0; i<nd; ++i) {
+                if (dims[i] == 1) continue;
+                if (n>0 && s[n-1] == stride[i]*dims[i]) {
+                    d[n-1] *= dims[i];
+                    s[n-1] = stride[i];
+                }
+                else {
+                    d[n] = dims[i];
+                    s[n] = stride[i];
+                    ++n;
+                }
+            }
+            if (n == 0) {
+                *out = *in;
+                return;
+            }
+
+            // Output strides
+            long os[TENSOR_MAXDIM];
+            os[n-1] = 1;
+            for (long i=n-2; i>=0; --i) os[i] = os[i+1]*d[i+1];
+
+            const long last = n-1;
+            if (s[last] == 1 || n == 1) {
+                // Rows are dense on both sides
+                const long nrow = d[last], sl = s[last];
+                long idx[TENSOR_MAXDIM] = {0};
+                const T* p = in;
+                while (true) {
+                    if (sl == 1) for (long j=0; j<nrow; ++j) out[j] = p[j];
+                    else for (long j=0; j<nrow; ++j) out[j] = p[j*sl];
+                    out += nrow;
+                    long i = last-1;
+                    for (; i>=0; --i) {
+                        p += s[i];
+                        if (++idx[i] < d[i]) break;
+                        p -= s[i]*d[i];
+                        idx[i] = 0;
+                    }
+                    if (i < 0) break;
+                }
+                return;
+            }
+
+            // Tile the fastest output dimension against the fastest input one
+            long q = 0;
+            for (long i=1; i<last; ++i) if (s[i] < s[q]) q = i;
+            const long B = std::max(4L, long(256/sizeof(T)));
+            const long dq = d[q], sq = s[q], oq = os[q];
+            const long dl = d[last], sl = s[last];
+            long idx[TENSOR_MAXDIM] = {0};
+            const T* p = in;
+            T* o = out;
+            while (true) {
+                for (long jb=0; jb<dq; jb+=B) {
+                    const long je = std::min(jb+B, dq);
+                    for (long ib=0; ib<dl; ib+=B) {
+                        const long ie = std::min(ib+B, dl);
+                        for (long j=jb; j<je; ++j) {
+                            const T* restrict pj = p + j*sq;
+                            T* restrict oj = o + j*oq;
+                            for (long i=ib; i<ie; ++i) oj[i] = pj[i*sl];
+                        }
+                    }
+                }
+                long i = last-1;
+                for (; i>=0; --i) {
+                    if (i == q) continue;
+                    p += s[i];
+                    o += os[i];
+                    if (++idx[i] < d[i]) break;
+                    p -= s[i]*d[i];
+                    o -= os[i]*d[i];
+                    idx[i] = 0;
+                }
+                if (i < 0) break;
+            }
+        }
+
+        /// Layout of one operand of a contraction: a permutation of its dimensions
+        struct ContractLayout {
+            long nd;                    ///< Number of dimensions
+            long perm[TENSOR_MAXDIM];   ///< Operand dimension that becomes dimension i
+            long dims[TENSOR_MAXDIM];   ///< Permuted dimensions
+            long stride[TENSOR_MAXDIM]; ///< Operand strides of the permuted dimensions
+            bool dense;                 ///< True if the operand is already dense in this layout
+            bool unit;                  ///< True if the fastest permuted dimension has unit stride
+
+            /// Permute dimensions [first..., second..., third...] of t
+            template <typename T>
+            ContractLayout(const Tensor<T>& t,
+                           const std::vector<long>& first,
+                           const std::vector<long>& second,
+                           const std::vector<long>& third) : nd(0) {
+                for (size_t i=0; i<first.size(); ++i) perm[nd++] = first[i];
+                for (size_t i=0; i<second.size(); ++i) perm[nd++] = second[i];
+                for (size_t i=0; i<third.size(); ++i) perm[nd++] = third[i];
+                dense = true;
+                long expect = 1;
+                for (long i=nd-1; i>=0; --i) {
+                    dims[i] = t.dim(perm[i]);
+                    stride[i] = t.stride(perm[i]);
+                    if (dims[i] != 1 && stride[i] != expect) dense = false;
+                    expect *= dims[i];
+                }
+                unit = true;
+                for (long i=nd-1; i>=0; --i) {
+                    if (dims[i] != 1) {
+                        unit = (stride[i] == 1);
+                        break;
+                    }
+                }
+            }
+
+            /// Estimated cost of bringing a tensor of \c size elements into this layout
+            double copy_cost(long size) const {
+                return dense ? 0.0 : (unit ? 2.0 : 4.0)*size;
+            }
+        };
+
+        /// Pointer to the data of \c t in layout \c l, copying into \c buf if needed
+        template <typename T>
+        const T* contract_operand(const Tensor<T>& t, const ContractLayout& l, Tensor<T>& buf) {
+            if (l.dense) return t.ptr();
+            buf = Tensor<T>(l.nd, l.dims, false);
+            permute_copy(l.nd, l.dims, l.stride, t.ptr(), buf.ptr());
+            return buf.ptr();
+        }
+
+        /// Contract \c left and \c right into a dense \c result
+
+        /// Computes
+        /// \code
+        ///    result(b...,i...,j...) (+)= sum(k...) left(...) * right(...)
+        /// \endcode
+        /// where dimensions \c bl[n] of \c left and \c br[n] of \c right are
+        /// batch (Hadamard) indices that appear in the result, dimensions
+        /// \c kl[n] and \c kr[n] are summed over, and the remaining free
+        /// dimensions of \c left then of \c right follow in their original
+        /// order.  The result is accumulated into if \c accumulate is true
+        /// and overwritten otherwise.  No checking of \c result is done.
+        template <class T, class Q>
+        void contract_result(const Tensor<T>& left, const Tensor<Q>& right,
+                             const std::vector<long>& bl, const std::vector<long>& br,
+                             const std::vector<long>& kl, const std::vector<long>& kr,
+                             Tensor<TENSOR_RESULT_TYPE(T,Q)>& result, bool accumulate) {
+            typedef TENSOR_RESULT_TYPE(T,Q) resultT;
+            TENSOR_ASSERT(bl.size()==br.size() && kl.size()==kr.size(),
+                          "contract: index lists differ in length", kl.size(), &left);
+
+            std::vector<bool> used0(left.ndim(), false), used1(right.ndim(), false);
+            long dimb=1, dimk=1;
+            for (size_t n=0; n<bl.size(); ++n) {
+                TENSOR_ASSERT(left.dim(bl[n]) == right.dim(br[n]), "contract: batch index must be same length",
+                              right.dim(br[n]), &left);
+                used0[bl[n]] = used1[br[n]] = true;
+                dimb *= left.dim(bl[n]);
+            }
+            for (size_t n=0; n<kl.size(); ++n) {
+                TENSOR_ASSERT(left.dim(kl[n]) == right.dim(kr[n]), "contract: common index must be same length",
+                              right.dim(kr[n]), &left);
+                used0[kl[n]] = used1[kr[n]] = true;
+                dimk *= left.dim(kl[n]);
+            }
+            std::vector<long> fl, fr;
+            long dimi=1, dimj=1;
+            for (long i=0; i<left.ndim(); ++i) if (!used0[i]) {fl.push_back(i); dimi *= left.dim(i);}
+            for (long i=0; i<right.ndim(); ++i) if (!used1[i]) {fr.push_back(i); dimj *= right.dim(i);}
+
+            // Left is [b,i,k] (N) or [b,k,i] (T); right is [b,k,j] (N) or [b,j,k] (T)
+            const ContractLayout lN(left, bl, fl, kl), lT(left, bl, kl, fl);
+            const ContractLayout rN(right, br, kr, fr), rT(right, br, fr, kr);
+
+            // Only mTxmq is tuned in every build; the others are reference
+            // loops unless a vendor BLAS is present.  mTxmq overwrites, so
+            // accumulating with it costs an extra pass over the result.
+#if defined(HAVE_INTEL_MKL) || defined(HAVE_ACML)
+            const double slow = 1.0;
+#else
+            const double slow = 4.0;
+#endif
+            const double flops = double(dimb)*dimi*dimj*dimk;
+            const long csize = dimb*dimi*dimj;
+            double cost[4];
+            cost[0] = lT.copy_cost(left.size()) + rN.copy_cost(right.size()) + flops
+                + (accumulate ? 2.0*csize : 0.0);                                        // mTxmq
+            cost[1] = lN.copy_cost(left.size()) + rN.copy_cost(right.size()) + slow*flops;  // mxm
+            cost[2] = lN.copy_cost(left.size()) + rT.copy_cost(right.size()) + slow*flops;  // mxmT
+            cost[3] = lT.copy_cost(left.size()) + rT.copy_cost(right.size()) + slow*flops;  // mTxmT
+            int kernel = 0;
+            for (int n=1; n<4; ++n) if (cost[n] < cost[kernel]) kernel = n;
+
+            Tensor<T> lbuf;
+            Tensor<Q> rbuf;
+            const T* a = contract_operand(left, (kernel==0 || kernel==3) ? lT : lN, lbuf);
+            const Q* b = contract_operand(right, (kernel==0 || kernel==1) ? rN : rT, rbuf);
+            resultT* c = result.ptr();
+            const long astep = dimi*dimk, bstep = dimj*dimk, cstep = dimi*dimj;
+
+            if (kernel == 0) {
+                if (accumulate) {
+                    const long d[2] = {dimi, dimj};
+                    Tensor<resultT> tmp(2, d, false);
+                    resultT* restrict t = tmp.ptr();
+                    for (long n=0; n<dimb; ++n, a+=astep, b+=bstep, c+=cstep) {
+                        mTxmq(dimi, dimj, dimk, t, a, b);
+                        for (long m=0; m<cstep; ++m) c[m] += t[m];
+                    }
+                }
+                else {
+                    for (long n=0; n<dimb; ++n, a+=astep, b+=bstep, c+=cstep)
+                        mTxmq(dimi, dimj, dimk, c, a, b);
+                }
+                return;
+            }
+
+            if (!accumulate) for (long m=0; m<csize; ++m) c[m] = resultT(0);
+            for (long n=0; n<dimb; ++n, a+=astep, b+=bstep, c+=cstep) {
+                if (kernel == 1) mxm(dimi, dimj, dimk, c, a, b);
+                else if (kernel == 2) mxmT(dimi, dimj, dimk, c, a, b);
+                else mTxmT(dimi, dimj, dimk, c, a, b);
+            }
+        }
+
+        /// Contraction order and intermediate index strings computed by einsum_plan()
+        struct EinsumPlan {
+            std::vector<std::string> inputs;  ///< Indices of each operand as given
+            std::vector<std::string> reduced; ///< Indices of each operand after summing those used by no other
+            std::string output;               ///< Indices of the result
+            std::vector<std::pair<int,int> > steps; ///< Operands contracted by each step, result gets id inputs.size()+step
+            std::vector<std::string> intermediates; ///< Indices of the result of each step
+            double flops;                     ///< Multiply-adds of the contraction sequence
+        };
+
+        /// Parse an einsum specification and choose the order of pairwise contractions
+
+        /// \c dims[n] are the dimensions of operand \c n.  The order minimizes the
+        /// multiply-add count, exhaustively for up to 10 operands and greedily
+        /// beyond that.
+        EinsumPlan einsum_plan(const std::string& spec, const std::vector< std::vector<long> >& dims);
+
+        /// Dimensions of a tensor as a vector
+        template <typename T>
+        std::vector<long> tensor_dims(const Tensor<T>& t) {
+            return std::vector<long>(t.dims(), t.dims()+t.ndim());
+        }
+
+        /// Sum \c t over the dimensions whose index in \c s is not in \c keep, updating \c s
+        template <typename T>
+        Tensor<T> einsum_reduce(const Tensor<T>& t, std::string& s, const std::string& keep) {
+            Tensor<T> r = t;
+            for (long i=long(s.size())-1; i>=0; --i) {
+                if (keep.find(s[i]) != std::string::npos) continue;
+                if (r.ndim() == 1) {
+                    // Summing the last index yields a scalar ... keep one element
+                    Tensor<T> one(1L);
+                    one(0L) = r.sum();
+                    r = one;
+                }
+                else {
+                    Tensor<T> ones(r.dim(i));
+                    ones = T(1);
+                    r = inner(r, ones, i, 0);
+                }
+                s.erase(i, 1);
+            }
+            return r;
+        }
+
+        /// Contract two operands with index strings \c sa and \c sb into indices \c sr
+        template <class T, class Q>
+        Tensor<TENSOR_RESULT_TYPE(T,Q)> einsum_pair(const Tensor<T>& a, const std::string& sa,
+                                                    const Tensor<Q>& b, const std::string& sb,
+                                                    const std::string& sr) {
+            std::vector<long> bl, br, kl, kr;
+            long d[TENSOR_MAXDIM];
+            long nd = 0;
+            for (size_t i=0; i<sa.size(); ++i) {
+                size_t j = sb.find(sa[i]);
+                if (j == std::string::npos) continue;
+                if (sr.find(sa[i]) != std::string::npos) {
+                    bl.push_back(i); br.push_back(j);
+                    d[nd++] = a.dim(i);
+                }
+                else {
+                    kl.push_back(i); kr.push_back(j);
+                }
+            }
+            for (size_t i=0; i<sa.size(); ++i) if (sb.find(sa[i]) == std::string::npos) d[nd++] = a.dim(i);
+            for (size_t i=0; i<sb.size(); ++i) if (sa.find(sb[i]) == std::string::npos) d[nd++] = b.dim(i);
+            TENSOR_ASSERT(nd == long(sr.size()), "einsum: inconsistent plan", nd, &a);
+            if (nd == 0) d[nd++] = 1; // A scalar intermediate is kept as a vector of length one
+            Tensor<TENSOR_RESULT_TYPE(T,Q)> result(nd, d, false);
+            contract_result(a, b, bl, br, kl, kr, result, false);
+            return result;
+        }
+
+        /// Permute the dimensions of \c t from index order \c s into order \c out
+        template <typename T>
+        Tensor<T> einsum_permute(const Tensor<T>& t, const std::string& s, const std::string& out) {
+            if (s == out) return t;
+            std::vector<long> perm(out.size());
+            for (size_t i=0; i<out.size(); ++i) perm[i] = s.find(out[i]);
+            const ContractLayout l(t, perm, std::vector<long>(), std::vector<long>());
+            Tensor<T> result(l.nd, l.dims, false);
+            permute_copy(l.nd, l.dims, l.stride, t.ptr(), result.ptr());
+            return result;
+        }
+    }
+
+
+    /// Contract \c left and \c right over several pairs of indices
+
+    /// \ingroup tensor
+    /// \code
+    ///    result(i...,j...) = sum(k...) left(...) * right(...)
+    /// \endcode
+    /// Dimension \c k0[n] of \c left is contracted with dimension \c k1[n] of
+    /// \c right; the remaining dimensions of \c left then of \c right make
+    /// up the result in their original order.  With a single pair this is
+    /// \c inner(left,right,k0[0],k1[0]).
+    template <class T, class Q>
+    Tensor<TENSOR_RESULT_TYPE(T,Q)> contract(const Tensor<T>& left, const Tensor<Q>& right,
+                                             const std::vector<long>& k0, const std::vector<long>& k1) {
+        TENSOR_ASSERT(k0.size() == k1.size(), "contract: index lists differ in length", k1.size(), &left);
+        long nd = left.ndim() + right.ndim() - 2*k0.size();
+        TENSOR_ASSERT(nd > 0 && nd <= TENSOR_MAXDIM,
+                      "invalid number of dimensions in the result", nd, 0);
+        std::vector<long> kl(k0), kr(k1);
+        std::vector<bool> used0(left.ndim(), false), used1(right.ndim(), false);
+        for (size_t n=0; n<kl.size(); ++n) {
+            if (kl[n] < 0) kl[n] += left.ndim();
+            if (kr[n] < 0) kr[n] += right.ndim();
+            TENSOR_ASSERT(kl[n]>=0 && kl[n]<left.ndim() && !used0[kl[n]], "contract: invalid index", kl[n], &left);
+            TENSOR_ASSERT(kr[n]>=0 && kr[n]<right.ndim() && !used1[kr[n]], "contract: invalid index", kr[n], &right);
+            used0[kl[n]] = used1[kr[n]] = true;
+        }
+        long d[TENSOR_MAXDIM];
+        long i = 0;
+        for (long j=0; j<left.ndim(); ++j) if (!used0[j]) d[i++] = left.dim(j);
+        for (long j=0; j<right.ndim(); ++j) if (!used1[j]) d[i++] = right.dim(j);
+        Tensor<TENSOR_RESULT_TYPE(T,Q)> result(nd, d, false);
+        detail::contract_result(left, right, std::vector<long>(), std::vector<long>(), kl, kr, result, false);
+        return result;
+    }
+
+    /// Sum of products over repeated indices in the style of numpy.einsum
+
+    /// \ingroup tensor
+    /// The specification lists the indices (single letters) of each operand
+    /// separated by commas and optionally, after \c ->, those of the result
+    /// \code
+    ///    c = einsum("ij,jk->ik", a, b);          // matrix multiply
+    ///    c = einsum("aib,bjc,ck->aijk", x, y, z); // tensor train
+    ///    v = einsum("bij,bj->bi", a, x);         // batched matrix-vector
+    ///    t = einsum("ijk->kji", a);              // permutation
+    /// \endcode
+    /// Without \c -> the result has the indices used exactly once, in
+    /// alphabetical order.  Indices absent from the result are summed
+    /// over; indices that are in the result and in several operands are
+    /// batch indices.  An index may not repeat within one operand (no
+    /// diagonals) and the result may not be a scalar (use \c dot or \c trace).
+    ///
+    /// Operands are contracted in pairs with the engine behind \c inner(),
+    /// in the order that minimizes the number of multiply-adds.  Indices
+    /// that appear in a single operand and not in the result are summed
+    /// out first.
+    template <typename T>
+    Tensor<T> einsum(const std::string& spec, const std::vector< Tensor<T> >& operands) {
+        std::vector< std::vector<long> > dims(operands.size());
+        for (size_t n=0; n<operands.size(); ++n) dims[n] = detail::tensor_dims(operands[n]);
+        const detail::EinsumPlan plan = detail::einsum_plan(spec, dims);
+
+        std::vector< Tensor<T> > work(operands.size());
+        std::vector<std::string> index(plan.reduced);
+        for (size_t n=0; n<operands.size(); ++n) {
+            std::string s = plan.inputs[n];
+            work[n] = detail::einsum_reduce(operands[n], s, plan.reduced[n]);
+        }
+        for (size_t step=0; step<plan.steps.size(); ++step) {
+            const int a = plan.steps[step].first, b = plan.steps[step].second;
+            work.push_back(detail::einsum_pair(work[a], index[a], work[b], index[b], plan.intermediates[step]));
+            index.push_back(plan.intermediates[step]);
+            work[a] = work[b] = Tensor<T>();
+        }
+        return detail::einsum_permute(work.back(), index.back(), plan.output);
+    }
+
+    /// einsum() of a single operand
+
+    /// \ingroup tensor
+    template <typename T>
+    Tensor<T> einsum(const std::string& spec, const Tensor<T>& a) {
+        return einsum(spec, std::vector< Tensor<T> >(1, a));
+    }
+
+    /// einsum() of two operands, which may differ in type
+
+    /// \ingroup tensor
+    template <typename T, typename Q>
+    Tensor<TENSOR_RESULT_TYPE(T,Q)> einsum(const std::string& spec, const Tensor<T>& a, const Tensor<Q>& b) {
+        std::vector< std::vector<long> > dims(2);
+        dims[0] = detail::tensor_dims(a);
+        dims[1] = detail::tensor_dims(b);
+        const detail::EinsumPlan plan = detail::einsum_plan(spec, dims);
+        std::string sa = plan.inputs[0], sb = plan.inputs[1];
+        const Tensor<T> ra = detail::einsum_reduce(a, sa, plan.reduced[0]);
+        const Tensor<Q> rb = detail::einsum_reduce(b, sb, plan.reduced[1]);
+        const std::string& sr = plan.intermediates[0];
+        return detail::einsum_permute(detail::einsum_pair(ra, sa, rb, sb, sr), sr, plan.output);
+    }
+
+    /// einsum() of three operands
+
+    /// \ingroup tensor
+    template <typename T>
+    Tensor<T> einsum(const std::string& spec, const Tensor<T>& a, const Tensor<T>& b, const Tensor<T>& c) {
+        std::vector< Tensor<T> > operands;
+        operands.push_back(a);
+        operands.push_back(b);
+        operands.push_back(c);
+        return einsum(spec, operands);
+    }
+}
+
+#endif // MADNESS_TENSOR_TENSOR_CONTRACT_H__INCLUDED
@@ -0,0 +1,499 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_TENSOR_TENSOR_EXPR_H__INCLUDED
+#define MADNESS_TENSOR_TENSOR_EXPR_H__INCLUDED
+
+/// \file tensor/tensor_expr.h
+/// \brief Expression templates that fuse element-wise Tensor arithmetic into one loop
+
+/// The arithmetic operators of Tensor each make a new tensor, so
+/// \code
+///    a = b*2.0 + c - d.emul(e)
+/// \endcode
+/// makes several passes over memory and as many temporaries.  Wrapping
+/// one operand with \c lazy() instead builds an expression that is
+/// evaluated element by element in a single loop when it is assigned
+/// \code
+///    a = lazy(b)*2.0 + c - emul(d,e);  // one pass, one new tensor
+///    a += 0.5*emul(lazy(b),c);         // one pass, in place
+///    a.gaxpy(0.9, lazy(b) - c, 0.1);   // one pass, in place
+/// \endcode
+/// Once one operand is an expression, Tensor operands and scalars mix
+/// freely with it.  Leaves are shallow copies of their tensors so an
+/// expression may safely outlive the statement that made it, but it
+/// sees later changes to the data.
+///
+/// As with the Tensor operators, assignment binds the target to a new
+/// tensor while the compound assignments, \c gaxpy and \c emul update the
+/// target in place.  If the target and all leaves are contiguous the
+/// expression is evaluated with a single flat loop the compiler can
+/// vectorize.  Otherwise the non-contiguous leaves are first copied and a
+/// non-contiguous target is updated through the optimized iterator.  A
+/// leaf may be the target itself, but a contiguous leaf must not
+/// partially overlap a contiguous target.
+
+#include <madness/tensor/tensor.h>
+
+namespace madness {
+
+    /// Base class of all tensor expressions (curiously recurring template)
+
+    /// Every expression type \c E provides
+    /// - \c value_type, the type of its elements;
+    /// - \c operator[](long i), element \c i in the flat order of a contiguous tensor;
+    /// - \c iscontiguous(), true if every leaf is contiguous;
+    /// - \c base(), the shape of the first leaf;
+    /// - \c conforms(const BaseTensor*), true if every leaf conforms to the argument;
+    /// - \c make_contiguous(), which replaces non-contiguous leaves with contiguous copies.
+    /// \ingroup tensor
+    template <typename E>
+    class TensorExpr {
+    public:
+        /// Returns the expression as its derived type
+        const E& derived() const {
+            return static_cast<const E&>(*this);
+        }
+    };
+
+    /// Leaf of an expression holding a shallow copy of a tensor
+
+    /// \ingroup tensor
+    template <typename T>
+    class TensorExprLeaf : public TensorExpr< TensorExprLeaf<T> > {
+        Tensor<T> t;
+        const T* p;             ///< Cached pointer so that the loop does not reload it
+
+    public:
+        typedef T value_type;
+
+        explicit TensorExprLeaf(const Tensor<T>& t) : t(t), p(t.ptr()) {}
+
+        T operator[](long i) const {
+            return p[i];
+        }
+
+        bool iscontiguous() const {
+            return t.iscontiguous();
+        }
+
+        const BaseTensor* base() const {
+            return t.base();
+        }
+
+        bool conforms(const BaseTensor* b) const {
+            return b->conforms(t.base());
+        }
+
+        void make_contiguous() {
+            if (!t.iscontiguous()) {
+                t = copy(t);
+                p = t.ptr();
+            }
+        }
+    };
+
+    /// Element-wise operation on two expressions
+    template <typename L, typename R, typename opT>
+    class TensorExprBinary : public TensorExpr< TensorExprBinary<L,R,opT> > {
+        L l;
+        R r;
+
+    public:
+        typedef typename opT::value_type value_type;
+
+        TensorExprBinary(const L& l, const R& r) : l(l), r(r) {}
+
+        value_type operator[](long i) const {
+            return opT::apply(l[i], r[i]);
+        }
+
+        bool iscontiguous() const {
+            return l.iscontiguous() && r.iscontiguous();
+        }
+
+        const BaseTensor* base() const {
+            return l.base();
+        }
+
+        bool conforms(const BaseTensor* b) const {
+            return l.conforms(b) && r.conforms(b);
+        }
+
+        void make_contiguous() {
+            l.make_contiguous();
+            r.make_contiguous();
+        }
+    };
+
+    /// Element-wise operation of an expression with a scalar
+    template <typename E, typename Q, typename opT>
+    class TensorExprScalar : public TensorExpr< TensorExprScalar<E,Q,opT> > {
+        E e;
+        Q s;
+
+    public:
+        typedef typename opT::value_type value_type;
+
+        TensorExprScalar(const E& e, const Q& s) : e(e), s(s) {}
+
+        value_type operator[](long i) const {
+            return opT::apply(e[i], s);
+        }
+
+        bool iscontiguous() const {
+            return e.iscontiguous();
+        }
+
+        const BaseTensor* base() const {
+            return e.base();
+        }
+
+        bool conforms(const BaseTensor* b) const {
+            return e.conforms(b);
+        }
+
+        void make_contiguous() {
+            e.make_contiguous();
+        }
+    };
+
+    /// Element-wise negation of an expression
+    template <typename E>
+    class TensorExprNegate : public TensorExpr< TensorExprNegate<E> > {
+        E e;
+
+    public:
+        typedef typename E::value_type value_type;
+
+        explicit TensorExprNegate(const E& e) : e(e) {}
+
+        value_type operator[](long i) const {
+            return -e[i];
+        }
+
+        bool iscontiguous() const {
+            return e.iscontiguous();
+        }
+
+        const BaseTensor* base() const {
+            return e.base();
+        }
+
+        bool conforms(const BaseTensor* b) const {
+            return e.conforms(b);
+        }
+
+        void make_contiguous() {
+            e.make_contiguous();
+        }
+    };
+
+    namespace detail {
+
+        /// Element operations ... \c x is an element of the expression and \c y an element or scalar
+
+        template <typename L, typename R>
+        struct TensorExprAdd {
+            typedef TENSOR_RESULT_TYPE(L,R) value_type;
+            static value_type apply(const L& x, const R& y) {return x + y;}
+        };
+
+        template <typename L, typename R>
+        struct TensorExprSub {
+            typedef TENSOR_RESULT_TYPE(L,R) value_type;
+            static value_type apply(const L& x, const R& y) {return x - y;}
+        };
+
+        template <typename L, typename R>
+        struct TensorExprMul {
+            typedef TENSOR_RESULT_TYPE(L,R) value_type;
+            static value_type apply(const L& x, const R& y) {return x * y;}
+        };
+
+        template <typename L, typename R>
+        struct TensorExprDiv {
+            typedef TENSOR_RESULT_TYPE(L,R) value_type;
+            static value_type apply(const L& x, const R& y) {return x / y;}
+        };
+
+        /// Scalar minus element
+        template <typename L, typename R>
+        struct TensorExprRSub {
+            typedef TENSOR_RESULT_TYPE(L,R) value_type;
+            static value_type apply(const L& x, const R& y) {return y - x;}
+        };
+
+        /// How the value of an expression is stored into the target
+
+        struct TensorExprAssign {
+            template <typename T, typename Q>
+            static void apply(T& x, const Q& y) {x = y;}
+        };
+
+        struct TensorExprAddAssign {
+            template <typename T, typename Q>
+            static void apply(T& x, const Q& y) {x += y;}
+        };
+
+        struct TensorExprSubAssign {
+            template <typename T, typename Q>
+            static void apply(T& x, const Q& y) {x -= y;}
+        };
+
+        struct TensorExprMulAssign {
+            template <typename T, typename Q>
+            static void apply(T& x, const Q& y) {x *= y;}
+        };
+
+        /// The flat loop over contiguous data
+        template <typename assignT, typename T, typename E>
+        void tensor_expr_loop(long n, T* p, const E& e) {
+            for (long i=0; i<n; ++i) assignT::apply(p[i], e[i]);
+        }
+
+        /// Evaluates an expression into a conforming tensor
+        template <typename assignT, typename T, typename E>
+        void tensor_expr_eval(Tensor<T>& result, const E& e) {
+            TENSOR_ASSERT(e.conforms(result.base()), "tensor expression does not conform", result.ndim(), &result);
+            if (result.iscontiguous() && e.iscontiguous()) {
+                tensor_expr_loop<assignT>(result.size(), result.ptr(), e);
+            }
+            else {
+                E c(e);
+                c.make_contiguous();
+                if (result.iscontiguous()) {
+                    tensor_expr_loop<assignT>(result.size(), result.ptr(), c);
+                }
+                else {
+                    typedef typename E::value_type valueT;
+                    Tensor<valueT> tmp(result.ndim(), result.dims(), false);
+                    tensor_expr_loop<TensorExprAssign>(tmp.size(), tmp.ptr(), c);
+                    BINARY_OPTIMIZED_ITERATOR(T, result, const valueT, tmp, assignT::apply(*_p0, *_p1));
+                }
+            }
+        }
+
+    } // namespace detail
+
+    /// Returns an expression leaf wrapping a tensor (shallow copy), which starts a fused expression
+
+    /// \ingroup tensor
+    template <typename T>
+    TensorExprLeaf<T> lazy(const Tensor<T>& t) {
+        return TensorExprLeaf<T>(t);
+    }
+
+    /// Sum of two expressions (or an expression and a tensor)
+
+    /// \ingroup tensor
+    template <typename L, typename R>
+    TensorExprBinary<L, R, detail::TensorExprAdd<typename L::value_type, typename R::value_type> >
+    operator+(const TensorExpr<L>& l, const TensorExpr<R>& r) {
+        return TensorExprBinary<L, R, detail::TensorExprAdd<typename L::value_type, typename R::value_type> >(l.derived(), r.derived());
+    }
+
+    template <typename L, typename Q>
+    TensorExprBinary<L, TensorExprLeaf<Q>, detail::TensorExprAdd<typename L::value_type, Q> >
+    operator+(const TensorExpr<L>& l, const Tensor<Q>& r) {
+        return l + lazy(r);
+    }
+
+    template <typename Q, typename R>
+    TensorExprBinary<TensorExprLeaf<Q>, R, detail::TensorExprAdd<Q, typename R::value_type> >
+    operator+(const Tensor<Q>& l, const TensorExpr<R>& r) {
+        return lazy(l) + r;
+    }
+
+    /// Difference of two expressions (or an expression and a tensor)
+
+    /// \ingroup tensor
+    template <typename L, typename R>
+    TensorExprBinary<L, R, detail::TensorExprSub<typename L::value_type, typename R::value_type> >
+    operator-(const TensorExpr<L>& l, const TensorExpr<R>& r) {
+        return TensorExprBinary<L, R, detail::TensorExprSub<typename L::value_type, typename R::value_type> >(l.derived(), r.derived());
+    }
+
+    template <typename L, typename Q>
+    TensorExprBinary<L, TensorExprLeaf<Q>, detail::TensorExprSub<typename L::value_type, Q> >
+    operator-(const TensorExpr<L>& l, const Tensor<Q>& r) {
+        return l - lazy(r);
+    }
+
+    template <typename Q, typename R>
+    TensorExprBinary<TensorExprLeaf<Q>, R, detail::TensorExprSub<Q, typename R::value_type> >
+    operator-(const Tensor<Q>& l, const TensorExpr<R>& r) {
+        return lazy(l) - r;
+    }
+
+    /// Element-wise product of two expressions (or an expression and a tensor)
+
+    /// \ingroup tensor
+    template <typename L, typename R>
+    TensorExprBinary<L, R, detail::TensorExprMul<typename L::value_type, typename R::value_type> >
+    emul(const TensorExpr<L>& l, const TensorExpr<R>& r) {
+        return TensorExprBinary<L, R, detail::TensorExprMul<typename L::value_type, typename R::value_type> >(l.derived(), r.derived());
+    }
+
+    template <typename L, typename Q>
+    TensorExprBinary<L, TensorExprLeaf<Q>, detail::TensorExprMul<typename L::value_type, Q> >
+    emul(const TensorExpr<L>& l, const Tensor<Q>& r) {
+        return emul(l, lazy(r));
+    }
+
+    template <typename Q, typename R>
+    TensorExprBinary<TensorExprLeaf<Q>, R, detail::TensorExprMul<Q, typename R::value_type> >
+    emul(const Tensor<Q>& l, const TensorExpr<R>& r) {
+        return emul(lazy(l), r);
+    }
+
+    /// Element-wise product of two tensors as an expression
+
+    /// \ingroup tensor
+    template <typename L, typename R>
+    TensorExprBinary<TensorExprLeaf<L>, TensorExprLeaf<R>, detail::TensorExprMul<L, R> >
+    emul(const Tensor<L>& l, const Tensor<R>& r) {
+        return emul(lazy(l), lazy(r));
+    }
+
+    /// Expression times a scalar of a supported type
+
+    /// \ingroup tensor
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprMul<typename E::value_type, Q> > >::type
+    operator*(const TensorExpr<E>& e, const Q& s) {
+        return TensorExprScalar<E, Q, detail::TensorExprMul<typename E::value_type, Q> >(e.derived(), s);
+    }
+
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprMul<typename E::value_type, Q> > >::type
+    operator*(const Q& s, const TensorExpr<E>& e) {
+        return e*s;
+    }
+
+    /// Expression divided by a scalar of a supported type
+
+    /// \ingroup tensor
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprDiv<typename E::value_type, Q> > >::type
+    operator/(const TensorExpr<E>& e, const Q& s) {
+        return TensorExprScalar<E, Q, detail::TensorExprDiv<typename E::value_type, Q> >(e.derived(), s);
+    }
+
+    /// Expression plus a scalar of a supported type
+
+    /// \ingroup tensor
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprAdd<typename E::value_type, Q> > >::type
+    operator+(const TensorExpr<E>& e, const Q& s) {
+        return TensorExprScalar<E, Q, detail::TensorExprAdd<typename E::value_type, Q> >(e.derived(), s);
+    }
+
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprAdd<typename E::value_type, Q> > >::type
+    operator+(const Q& s, const TensorExpr<E>& e) {
+        return e+s;
+    }
+
+    /// Expression minus a scalar of a supported type
+
+    /// \ingroup tensor
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprSub<typename E::value_type, Q> > >::type
+    operator-(const TensorExpr<E>& e, const Q& s) {
+        return TensorExprScalar<E, Q, detail::TensorExprSub<typename E::value_type, Q> >(e.derived(), s);
+    }
+
+    /// Scalar of a supported type minus an expression
+
+    /// \ingroup tensor
+    template <typename E, typename Q>
+    typename IsSupported<TensorTypeData<Q>, TensorExprScalar<E, Q, detail::TensorExprRSub<typename E::value_type, Q> > >::type
+    operator-(const Q& s, const TensorExpr<E>& e) {
+        return TensorExprScalar<E, Q, detail::TensorExprRSub<typename E::value_type, Q> >(e.derived(), s);
+    }
+
+    /// Negation of an expression
+
+    /// \ingroup tensor
+    template <typename E>
+    TensorExprNegate<E> operator-(const TensorExpr<E>& e) {
+        return TensorExprNegate<E>(e.derived());
+    }
+
+    // Members of Tensor that take expressions
+
+    template <typename T>
+    template <typename E>
+    Tensor<T>::Tensor(const TensorExpr<E>& e) : _p(0) {
+        const BaseTensor* b = e.derived().base();
+        allocate(b->ndim(), b->dims(), false);
+        detail::tensor_expr_eval<detail::TensorExprAssign>(*this, e.derived());
+    }
+
+    template <typename T>
+    template <typename E>
+    Tensor<T>& Tensor<T>::operator=(const TensorExpr<E>& e) {
+        *this = Tensor<T>(e);
+        return *this;
+    }
+
+    template <typename T>
+    template <typename E>
+    Tensor<T>& Tensor<T>::operator+=(const TensorExpr<E>& e) {
+        detail::tensor_expr_eval<detail::TensorExprAddAssign>(*this, e.derived());
+        return *this;
+    }
+
+    template <typename T>
+    template <typename E>
+    Tensor<T>& Tensor<T>::operator-=(const TensorExpr<E>& e) {
+        detail::tensor_expr_eval<detail::TensorExprSubAssign>(*this, e.derived());
+        return *this;
+    }
+
+    template <typename T>
+    template <typename E>
+    Tensor<T>& Tensor<T>::emul(const TensorExpr<E>& e) {
+        detail::tensor_expr_eval<detail::TensorExprMulAssign>(*this, e.derived());
+        return *this;
+    }
+
+    template <typename T>
+    template <typename E>
+    Tensor<T>& Tensor<T>::gaxpy(T alpha, const TensorExpr<E>& e, T beta) {
+        detail::tensor_expr_eval<detail::TensorExprAssign>(*this, lazy(*this)*alpha + e*beta);
+        return *this;
+    }
+
+} // namespace madness
+
+#endif // MADNESS_TENSOR_TENSOR_EXPR_H__INCLUDED
@@ -38,6 +38,8 @@
 
 #include <madness/tensor/tensor.h>
 #include <madness/fortran_ctypes.h>
+#include <madness/tensor/mtxmq_simd.h>
+#include <vector>
 
 /*!
   \file tensor_lapack.h
@@ -145,6 +147,46 @@ namespace madness {
     void orgqr(Tensor<T>& A, const Tensor<T>& tau);
 
 
+    /// Solves the symmetric or Hermitian eigenvalue problems of many small matrices
+
+    /// Same results as calling \c syev on each of \c A[i].  Real double
+    /// precision matrices of the same size are decomposed together with
+    /// SIMD Jacobi kernels (up to 24x24), everything else goes to LAPACK.
+    /// \ingroup linalg
+    template <typename T>
+    void syev_batched(const std::vector< Tensor<T> >& A, std::vector< Tensor<T> >& V,
+                      std::vector< Tensor<typename Tensor<T>::scalar_type> >& e);
+
+    /// Computes the thin singular value decompositions of many small matrices
+
+    /// Same results (up to the signs of the singular vectors) as calling \c svd
+    /// on each of \c A[i].  Real double precision matrices of the same shape
+    /// with min(m,n)<=32 are decomposed together with SIMD one-sided Jacobi kernels.
+    /// \ingroup linalg
+    template <typename T>
+    void svd_batched(const std::vector< Tensor<T> >& A, std::vector< Tensor<T> >& U,
+                     std::vector< Tensor<typename Tensor<T>::scalar_type> >& s, std::vector< Tensor<T> >& VT);
+
+    /// QR decompositions of many small matrices
+
+    /// Same as calling \c qr on each of \c A[i] (up to the signs of the
+    /// columns of Q and rows of R).  Real double precision matrices of the
+    /// same shape are decomposed together with SIMD Householder kernels.
+    /// \ingroup linalg
+    template <typename T>
+    void qr_batched(std::vector< Tensor<T> >& A, std::vector< Tensor<T> >& R);
+
+    /// Returns the instruction set currently used by the batched decompositions
+    MTxmqISA batched_linalg_isa();
+
+    /// Selects the instruction set of the batched decompositions (lowered to what the processor supports)
+
+    /// \c MTXMQ_ISA_REFERENCE calls LAPACK for each matrix.  The default can be
+    /// set with \c MAD_BATCHED_LINALG_ISA (\c reference, \c avx2 or \c avx512).
+    /// Not thread safe ... intended for testing and benchmarking
+    /// \return The instruction set actually selected
+    MTxmqISA batched_linalg_set_isa(MTxmqISA isa);
+
     /// Dunno
     
 //     /// \ingroup linalg
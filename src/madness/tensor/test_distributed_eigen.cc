@@ -0,0 +1,150 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/test_distributed_eigen.cc
+/// \brief Tests and times the distributed symmetric eigensolvers
+
+/// Without arguments the solvers are tested against LAPACK for small
+/// matrices.  With arguments it times them, e.g.,
+/// \code
+///   for n in 1000 2000 5000 10000; do mpirun -np 16 ./test_distributed_eigen $n; done
+/// \endcode
+/// reports for each n the time of the distributed syev and sygv
+/// and of the replicated LAPACK routines.
+
+#define WORLD_INSTANTIATE_STATIC_TEMPLATES
+
+#include <madness/madness_config.h>
+#include <madness/world/MADworld.h>
+#include <madness/tensor/distributed_eigen.h>
+#include <madness/tensor/tensor_lapack.h>
+#include <cstdlib>
+
+using namespace madness;
+
+double aij(int64_t i, int64_t j) {
+    return std::cos(0.3*(i+j)) + 1.0/(1.0 + std::abs(i-j)) + (i==j ? 0.01*i : 0.0);
+}
+
+double bij(int64_t i, int64_t j) {
+    return (i==j ? 1.0 : 0.0) + 0.2*std::exp(-0.5*std::abs(i-j));
+}
+
+Tensor<double> replicated(const DistributedMatrix<double>& A) {
+    Tensor<double> a(A.coldim(), A.rowdim());
+    A.copy_to_replicated(a);
+    return a;
+}
+
+/// Returns the max error of the eigenpairs ilo..ihi relative to LAPACK and the residual A V - B V e
+double check(World& world, int64_t n, int64_t ilo, int64_t ihi, bool generalized) {
+    DistributedMatrix<double> A = block_distributed_matrix<double>(world, n, n);
+    DistributedMatrix<double> B = column_distributed_matrix<double>(world, n, n);
+    A.fill(aij);
+    B.fill(bij);
+
+    DistributedMatrix<double> V;
+    Tensor<double> e;
+    if (generalized) sygv(A, B, V, e, ilo, ihi);
+    else syev(A, V, e, ilo, ihi);
+
+    Tensor<double> a = replicated(A), b = replicated(B), v = replicated(V);
+    if (!generalized) {
+        b = Tensor<double>(n,n);
+        for (int64_t i=0; i<n; i++) b(i,i) = 1.0;
+    }
+
+    Tensor<double> vref, eref;
+    sygv(a, b, 1, vref, eref);
+
+    double err = (e - eref(Slice(ilo,ihi))).absmax();
+    Tensor<double> bve = inner(b,v);
+    for (int64_t k=0; k<e.dim(0); k++) bve(_,k).scale(e(k));
+    Tensor<double> r = inner(a,v) - bve;
+    err = std::max(err, r.absmax());
+    Tensor<double> s = inner(v,inner(b,v),0,0);
+    for (int64_t i=0; i<s.dim(0); i++) s(i,i) -= 1.0;
+    err = std::max(err, s.absmax());
+    return err;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+
+    int status = 0;
+    if (argc == 1) {
+        const int64_t sizes[] = {1, 2, 3, 8, 31, 64};
+        for (int64_t n : sizes) {
+            for (int generalized=0; generalized<2; generalized++) {
+                const double full = check(world, n, 0, n-1, generalized);
+                const double part = check(world, n, n/4, n/2, generalized);
+                if (world.rank() == 0) print(generalized ? "sygv" : "syev", "n", n, "error", full, "partial", part);
+                if (full > 1e-10 || part > 1e-10) status = 1;
+            }
+        }
+        if (world.rank() == 0) print(status ? "distributed eigensolver tests FAILED" : "distributed eigensolver tests passed");
+    }
+    else {
+        const int64_t n = std::atol(argv[1]);
+        DistributedMatrix<double> A = block_distributed_matrix<double>(world, n, n);
+        DistributedMatrix<double> B = block_distributed_matrix<double>(world, n, n);
+        A.fill(aij);
+        B.fill(bij);
+        DistributedMatrix<double> V;
+        Tensor<double> e;
+
+        world.gop.fence();
+        double start = wall_time();
+        syev(A, V, e);
+        const double used_syev = wall_time() - start;
+        start = wall_time();
+        sygv(A, B, V, e);
+        const double used_sygv = wall_time() - start;
+
+        Tensor<double> a = replicated(A), b = replicated(B), v, eref;
+        start = wall_time();
+        syev(a, v, eref);
+        const double used_lapack_syev = wall_time() - start;
+        start = wall_time();
+        sygv(a, b, 1, v, eref);
+        const double used_lapack_sygv = wall_time() - start;
+
+        if (world.rank() == 0)
+            printf("n=%ld nproc=%d  syev %.2f s (LAPACK %.2f s)  sygv %.2f s (LAPACK %.2f s)  error %.1e\n",
+                   long(n), world.size(), used_syev, used_lapack_syev, used_sygv, used_lapack_sygv,
+                   (e-eref).absmax());
+    }
+
+    world.gop.fence();
+    finalize();
+    return status;
+}
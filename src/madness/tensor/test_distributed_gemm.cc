@@ -0,0 +1,102 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/test_distributed_gemm.cc
+/// \brief Times gemm of distributed matrices against the replicated product
+
+/// Run as, e.g.,
+/// \code
+///   for np in 2 4 8 16 32; do mpirun -np $np ./test_distributed_gemm 4000; done
+/// \endcode
+/// for the scaling with the number of processes for a 4000x4000 product.
+/// Each line reports the time of the distributed gemm, of the replicated
+/// product that every process computes otherwise, and the error.
+
+#define WORLD_INSTANTIATE_STATIC_TEMPLATES
+
+#include <madness/madness_config.h>
+#include <madness/world/MADworld.h>
+#include <madness/tensor/distributed_matrix.h>
+#include <madness/tensor/distributed_gemm.h>
+#include <cstdlib>
+
+using namespace madness;
+
+double aij(int64_t i, int64_t j) {return std::sin(0.001*i*j + 0.1*i);}
+double bij(int64_t i, int64_t j) {return std::cos(0.002*i - 0.003*j*i);}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+
+    const int64_t n = (argc > 1) ? std::atol(argv[1]) : 400;
+    const int nrep = (argc > 2) ? std::atoi(argv[2]) : 3;
+
+    DistributedMatrix<double> A = block_distributed_matrix<double>(world, n, n);
+    DistributedMatrix<double> B = block_distributed_matrix<double>(world, n, n);
+    DistributedMatrix<double> C = block_distributed_matrix<double>(world, n, n);
+    A.fill(aij);
+    B.fill(bij);
+
+    double used = 1e99;
+    for (int rep=0; rep<nrep; rep++) {
+        world.gop.fence();
+        const double start = wall_time();
+        gemm(1.0, A, B, 0.0, C);
+        used = std::min(used, wall_time()-start);
+    }
+
+    // the replicated product each process would otherwise compute
+    Tensor<double> a(n,n), b(n,n);
+    A.copy_to_replicated(a);
+    B.copy_to_replicated(b);
+    world.gop.fence();
+    const double start = wall_time();
+    Tensor<double> c = inner(a,b);
+    const double used_rep = wall_time()-start;
+
+    double err = 0.0;
+    for (int64_t i=C.local_ilow(); i<=C.local_ihigh(); i++)
+        for (int64_t j=C.local_jlow(); j<=C.local_jhigh(); j++)
+            err = std::max(err, std::abs(C.get(i,j)-c(i,j)));
+    world.gop.max(err);
+
+    if (world.rank() == 0) {
+        printf("gemm n=%ld nproc=%d grid=%ldx%ld  distributed %.3f s (%.2f GFLOP/s)  replicated %.3f s  error %.1e\n",
+               long(n), world.size(), long(C.process_coldim()), long(C.process_rowdim()),
+               used, 2e-9*n*n*n/used, used_rep, err);
+    }
+    const bool ok = err < 1e-10*n;
+
+    world.gop.fence();
+    finalize();
+    return ok ? 0 : 1;
+}
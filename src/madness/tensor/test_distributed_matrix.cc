@@ -3,6 +3,7 @@
 #include <madness/madness_config.h>
 #include <madness/world/MADworld.h>
 #include <madness/tensor/distributed_matrix.h>
+#include <madness/tensor/distributed_gemm.h>
 
 using namespace madness;
 
@@ -33,6 +34,75 @@ void check(DistributedMatrix<double>& A) {
     }
 }
 
+double aij(int64_t i, int64_t j) {return std::sin(0.1*i + 0.37*j);}
+double bij(int64_t i, int64_t j) {return std::cos(0.23*i - 0.11*j);}
+
+// verifies that each process holds the elements of f
+template <typename funcT>
+void check_values(const DistributedMatrix<double>& A, const funcT& f, double tol) {
+    for (int64_t i=A.local_ilow(); i<=A.local_ihigh(); i++) {
+        for (int64_t j=A.local_jlow(); j<=A.local_jhigh(); j++) {
+            if (std::abs(A.get(i,j) - f(i,j)) > tol) {
+                print("bad element", i, j, A.get(i,j), f(i,j));
+                MADNESS_EXCEPTION("distributed matrix has the wrong value", 0);
+            }
+        }
+    }
+}
+
+void check_redistribute(World& world, int64_t n, int64_t m) {
+    DistributedMatrix<double> A = column_distributed_matrix<double>(world, n, m, 13);
+    A.fill(ij);
+
+    DistributedMatrix<double> B = redistribute(A, block_distributed_matrix_distribution(world, n, m));
+    check_values(B, ij, 0.0);
+
+    DistributedMatrix<double> C = redistribute(B, row_distributed_matrix_distribution(world, n, m));
+    check_values(C, ij, 0.0);
+
+    DistributedMatrix<double> D = transpose(A);
+    MADNESS_ASSERT(D.coldim()==m && D.rowdim()==n && D.is_row_distributed());
+    check_values(D, [](int64_t i, int64_t j) {return ij(j,i);}, 0.0);
+}
+
+// a tile size that is given is kept and only the other one is chosen
+void check_tiles(World& world, int64_t n, int64_t m) {
+    const int64_t P = world.size();
+    DistributedMatrixDistribution d = block_distributed_matrix_distribution(world, n, m, 0, m);
+    MADNESS_ASSERT(d.rowtile()==m && d.coltile()==(n-1)/P+1);
+    d = block_distributed_matrix_distribution(world, n, m, n, 0);
+    MADNESS_ASSERT(d.coltile()==n && d.rowtile()==(m-1)/P+1);
+    if (P%2 == 0) {
+        d = block_distributed_matrix_distribution(world, n, m, 0, (m-1)/2+1);
+        MADNESS_ASSERT(d.rowtile()==(m-1)/2+1 && d.coltile()==(n-1)/(P/2)+1);
+    }
+}
+
+void check_gemm(World& world, int64_t n, int64_t k, int64_t m) {
+    // reference product on every process
+    Tensor<double> a(n,k), b(k,m);
+    for (int64_t i=0; i<n; i++) for (int64_t j=0; j<k; j++) a(i,j) = aij(i,j);
+    for (int64_t i=0; i<k; i++) for (int64_t j=0; j<m; j++) b(i,j) = bij(i,j);
+    Tensor<double> c = inner(a,b);
+    auto cij = [&c](int64_t i, int64_t j) {return c(i,j);};
+
+    // mixed distributions of the operands
+    DistributedMatrix<double> A = column_distributed_matrix<double>(world, n, k);
+    DistributedMatrix<double> B = row_distributed_matrix<double>(world, k, m);
+    A.fill(aij);
+    B.fill(bij);
+    DistributedMatrix<double> C = inner(A, B);
+    check_values(C, cij, 1e-10*k);
+
+    // C = 2*A*B - C on a column distributed result with narrow panels
+    DistributedMatrix<double> D = column_distributed_matrix<double>(world, n, m);
+    D.fill(cij);
+    DistributedMatrix<double> Ab = block_distributed_matrix<double>(world, n, k);
+    Ab.fill(aij);
+    gemm(2.0, Ab, B, -1.0, D, 7);
+    check_values(D, cij, 1e-10*k);
+}
+
 int main(int argc, char** argv) {
     initialize(argc, argv);
     World world(SafeMPI::COMM_WORLD);
@@ -48,7 +118,13 @@ int main(int argc, char** argv) {
         check(A);
     }
 
+    check_redistribute(world, n, m);
+    check_tiles(world, n, m);
+    check_gemm(world, 97, 131, 61);
+    check_gemm(world, 1, 300, 5);
+
     world.gop.fence();
+    if (world.rank() == 0) print("distributed matrix tests passed");
     finalize();
     return 0;
 }
@@ -36,8 +36,10 @@
 #include <madness/tensor/gentensor.h>
 #include <madness/tensor/lowranktensor.h>
 #include <madness/world/print.h>
+#include <madness/world/timers.h>
+#include <cstdio>
 
-#if defined USE_GENTENSOR && MADNESS_HAS_GOOGLE_TEST
+#if MADNESS_HAS_GOOGLE_TEST
 
 // The test code deliberately uses only the dumb ITERATOR macros
 // in order to test the optimized iterators used by the implementation.
@@ -364,6 +366,36 @@ namespace {
     	}
     }
 
+    // checks for randomized rank reduction and addition
+    TEST_P(BinaryGenTest, RandomizedRankReduction) {
+    	try {
+    		t0+=t1;
+    		LowRankTensor<double> g2=copy(g0);
+    		g2+=g1;
+    		LowRankTensor<double> g3=copy(g2);
+    		g2.reduce_rank_randomized(eps);
+    		ASSERT_LT((g2.full_tensor_copy()-t0).normf(),eps);
+
+    		// fold g1 into g0 without an SVD of the sum
+    		g0.add_randomized(g1,eps);
+    		ASSERT_LT((g0.full_tensor_copy()-t0).normf(),eps);
+
+    		// the ranks are close to those of the deterministic reduction
+    		if (tt==TT_2D) {
+    			g3.reduce_rank(eps);
+    			EXPECT_LE(g0.rank(),g3.rank()+1);
+    			EXPECT_LE(g2.rank(),g3.rank()+1);
+    		}
+
+    	} catch (const madness::TensorException& e) {
+    		if (dim.size() != 0) std::cout << e;
+    		EXPECT_EQ(dim.size(),0);
+    	} catch(...) {
+    		std::cout << "Caught unknown exception" << std::endl;
+    		EXPECT_EQ(1,0);
+    	}
+    }
+
     // checks for addition with slices
     TEST_P(BinaryGenTest, SliceAddition) {
         Tensor<double> t0_save=copy(t0);
@@ -650,6 +682,163 @@ namespace {
         }
     }
 
+    /// 6D tensor resembling a pair function: two orbitals times a Gaussian correlation factor
+    Tensor<double> pair_function(const long k, const double alpha, const double gamma) {
+        Tensor<double> t(std::vector<long>(6,k));
+        std::vector<double> x(k);
+        for (long i=0; i<k; ++i) x[i]=-1.0+2.0*i/(k-1);
+        for (long i1=0; i1<k; ++i1) for (long j1=0; j1<k; ++j1) for (long k1=0; k1<k; ++k1) {
+            const double r1=x[i1]*x[i1]+x[j1]*x[j1]+x[k1]*x[k1];
+            for (long i2=0; i2<k; ++i2) for (long j2=0; j2<k; ++j2) for (long k2=0; k2<k; ++k2) {
+                const double r2=x[i2]*x[i2]+x[j2]*x[j2]+x[k2]*x[k2];
+                const double dx=x[i1]-x[i2], dy=x[j1]-x[j2], dz=x[k1]-x[k2];
+                t(i1,j1,k1,i2,j2,k2)=exp(-alpha*(r1+r2)-gamma*(dx*dx+dy*dy+dz*dz));
+            }
+        }
+        return t;
+    }
+
+    // Accumulation and rank reduction of TT_2D pair functions with the batched
+    // small decompositions and with LAPACK for each matrix ... also reports the timings
+    TEST(LowRankTensorBenchmark, PairFunctionReduceRank) {
+        const long k=6, nterm=4, nloop=3;
+        const double thresh=1.e-4;
+
+        Tensor<double> tsum(std::vector<long>(6,k));
+        std::vector<LowRankTensor<double> > terms;
+        for (long n=0; n<nterm; ++n) {
+            Tensor<double> t=pair_function(k,0.5+0.2*n,0.2+0.1*n);
+            tsum+=t;
+            terms.push_back(LowRankTensor<double>(t,TensorArgs(thresh*0.01,TT_2D)));
+        }
+
+        const MTxmqISA isa=batched_linalg_isa();
+        const MTxmqISA isas[2]={MTXMQ_ISA_REFERENCE,batched_linalg_set_isa(MTXMQ_ISA_AVX512)};
+        double used[2], err[2];
+        long rank[2];
+        for (int i=0; i<2; ++i) {
+            batched_linalg_set_isa(isas[i]);
+            used[i]=1e99;
+            for (long loop=0; loop<nloop; ++loop) {
+                std::list<LowRankTensor<double> > addends;
+                for (long n=0; n<nterm; ++n) addends.push_back(copy(terms[n]));
+                const double start=wall_time();
+                LowRankTensor<double> g=reduce(addends,thresh);
+                used[i]=std::min(used[i],wall_time()-start);
+                rank[i]=g.rank();
+                err[i]=(g.full_tensor_copy()-tsum).normf();
+            }
+        }
+        batched_linalg_set_isa(isa);
+
+        std::printf("pair function reduce_rank: %s %.3f ms rank %ld error %.2e; %s %.3f ms rank %ld error %.2e\n",
+                    mTxmq_isa_name(isas[0]), 1e3*used[0], rank[0], err[0],
+                    mTxmq_isa_name(isas[1]), 1e3*used[1], rank[1], err[1]);
+        EXPECT_LT(err[0],thresh);
+        EXPECT_LT(err[1],thresh);
+        EXPECT_LE(std::abs(rank[0]-rank[1]),1);
+    }
+
+    // Rank reduction of the TT_2D coefficients of several nodes, one by one
+    // and together, as FunctionImpl::reduce_rank does ... also reports the timings
+    TEST(LowRankTensorBenchmark, NodeBatchedReduceRank) {
+        const long k=6, nnode=8, nterm=4;
+        const double thresh=1.e-3;
+
+        std::vector<Tensor<double> > tsum(nnode);
+        std::vector<LowRankTensor<double> > nodes(nnode);
+        for (long i=0; i<nnode; ++i) {
+            tsum[i]=Tensor<double>(std::vector<long>(6,k));
+            for (long n=0; n<nterm; ++n) {
+                Tensor<double> t=pair_function(k,0.3+0.1*n+0.01*i,0.01+0.01*n+0.001*i);
+                tsum[i]+=t;
+                LowRankTensor<double> g(t,TensorArgs(thresh,TT_2D));
+                if (n==0) nodes[i]=g;
+                else nodes[i]+=g;
+            }
+        }
+
+        const char* name[2]={"one by one","together"};
+        double used[2], err[2];
+        long rank[2];
+        for (int i=0; i<2; ++i) {
+            std::vector<LowRankTensor<double> > g(nnode);
+            std::vector<LowRankTensor<double>*> ptr(nnode);
+            for (long j=0; j<nnode; ++j) {
+                g[j]=copy(nodes[j]);
+                ptr[j]=&g[j];
+            }
+            const double start=wall_time();
+            if (i==0) for (long j=0; j<nnode; ++j) g[j].reduce_rank(thresh);
+            else LowRankTensor<double>::reduce_rank(ptr,thresh);
+            used[i]=wall_time()-start;
+            rank[i]=0;
+            err[i]=0.0;
+            for (long j=0; j<nnode; ++j) {
+                rank[i]+=g[j].rank();
+                err[i]=std::max(err[i],(g[j].full_tensor_copy()-tsum[j]).normf());
+            }
+        }
+
+        for (int i=0; i<2; ++i)
+            std::printf("node reduce_rank: %-10s %8.3f ms total rank %ld error %.2e\n",
+                        name[i], 1e3*used[i], rank[i], err[i]);
+        EXPECT_LT(err[0],thresh);
+        EXPECT_LT(err[1],thresh);
+        EXPECT_EQ(rank[0],rank[1]);
+    }
+
+
+    // Accumulation of many TT_2D pair functions, each added by add_SVD or by
+    // add_randomized, and the rank reduction of their sum by divide-and-conquer
+    // or by the randomized range finder ... also reports the timings; add_SVD
+    // loses accuracy as the terms pile up, so only its rank is compared
+    TEST(LowRankTensorBenchmark, RandomizedAccumulate) {
+        const long k=6, nterm=12, nloop=3;
+        const double thresh=1.e-4;
+
+        Tensor<double> tsum(std::vector<long>(6,k));
+        std::vector<LowRankTensor<double> > terms;
+        for (long n=0; n<nterm; ++n) {
+            Tensor<double> t=pair_function(k,0.5+0.05*n,0.2+0.02*n);
+            tsum+=t;
+            terms.push_back(LowRankTensor<double>(t,TensorArgs(thresh*0.01,TT_2D)));
+        }
+
+        const char* name[4]={"add_SVD","add_randomized","reduce_rank","reduce_rank_randomized"};
+        double used[4], err[4];
+        long rank[4];
+        for (int i=0; i<4; ++i) {
+            used[i]=1e99;
+            for (long loop=0; loop<nloop; ++loop) {
+                LowRankTensor<double> g=copy(terms[0]);
+                double start=wall_time();
+                if (i<2) {
+                    for (long n=1; n<nterm; ++n) {
+                        if (i==0) g.add_SVD(terms[n],thresh);
+                        else g.add_randomized(terms[n],thresh);
+                    }
+                } else {
+                    for (long n=1; n<nterm; ++n) g+=terms[n];
+                    start=wall_time();
+                    if (i==2) g.reduce_rank(thresh);
+                    else g.reduce_rank_randomized(thresh);
+                }
+                used[i]=std::min(used[i],wall_time()-start);
+                rank[i]=g.rank();
+                err[i]=(g.full_tensor_copy()-tsum).normf();
+            }
+        }
+
+        for (int i=0; i<4; ++i) {
+            std::printf("pair function accumulation: %-24s %9.3f ms rank %ld error %.2e\n",
+                        name[i], 1e3*used[i], rank[i], err[i]);
+            if (i>0) EXPECT_LT(err[i],thresh);
+        }
+        EXPECT_LE(rank[1],rank[0]+1);
+        EXPECT_LE(rank[3],1.05*rank[2]+1);
+    }
+
 }
 
 int main(int argc, char** argv) {
@@ -663,7 +852,7 @@ int main(int argc, char** argv) {
 
 #include <iostream>
 int main() {
-    std::cout << "U need to build with --enable-gentensor to enable the tensor test code\n";
+    std::cout << "U need to build with Google test to enable the tensor test code\n";
     return 0;
 }
 
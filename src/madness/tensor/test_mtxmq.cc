@@ -93,73 +93,111 @@ void crap(double rate, double fastest, double start) {
     if (rate == 0) printf("darn compiler bug %e %e %lf\n",rate,fastest,start);
 }
 
+// Kernels compared by the timers: the reference loops, each SIMD kernel
+// the processor supports, and (if TIME_DGEMM) BLAS
+const int NKERNEL = MTXMQ_ISA_AVX512 + 2;
 
-void timer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c) {
-  double fastest=0.0, fastest_dgemm=0.0;
+bool have_kernel(int kernel) {
+#ifdef TIME_DGEMM
+    if (kernel == NKERNEL-1) return true;
+#endif
+    return kernel < NKERNEL-1 && kernel <= mTxmq_best_isa();
+}
 
-  double nflop = 2.0*ni*nj*nk;
-  long loop;
-  for (int t=0; t<100; t++) {
-    double rate;
-    double start = SafeMPI::Wtime();
-    for (loop=0; loop<100; ++loop) {
-      mTxmq(ni,nj,nk,c,a,b);
-    }
-    start = SafeMPI::Wtime() - start;
-    rate = 1.e-9*nflop/(start/100.0);
-    crap(rate,fastest,start);
-    if (rate > fastest) fastest = rate;
-  }
+void mtxm_kernel(int kernel, long ni, long nj, long nk, double* c, const double* a, const double* b) {
 #ifdef TIME_DGEMM
-  for (int t=0; t<100; t++) {
-    double rate;
-    double start = SafeMPI::Wtime();
-    for (loop=0; loop<100; ++loop) {
-      mTxm_dgemm(ni,nj,nk,c,a,b);
+    if (kernel == NKERNEL-1) {
+        for (long i=0; i<ni*nj; ++i) c[i] = 0.0;
+        mTxm_dgemm(ni,nj,nk,c,a,b);
+        return;
     }
-    start = SafeMPI::Wtime() - start;
-    rate = 1.e-9*nflop/(start/100.0);
-    crap(rate,fastest_dgemm,start);
-    if (rate > fastest_dgemm) fastest_dgemm = rate;
-  }
 #endif
-  printf("%20s %3ld %3ld %3ld %8.2f %8.2f\n",s, ni,nj,nk, fastest, fastest_dgemm);
+    mTxmq(ni,nj,nk,c,a,b);
 }
 
-void trantimer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c) {
-  double fastest=0.0, fastest_dgemm=0.0;
-
-  double nflop = 3.0*2.0*ni*nj*nk;
-  long loop;
-  for (int t=0; t<100; t++) {
-    double rate;
-    double start = SafeMPI::Wtime();
-    for (loop=0; loop<100; ++loop) {
-      mTxmq(ni,nj,nk,c,a,b);
-      mTxmq(ni,nj,nk,a,c,b);
-      mTxmq(ni,nj,nk,c,a,b);
+void print_header() {
+    printf("%20s %3s %3s %3s %8s %8s %8s %8s (GF/s)\n", "type", "M", "N", "K", "REF", "AVX2", "AVX512", "BLAS");
+}
+
+void timer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c, bool tran=false) {
+    double fastest[NKERNEL];
+    const MTxmqISA isa = mTxmq_isa();
+
+    double nflop = (tran ? 3.0 : 1.0)*2.0*ni*nj*nk;
+    long loop;
+    for (int kernel=0; kernel<NKERNEL; ++kernel) {
+        fastest[kernel] = 0.0;
+        if (!have_kernel(kernel)) continue;
+        if (kernel < NKERNEL-1) mTxmq_set_isa(MTxmqISA(kernel));
+        for (int t=0; t<20; t++) {
+            double rate;
+            double start = SafeMPI::Wtime();
+            for (loop=0; loop<100; ++loop) {
+                mtxm_kernel(kernel,ni,nj,nk,c,a,b);
+                if (tran) {
+                    mtxm_kernel(kernel,ni,nj,nk,a,c,b);
+                    mtxm_kernel(kernel,ni,nj,nk,c,a,b);
+                }
+            }
+            start = SafeMPI::Wtime() - start;
+            rate = 1.e-9*nflop/(start/100.0);
+            crap(rate,fastest[kernel],start);
+            if (rate > fastest[kernel]) fastest[kernel] = rate;
+        }
     }
-    start = SafeMPI::Wtime() - start;
-    rate = 1.e-9*nflop/(start/100.0);
-    crap(rate,fastest,start);
-    if (rate > fastest) fastest = rate;
-  }
-#ifdef TIME_DGEMM
-  for (int t=0; t<100; t++) {
-    double rate;
-    double start = SafeMPI::Wtime();
-    for (loop=0; loop<100; ++loop) {
-      mTxm_dgemm(ni,nj,nk,c,a,b);
-      mTxm_dgemm(ni,nj,nk,a,c,b);
-      mTxm_dgemm(ni,nj,nk,c,a,b);
+    mTxmq_set_isa(isa);
+    printf("%20s %3ld %3ld %3ld %8.2f %8.2f %8.2f %8.2f\n",s, ni,nj,nk,
+           fastest[0], fastest[1], fastest[2], fastest[3]);
+}
+
+void trantimer(const char* s, long ni, long nj, long nk, double *a, double *b, double *c) {
+    timer(s, ni, nj, nk, a, b, c, true);
+}
+
+void ran_value(double& x) {
+    x = ran() - 0.5;
+}
+
+void ran_value(float& x) {
+    x = ran() - 0.5;
+}
+
+void ran_value(double_complex& x) {
+    x = double_complex(ran() - 0.5, ran() - 0.5);
+}
+
+/// Compares mTxmq with the selected kernel against mTxmq_reference for one type combination
+template <typename aT, typename bT, typename cT>
+bool test_types(const char* name, long nimax, long njmax, long nkmax, long step) {
+    const long ldbmax = njmax+3;
+    std::vector<aT> a(nimax*nkmax);
+    std::vector<bT> b(nkmax*ldbmax);
+    std::vector<cT> c(nimax*njmax), d(nimax*njmax);
+    for (size_t i=0; i<a.size(); ++i) ran_value(a[i]);
+    for (size_t i=0; i<b.size(); ++i) ran_value(b[i]);
+    const double tol = std::is_same<cT,float>::value ? 1e-5 : 1e-12;
+
+    for (long ni=1; ni<nimax; ni+=step) {
+        for (long nj=1; nj<njmax; ++nj) {
+            for (long nk=1; nk<nkmax; nk+=step) {
+                for (long ldb=nj; ldb<=nj+3; ldb+=3) {
+                    for (long i=0; i<ni*nj; ++i) d[i] = c[i] = cT(1e10);
+                    mTxmq_reference(ni,nj,nk,&c[0],&a[0],&b[0],ldb);
+                    if (ldb == nj) mTxmq(ni,nj,nk,&d[0],&a[0],&b[0]);
+                    else mTxmq_padding(ni,nj,nk,ldb,&d[0],&a[0],&b[0]);
+                    for (long i=0; i<ni*nj; ++i) {
+                        double err = std::abs(d[i]-c[i]);
+                        if (err > tol) {
+                            printf("test_mtxmq: %s %s error %ld %ld %ld %ld %e\n",
+                                   mTxmq_isa_name(mTxmq_isa()), name, ni, nj, nk, ldb, err);
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
     }
-    start = SafeMPI::Wtime() - start;
-    rate = 1.e-9*nflop/(start/100.0);
-    crap(rate,fastest_dgemm,start);
-    if (rate > fastest_dgemm) fastest_dgemm = rate;
-  }
-#endif
-  printf("%20s %3ld %3ld %3ld %8.2f %8.2f\n",s, ni,nj,nk, fastest, fastest_dgemm);
+    return true;
 }
 
 int main(int argc, char * argv[]) {
@@ -217,12 +255,31 @@ int main(int argc, char * argv[]) {
     }
     printf("... OK!\n");
 
-    printf("%20s %3s %3s %3s %8s %8s (GF/s)\n", "type", "M", "N", "K", "LOOP", "BLAS");
+    // Every kernel the processor supports for all type combinations,
+    // including b with more columns than c (mTxmq_padding)
+    const MTxmqISA best = mTxmq_best_isa();
+    for (int isa=MTXMQ_ISA_REFERENCE; isa<=best; ++isa) {
+        mTxmq_set_isa(MTxmqISA(isa));
+        printf("Testing %s kernels ... \n", mTxmq_isa_name(mTxmq_isa()));
+        if (!test_types<double,double,double>("real*real", 30, 50, 30, 3) ||
+            !test_types<double_complex,double_complex,double_complex>("complex*complex", 30, 50, 30, 3) ||
+            !test_types<double,double_complex,double_complex>("real*complex", 30, 50, 30, 3) ||
+            !test_types<double_complex,double,double_complex>("complex*real", 30, 50, 30, 3) ||
+            !test_types<float,float,float>("float*float", 30, 70, 30, 3)) exit(1);
+    }
+    mTxmq_set_isa(best);
+    printf("... OK!\n");
+
+    print_header();
     for (ni=2; ni<60; ni+=2) timer("(m*m)T*(m*m)", ni,ni,ni,a,b,c);
     for (m=2; m<=30; m+=2) timer("(m*m,m)T*(m*m)", m*m,m,m,a,b,c);
     for (m=2; m<=30; m+=2) trantimer("tran(m,m,m)", m*m,m,m,a,b,c);
     for (m=2; m<=20; m+=2) timer("(20*20,20)T*(20,m)", 20*20,m,20,a,b,c);
 
+    // The shapes of the transforms with wavelet order k and 2k in 3D
+    for (m=6; m<=20; ++m) timer("(k*k,k)T*(k,k)", m*m,m,m,a,b,c);
+    for (m=6; m<=20; ++m) timer("(4k*k,2k)T*(2k,2k)", 4*m*m,2*m,2*m,a,b,c);
+
     SafeMPI::Finalize();
 
     return 0;
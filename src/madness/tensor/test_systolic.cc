@@ -2,6 +2,8 @@
 #include <utility>
 #include <madness/tensor/tensor.h>
 #include <madness/tensor/systolic.h>
+#include <random>
+#include <cstdlib>
 
 using namespace madness;
 
@@ -46,6 +48,308 @@ public:
 };
 
 
+template <typename T>
+class TestSystolicBlockMatrixAlgorithm : public SystolicBlockMatrixAlgorithm<T> {
+    volatile int niter;
+    Tensor<long>& seen;
+public:
+    TestSystolicBlockMatrixAlgorithm(DistributedMatrix<T>& A, int tag, int64_t blocksize, Tensor<long>& seen)
+        : SystolicBlockMatrixAlgorithm<T>(A, tag, blocksize, 1)
+        , niter(0)
+        , seen(seen)
+    {
+        madness::print("Testing SystolicBlockMatrixAlgorithm ",
+                       SystolicBlockMatrixAlgorithm<T>::get_coldim(),
+                       SystolicBlockMatrixAlgorithm<T>::get_rowdim(), blocksize);
+    }
+
+    void block_kernel(int64_t ilo, int64_t ni, int64_t jlo, int64_t nj, T* rowi, T* rowj) {
+        const int64_t m = SystolicBlockMatrixAlgorithm<T>::get_rowdim();
+        for (int64_t i=0; i<ni; ++i)
+            for (int64_t k=0; k<m; ++k) MADNESS_ASSERT(rowi[i*m+k] == ilo+i);
+        for (int64_t j=0; j<nj; ++j)
+            for (int64_t k=0; k<m; ++k) MADNESS_ASSERT(rowj[j*m+k] == jlo+j);
+        std::vector<int64_t> rows;
+        for (int64_t i=0; i<ni; ++i) rows.push_back(ilo+i);
+        for (int64_t j=0; j<nj; ++j) rows.push_back(jlo+j);
+        for (int64_t a : rows)
+            for (int64_t b : rows) seen(a,b) += 1;
+    }
+
+    void start_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) ++niter;
+    }
+
+    bool converged(const TaskThreadEnv& env) const {
+        return niter >= 2;
+    }
+};
+
+
+/// Returns the angle of the 2x2 rotation of orbitals i and j that maximizes the Boys functional
+
+/// The Boys localizations below act on rows [u, X u, Y u, Z u] where
+/// X, Y and Z are the position matrices, so that x_ij = u_i.(X u_j)
+/// and rotating rows keeps the last three parts the images of the first.
+template <typename T>
+T boys_angle(const T xii[3], const T xjj[3], const T xij[3]) {
+    T dd = 0, aa = 0, ad = 0;
+    for (int c=0; c<3; ++c) {
+        const T d = (xii[c] - xjj[c])/2;
+        dd += d*d;
+        aa += xij[c]*xij[c];
+        ad += xij[c]*d;
+    }
+    return std::atan2(2*ad, dd-aa)/4;
+}
+
+template <typename T>
+class SystolicBoysLocalize : public SystolicMatrixAlgorithm<T> {
+    const int64_t n;
+    const T thresh;
+    int nsweep;
+    AtomicInt nrot;
+public:
+    SystolicBoysLocalize(DistributedMatrix<T>& A, T thresh)
+        : SystolicMatrixAlgorithm<T>(A, A.get_world().mpi.unique_tag())
+        , n(A.coldim())
+        , thresh(thresh)
+        , nsweep(0)
+    {
+        nrot = 0;
+    }
+
+    int sweeps() const {return nsweep;}
+
+    void start_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) nrot = 0;
+    }
+
+    void end_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) {
+            int nr = nrot;
+            SystolicMatrixAlgorithm<T>::get_world().gop.sum(nr);
+            nrot = nr;
+            ++nsweep;
+        }
+    }
+
+    bool converged(const TaskThreadEnv& env) const {
+        return nrot == 0 || nsweep >= 200;
+    }
+
+    void kernel(int i, int j, T * restrict rowi, T * restrict rowj) {
+        T xii[3] = {0,0,0}, xjj[3] = {0,0,0}, xij[3] = {0,0,0};
+        for (int c=0; c<3; ++c) {
+            const T * restrict wi = rowi + (c+1)*n;
+            const T * restrict wj = rowj + (c+1)*n;
+            for (int64_t k=0; k<n; ++k) {
+                xii[c] += rowi[k]*wi[k];
+                xjj[c] += rowj[k]*wj[k];
+                xij[c] += rowi[k]*wj[k];
+            }
+        }
+        const T theta = boys_angle(xii, xjj, xij);
+        if (std::abs(theta) <= thresh) return;
+        nrot++;
+
+        const T c = std::cos(theta), s = std::sin(theta);
+        for (int64_t k=0; k<4*n; ++k) {
+            const T x = rowi[k], y = rowj[k];
+            rowi[k] = c*x + s*y;
+            rowj[k] = c*y - s*x;
+        }
+    }
+};
+
+template <typename T>
+class SystolicBlockBoysLocalize : public SystolicBlockMatrixAlgorithm<T> {
+    const int64_t n;
+    const T thresh;
+    int nsweep;
+    AtomicInt nrot;
+public:
+    SystolicBlockBoysLocalize(DistributedMatrix<T>& A, T thresh, int64_t blocksize)
+        : SystolicBlockMatrixAlgorithm<T>(A, A.get_world().mpi.unique_tag(), blocksize)
+        , n(A.coldim())
+        , thresh(thresh)
+        , nsweep(0)
+    {
+        nrot = 0;
+    }
+
+    int sweeps() const {return nsweep;}
+
+    void start_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) nrot = 0;
+    }
+
+    void end_iteration_hook(const TaskThreadEnv& env) {
+        if (env.id() == 0) {
+            int nr = nrot;
+            SystolicBlockMatrixAlgorithm<T>::get_world().gop.sum(nr);
+            nrot = nr;
+            ++nsweep;
+        }
+    }
+
+    bool converged(const TaskThreadEnv& env) const {
+        return nrot == 0 || nsweep >= 200;
+    }
+
+    /// Localizes the orbitals of both blocks among themselves with one cyclic sweep on their position matrices
+    void block_kernel(int64_t ilo, int64_t ni, int64_t jlo, int64_t nj, T* rowi, T* rowj) {
+        const int64_t m = ni + nj;
+        Tensor<T> w(std::vector<long>{m, 4*n}, false);
+        std::memcpy(w.ptr(), rowi, ni*4*n*sizeof(T));
+        std::memcpy(w.ptr()+ni*4*n, rowj, nj*4*n*sizeof(T));
+
+        // x(k,l,c) = u_k.w^c_l with the components innermost so that rotating a row or a column touches consecutive elements
+        const Tensor<T> u = copy(w(_,Slice(0,n-1)));
+        Tensor<T> x(m, m, 3);
+        for (int c=0; c<3; ++c) x(_,_,c) = inner(u, copy(w(_,Slice((c+1)*n,(c+2)*n-1))), 1, 1);
+        Tensor<T> q(m, m);
+        for (int64_t i=0; i<m; ++i) q(i,i) = 1;
+
+        T * restrict px = x.ptr();
+        T * restrict pq = q.ptr();
+        bool rotated = false;
+        for (int64_t i=0; i<m; ++i) {
+            for (int64_t j=i+1; j<m; ++j) {
+                const T theta = boys_angle(px+(i*m+i)*3, px+(j*m+j)*3, px+(i*m+j)*3);
+                if (std::abs(theta) <= 0.01*thresh) continue;
+                if (std::abs(theta) > thresh) rotated = true;
+
+                const T cs = std::cos(theta), sn = std::sin(theta);
+                T * restrict xi = px + i*m*3;
+                T * restrict xj = px + j*m*3;
+                for (int64_t k=0; k<3*m; ++k) {
+                    const T a = xi[k], b = xj[k];
+                    xi[k] = cs*a + sn*b;
+                    xj[k] = cs*b - sn*a;
+                }
+                for (int64_t k=0; k<m; ++k) {
+                    T * restrict yi = px + (k*m+i)*3;
+                    T * restrict yj = px + (k*m+j)*3;
+                    for (int c=0; c<3; ++c) {
+                        const T a = yi[c], b = yj[c];
+                        yi[c] = cs*a + sn*b;
+                        yj[c] = cs*b - sn*a;
+                    }
+                }
+                T * restrict qi = pq + i*m;
+                T * restrict qj = pq + j*m;
+                for (int64_t k=0; k<m; ++k) {
+                    const T a = qi[k], b = qj[k];
+                    qi[k] = cs*a + sn*b;
+                    qj[k] = cs*b - sn*a;
+                }
+            }
+        }
+        if (!rotated) return;
+        nrot++;
+
+        w = inner(q, w);
+        std::memcpy(rowi, w.ptr(), ni*4*n*sizeof(T));
+        std::memcpy(rowj, w.ptr()+ni*4*n, nj*4*n*sizeof(T));
+    }
+};
+
+
+/// Makes n orbitals at random positions mixed by a random rotation
+
+/// Returns the rows [u, X u, Y u, Z u] with u the unit vectors and the
+/// (column distributed) maximum of the Boys functional, which is the
+/// sum of the squared positions.
+DistributedMatrix<double> boys_problem(World& world, int64_t n, double& fmax) {
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    const double box = std::cbrt(double(n));
+
+    Tensor<double> r(n,3);
+    for (int64_t k=0; k<n; ++k)
+        for (int c=0; c<3; ++c) r(k,c) = box*dist(gen);
+    fmax = r.trace(r);
+
+    // Modified Gram-Schmidt on a random matrix
+    Tensor<double> o(n,n);
+    for (int64_t i=0; i<n; ++i)
+        for (int64_t k=0; k<n; ++k) o(i,k) = dist(gen);
+    for (int64_t i=0; i<n; ++i) {
+        Tensor<double> oi = o(i,_);
+        for (int64_t j=0; j<i; ++j) {
+            Tensor<double> oj = o(j,_);
+            oi.gaxpy(1.0, oj, -oi.trace(oj));
+        }
+        oi.scale(1.0/oi.normf());
+    }
+
+    DistributedMatrix<double> A = column_distributed_matrix<double>(world, n, 4*n);
+    int64_t ilo, ihi;
+    A.local_colrange(ilo, ihi);
+    for (int c=0; c<3; ++c) {
+        Tensor<double> ox = copy(o);
+        for (int64_t k=0; k<n; ++k) ox(_,k).scale(r(k,c));
+        const Tensor<double> x = inner(ox, o, 1, 1);
+        for (int64_t i=ilo; i<=ihi; ++i) A.data()(i-ilo,Slice((c+1)*n,(c+2)*n-1)) = x(i,_);
+    }
+    for (int64_t i=ilo; i<=ihi; ++i) A.data()(i-ilo,i) = 1.0;
+    return A;
+}
+
+
+/// Returns the sum of the squared diagonal elements of the position matrices
+double boys_functional(World& world, const DistributedMatrix<double>& A) {
+    const int64_t n = A.coldim();
+    int64_t ilo, ihi;
+    A.local_colrange(ilo, ihi);
+    double f = 0.0;
+    for (int64_t i=ilo; i<=ihi; ++i) {
+        const Tensor<double> row = A.data()(i-ilo,_);
+        for (int c=0; c<3; ++c) {
+            const double xii = row(Slice(0,n-1)).trace(row(Slice((c+1)*n,(c+2)*n-1)));
+            f += xii*xii;
+        }
+    }
+    world.gop.sum(f);
+    return f;
+}
+
+
+/// Localizes the same orbitals with the pairwise and the block systolic loops
+
+/// Returns true if both recover the localized orbitals
+bool test_boys(World& world, int64_t n, int64_t blocksize) {
+    double fmax;
+    DistributedMatrix<double> A = boys_problem(world, n, fmax);
+    DistributedMatrix<double> B = copy(A);
+    const double f0 = boys_functional(world, A);
+
+    world.gop.fence();
+    double start = wall_time();
+    SystolicBoysLocalize<double>* scalar = new SystolicBoysLocalize<double>(A, 1e-8);
+    world.taskq.add(scalar);
+    world.taskq.fence();
+    const int scalar_sweeps = scalar->sweeps();
+    const double scalar_time = wall_time() - start;
+
+    start = wall_time();
+    SystolicBlockBoysLocalize<double>* block = new SystolicBlockBoysLocalize<double>(B, 1e-8, blocksize);
+    world.taskq.add(block);
+    world.taskq.fence();
+    const int block_sweeps = block->sweeps();
+    const double block_time = wall_time() - start;
+
+    // Fraction of the spread not removed
+    const double fa = (fmax - boys_functional(world, A))/(fmax - f0);
+    const double fb = (fmax - boys_functional(world, B))/(fmax - f0);
+    if (world.rank() == 0)
+        printf("boys n=%ld nproc=%d  pairs %d sweeps %.3f s (spread %.1e)  blocks of %ld %d sweeps %.3f s (spread %.1e)\n",
+               long(n), world.size(), scalar_sweeps, scalar_time, fa, long(blocksize), block_sweeps, block_time, fb);
+    return fa < 1e-6 && fb < 1e-6;
+}
+
+
 int main(int argc, char** argv) {
     initialize(argc, argv);
     World world(SafeMPI::COMM_WORLD);
@@ -68,6 +372,39 @@ int main(int argc, char** argv) {
                 }
             }
         }
+
+        for (int64_t n=1; n<60; ++n) {
+            int64_t m = 3;
+            int64_t blocksize = 1 + n%7;
+            DistributedMatrix<double> A = column_distributed_matrix<double>(world, n, m, (n%4==0) ? 2 : 0);
+            int64_t ilo, ihi;
+            A.local_colrange(ilo, ihi);
+            for (int i=ilo; i<=ihi; ++i) A.data()(i-ilo,_) = i;
+
+            // Every pair of rows must meet in each sweep
+            Tensor<long> seen(n,n);
+            world.taskq.add(new TestSystolicBlockMatrixAlgorithm<double>(A, 3334, blocksize, seen));
+            world.taskq.fence();
+            world.gop.sum(seen.ptr(), n*n);
+
+            for (int i=ilo; i<=ihi; ++i) {
+                for (int k=0; k<m; ++k) {
+                    MADNESS_ASSERT(A.data()(i-ilo,k) == i);
+                }
+            }
+            for (int i=0; i<n; ++i) {
+                for (int j=0; j<n; ++j) {
+                    MADNESS_ASSERT(seen(i,j) >= 2);
+                }
+            }
+        }
+
+        if (argc == 1) {
+            MADNESS_ASSERT(test_boys(world, 60, 8));
+        }
+        else {
+            for (int arg=1; arg<argc; ++arg) test_boys(world, std::atol(argv[arg]), 16);
+        }
     }
     catch (const SafeMPI::Exception& e) {
         print(e);
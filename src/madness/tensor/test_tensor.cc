@@ -33,7 +33,9 @@
 /// \brief New test code for Tensor class using Google unit test
 
 #include <madness/tensor/tensor.h>
+#include <madness/tensor/vmath.h>
 #include <madness/world/print.h>
+#include <madness/world/timers.h>
 
 #ifdef MADNESS_HAS_GOOGLE_TEST
 
@@ -415,6 +417,474 @@ namespace {
         ITERATOR3(b,ASSERT_EQ(b(_i,_j,_k), a(_j,_i,_k)));
     }
 
+    TYPED_TEST(TensorTest, SharedData) {
+        // Sizes straddle the small-block cache threshold used with intrusive refcounting
+        for (long k=1; k<=20; k+=3) {
+            madness::Tensor<TypeParam> a(k,k,k);
+            a.fillindex();
+            {
+                madness::Tensor<TypeParam> b(a);
+                madness::Tensor<TypeParam> c;
+                c = b;
+                ASSERT_EQ(b.ptr(),a.ptr());
+                ASSERT_EQ(c.ptr(),a.ptr());
+                c(0,0,0) = TypeParam(99);
+                ASSERT_EQ(a(0,0,0),TypeParam(99));
+            }
+
+            // Destroying the copies must not release the data still viewed by a
+            madness::Tensor<TypeParam> d(k,k,k);
+            ASSERT_NE(d.ptr(),a.ptr());
+            ASSERT_EQ(((unsigned long)(d.ptr())) % TENSOR_ALIGNMENT, 0ul);
+            ASSERT_EQ(a(0,0,0),TypeParam(99));
+            if (k > 1) ASSERT_EQ(a(0,0,1),TypeParam(1));
+
+            // Views keep the data alive after the original is reassigned
+            madness::Tensor<TypeParam> e = a(_,_,_);
+            a = madness::Tensor<TypeParam>();
+            ASSERT_EQ(e(0,0,0),TypeParam(99));
+            ITERATOR3(e, if (_i || _j || _k) ASSERT_EQ(e(_i,_j,_k),TypeParam((_i*k+_j)*k+_k)));
+        }
+    }
+
+    TEST(TensorTransformTest, FastTransformBatch) {
+        // Batches not a multiple of the chunk, rectangular and mixed real/complex matrices
+        for (long ndim=1; ndim<=4; ++ndim) {
+            for (long k=2; k<=10; k+=4) {
+                for (long kout=k; kout<=k+3; kout+=3) {
+                    std::vector<long> dims(ndim, k);
+                    std::vector< madness::Tensor<double> > t(37);
+                    for (std::size_t n=0; n<t.size(); ++n) {
+                        t[n] = madness::Tensor<double>(dims);
+                        t[n].fillrandom();
+                    }
+                    madness::Tensor<double> c(k, kout);
+                    c.fillrandom();
+                    madness::Tensor<double_complex> z(k, kout);
+                    z.fillrandom();
+
+                    std::vector< madness::Tensor<double> > r = madness::fast_transform_batch(t, c, 8);
+                    std::vector< madness::Tensor<double_complex> > rz = madness::fast_transform_batch(t, z, 8);
+                    ASSERT_EQ(r.size(), t.size());
+                    for (std::size_t n=0; n<t.size(); ++n) {
+                        madness::Tensor<double> s = madness::transform(t[n], c);
+                        ASSERT_TRUE(r[n].conforms(s));
+                        ASSERT_LT((r[n] - s).normf(), 1e-12*s.normf());
+                        madness::Tensor<double_complex> sz = madness::transform(t[n], z);
+                        ASSERT_LT((rz[n] - sz).normf(), 1e-12*sz.normf());
+                    }
+                }
+            }
+        }
+
+        // Unshared results of the right shape are reused, shared or misshapen ones replaced
+        {
+            const long k = 4;
+            std::vector< madness::Tensor<double> > t(3);
+            for (std::size_t n=0; n<t.size(); ++n) {
+                t[n] = madness::Tensor<double>(k, k);
+                t[n].fillrandom();
+            }
+            madness::Tensor<double> c(k, k);
+            c.fillrandom();
+            std::vector< madness::Tensor<double> > r(3);
+            r[0] = madness::Tensor<double>(k, k);
+            r[1] = madness::Tensor<double>(k, k);
+            r[2] = madness::Tensor<double>(1, k*k);
+            const madness::Tensor<double> keep = r[1];
+            const double* p0 = r[0].ptr();
+            madness::fast_transform_batch(t, c, r);
+            EXPECT_EQ(r[0].ptr(), p0);
+            EXPECT_NE(r[1].ptr(), keep.ptr());
+            EXPECT_EQ(keep.normf(), 0.0);
+            EXPECT_EQ(r[2].dim(0), k);
+            for (std::size_t n=0; n<t.size(); ++n)
+                EXPECT_LT((r[n] - madness::transform(t[n], c)).normf(), 1e-12*r[n].normf());
+        }
+
+        // Not a pass/fail test ... reports the gain over one transform per tensor
+        std::printf("%6s %6s %14s %14s %14s %14s\n", "k", "batch", "transform/us", "fast/us", "batched/us", "inplace/us");
+        for (long k=4; k<=20; k+=2) {
+            const long nt = 64, nloop = 10;
+            std::vector< madness::Tensor<double> > t(nt);
+            for (long n=0; n<nt; ++n) {
+                t[n] = madness::Tensor<double>(k,k,k);
+                t[n].fillrandom();
+            }
+            madness::Tensor<double> c(k,k), r(k,k,k), w(k,k,k);
+            c.fillrandom();
+
+            double used = 1e99, fused = 1e99, bused = 1e99, iused = 1e99;
+            std::vector< madness::Tensor<double> > ri;
+            for (long loop=0; loop<nloop; ++loop) {
+                double start = madness::wall_time();
+                for (long n=0; n<nt; ++n) r = madness::transform(t[n], c);
+                used = std::min(used, madness::wall_time() - start);
+
+                r = madness::Tensor<double>(k,k,k);
+                start = madness::wall_time();
+                for (long n=0; n<nt; ++n) madness::fast_transform(t[n], c, r, w);
+                fused = std::min(fused, madness::wall_time() - start);
+
+                start = madness::wall_time();
+                std::vector< madness::Tensor<double> > rb = madness::fast_transform_batch(t, c);
+                bused = std::min(bused, madness::wall_time() - start);
+
+                start = madness::wall_time();
+                madness::fast_transform_batch(t, c, ri);
+                iused = std::min(iused, madness::wall_time() - start);
+            }
+
+            std::printf("%6ld %6ld %14.2f %14.2f %14.2f %14.2f\n", k, nt,
+                        1e6*used/nt, 1e6*fused/nt, 1e6*bused/nt, 1e6*iused/nt);
+        }
+    }
+
+    TEST(TensorExprTest, FusedArithmetic) {
+        using madness::lazy;
+        for (long k=1; k<=12; k+=11) {
+            madness::Tensor<double> b(k,k,k), c(k,k,k), d(k,k,k), e(k,k,k);
+            b.fillrandom(); c.fillrandom(); d.fillrandom(); e.fillrandom();
+            madness::Tensor<double_complex> z(k,k,k);
+            z.fillrandom();
+            const double tol = 1e-14;
+
+            // Against the same expression made with temporaries
+            madness::Tensor<double> a = lazy(b)*2.0 + c - madness::emul(d,e);
+            madness::Tensor<double> ref = b*2.0 + c - copy(d).emul(e);
+            ASSERT_LT((a - ref).normf(), tol);
+
+            a = 3.0 - lazy(b)/2.0 + (-lazy(c)) - 1;
+            ref = (-(b*0.5)) + 3.0 - c - 1.0;
+            ASSERT_LT((a - ref).normf(), tol);
+
+            madness::Tensor<double_complex> az = lazy(z)*double_complex(0.0,1.0) + b;
+            madness::Tensor<double_complex> refz = z*double_complex(0.0,1.0) + b;
+            ASSERT_LT((az - refz).normf(), tol);
+
+            // Assignment binds to a new tensor like the other operators
+            madness::Tensor<double> alias = a;
+            a = lazy(b) + c;
+            ASSERT_NE(alias.ptr(), a.ptr());
+
+            // In place updates, including the target as a leaf
+            a = copy(b);
+            alias = a;
+            a += 0.5*madness::emul(lazy(c),d);
+            ref = b + c.emul(d)*0.5;
+            ASSERT_EQ(alias.ptr(), a.ptr());
+            ASSERT_LT((a - ref).normf(), tol);
+
+            a -= lazy(a)*0.5 + e;
+            ref -= ref*0.5 + e;
+            ASSERT_LT((a - ref).normf(), tol);
+
+            a.gaxpy(0.9, lazy(b) - c, 0.1);
+            ref.gaxpy(0.9, b - c, 0.1);
+            ASSERT_LT((a - ref).normf(), tol);
+
+            a.emul(lazy(d) + 1.0);
+            ref.emul(d + 1.0);
+            ASSERT_LT((a - ref).normf(), tol);
+
+            // Non-contiguous leaves and targets
+            if (k > 1) {
+                madness::Tensor<double> bt = b.swapdim(0,2), ct = c.swapdim(1,2);
+                a = lazy(bt)*2.0 - ct;
+                ref = copy(bt)*2.0 - copy(ct);
+                ASSERT_LT((a - ref).normf(), tol);
+
+                madness::Tensor<double> f = copy(d);
+                madness::Tensor<double> ft = f.swapdim(0,1);
+                ft += lazy(bt) + c;
+                ref = d.swapdim(0,1) + bt + c;
+                ASSERT_LT((ft - ref).normf(), tol);
+
+                madness::Tensor<double> g = copy(e);
+                madness::Tensor<double> gs = g(madness::Slice(0,k-1,2),_,_);
+                gs.gaxpy(2.0, lazy(gs)*2.0, -1.0);
+                ASSERT_LT(gs.normf(), tol);
+            }
+        }
+    }
+
+    TEST(TensorExprTest, FusedArithmeticTiming) {
+        using madness::lazy;
+        // Not a pass/fail test ... reports fused expressions against the operators making temporaries
+        std::printf("%8s %8s %14s %14s\n", "n", "length", "operators/us", "fused/us");
+        for (long k=8; k<=64; k*=2) {
+            const long n = k*k*k, nloop = std::max(4l, 2000000/n);
+            madness::Tensor<double> a(k,k,k), b(k,k,k), c(k,k,k), d(k,k,k), e(k,k,k);
+            b.fillrandom(); c.fillrandom(); d.fillrandom(); e.fillrandom();
+
+            for (int length=2; length<=5; ++length) {
+                if (length == 4) continue;
+                double used = 1e99, fused = 1e99;
+                for (int t=0; t<5; ++t) {
+                    double start = madness::wall_time();
+                    for (long loop=0; loop<nloop; ++loop) {
+                        if (length == 2) a = b*2.0 + c;
+                        else if (length == 3) a = b*2.0 + c - d;
+                        else a = b*2.0 + c - copy(d).emul(e) + e*0.5;
+                    }
+                    used = std::min(used, madness::wall_time() - start);
+
+                    start = madness::wall_time();
+                    for (long loop=0; loop<nloop; ++loop) {
+                        if (length == 2) a = lazy(b)*2.0 + c;
+                        else if (length == 3) a = lazy(b)*2.0 + c - d;
+                        else a = lazy(b)*2.0 + c - madness::emul(d,e) + e*0.5;
+                    }
+                    fused = std::min(fused, madness::wall_time() - start);
+                }
+                std::printf("%8ld %8d %14.2f %14.2f\n", n, length, 1e6*used/nloop, 1e6*fused/nloop);
+            }
+        }
+    }
+
+    /// Error of v in units in the last place of the reference value
+    double vmath_ulps(double ref, double v) {
+        if (ref == v || (std::isnan(ref) && std::isnan(v))) return 0.0;
+        double u = std::nextafter(std::abs(ref), HUGE_VAL) - std::abs(ref);
+        return std::abs(ref - v)/u;
+    }
+
+    /// Max. error in ulp of a vector math function over random arguments in [lo,hi] (or [e^lo,e^hi])
+    template <typename refT, typename vecT>
+    double vmath_error(refT f, vecT vf, double lo, double hi, bool logscale=false) {
+        // Odd length to exercise the partial vector at the end
+        const long n = 20011;
+        std::vector<double> x(n), y(n);
+        madness::Random r(7);
+        for (long i=0; i<n; ++i) {
+            x[i] = lo + (hi-lo)*r.get();
+            if (logscale) x[i] = std::exp(x[i]);
+        }
+        vf(n, &x[0], &y[0]);
+        double err = 0.0;
+        for (long i=0; i<n; ++i) err = std::max(err, vmath_ulps(f(x[i]), y[i]));
+        return err;
+    }
+
+    double ref_pow3(double x) {return std::pow(x, 3.7);}
+    double ref_pow40(double x) {return std::pow(x, -40.0);}
+    void vpow3(long n, const double* x, double* y) {madness::vpow(n, x, 3.7, y);}
+    void vpow40(long n, const double* x, double* y) {madness::vpow(n, x, -40.0, y);}
+
+    TEST(VMathTest, Accuracy) {
+        typedef double (*fT)(double);
+        typedef void (*vfT)(long, const double*, double*);
+        struct {
+            const char* name; fT f; vfT vf; double lo, hi; bool logscale; double tol;
+        } cases[] = {
+            {"exp", fT(std::exp), madness::vexp, -750.0, 750.0, false, 1.0},
+            {"exp", fT(std::exp), madness::vexp, -1.0, 1.0, false, 1.0},
+            {"log", fT(std::log), madness::vlog, -720.0, 710.0, true, 1.0},
+            {"log", fT(std::log), madness::vlog, -0.7, 0.7, true, 1.0},
+            {"log", fT(std::log), madness::vlog, -1.0, 1.0, false, 1.0},
+            {"sqrt", fT(std::sqrt), madness::vsqrt, -1.0, 100.0, false, 0.0},
+            {"erf", fT(std::erf), madness::verf, -7.0, 7.0, false, 2.0},
+            {"erf", fT(std::erf), madness::verf, -1e-3, 1e-3, false, 2.0},
+            {"sin", fT(std::sin), madness::vsin, -10.0, 10.0, false, 2.0},
+            {"sin", fT(std::sin), madness::vsin, -2e5, 2e5, false, 2.0},
+            {"cos", fT(std::cos), madness::vcos, -10.0, 10.0, false, 2.0},
+            {"cos", fT(std::cos), madness::vcos, -2e5, 2e5, false, 2.0},
+            {"pow3.7", ref_pow3, vpow3, -20.0, 20.0, true, 2.0},
+            {"pow-40", ref_pow40, vpow40, -5.0, 5.0, true, 6.0},
+        };
+
+        const madness::MTxmqISA isa = madness::vmath_isa();
+        for (int i=madness::MTXMQ_ISA_REFERENCE; i<=madness::mTxmq_best_isa(); ++i) {
+            madness::vmath_set_isa(madness::MTxmqISA(i));
+            for (std::size_t c=0; c<sizeof(cases)/sizeof(cases[0]); ++c) {
+                double err = vmath_error(cases[c].f, cases[c].vf, cases[c].lo, cases[c].hi, cases[c].logscale);
+                std::printf("%8s %8s [%8.1e,%8.1e] %6.2f ulp\n", madness::mTxmq_isa_name(madness::vmath_isa()),
+                            cases[c].name, cases[c].lo, cases[c].hi, err);
+                ASSERT_LE(err, cases[c].tol);
+            }
+
+            // Special values come from libm
+            const double inf = HUGE_VAL, nan = std::numeric_limits<double>::quiet_NaN();
+            const double x[] = {0.0, -0.0, inf, -inf, nan, -1.0, 1e-310, 1e300, 710.0, -746.0};
+            const long n = sizeof(x)/sizeof(x[0]);
+            double y[n];
+            madness::vexp(n, x, y);
+            for (long j=0; j<n; ++j) ASSERT_EQ(vmath_ulps(std::exp(x[j]), y[j]), 0.0);
+            madness::vlog(n, x, y);
+            for (long j=0; j<n; ++j) ASSERT_EQ(vmath_ulps(std::log(x[j]), y[j]), 0.0);
+            madness::verf(n, x, y);
+            for (long j=0; j<n; ++j) ASSERT_LE(vmath_ulps(std::erf(x[j]), y[j]), 2.0);
+            madness::vsin(n, x, y);
+            for (long j=0; j<n; ++j) ASSERT_LE(vmath_ulps(std::sin(x[j]), y[j]), 2.0);
+
+            // In place on tensors, contiguous or not
+            madness::Tensor<double> t(7,9), u;
+            t.fillrandom();
+            u = copy(t);
+            madness::vsincos(t.size(), t.ptr(), t.ptr(), u.ptr());
+            madness::Tensor<double> s = copy(u);
+            ITERATOR2(t, ASSERT_LE(std::abs(t(_i,_j)*t(_i,_j) + u(_i,_j)*u(_i,_j) - 1.0), 1e-15));
+            madness::Tensor<double> v = s.swapdim(0,1);
+            madness::vexp(v);
+            madness::vlog(v);
+            ASSERT_LT((copy(v).swapdim(0,1) - u).normf(), 1e-14);
+            madness::unaryop_sqrt()(u);
+            ASSERT_LT((u.emul(u) - s).normf(), 1e-14);
+        }
+        madness::vmath_set_isa(isa);
+    }
+
+    TEST(VMathTest, Throughput) {
+        // Not a pass/fail test ... reports million elements per second
+        typedef void (*vfT)(long, const double*, double*);
+        const char* names[] = {"exp", "log", "sqrt", "erf", "sin", "cos", "pow3.7"};
+        const vfT fs[] = {madness::vexp, madness::vlog, madness::vsqrt, madness::verf,
+                          madness::vsin, madness::vcos, vpow3};
+        const long n = 4096, nloop = 100;
+        std::vector<double> x(n), y(n);
+        madness::Random r(11);
+        for (long i=0; i<n; ++i) x[i] = 0.1 + 5.0*r.get();
+
+        const madness::MTxmqISA isa = madness::vmath_isa();
+        std::printf("%8s %10s %10s %10s (Melem/s)\n", "f", "reference", "avx2", "avx512");
+        for (int f=0; f<7; ++f) {
+            double rate[3] = {0.0, 0.0, 0.0};
+            for (int i=madness::MTXMQ_ISA_REFERENCE; i<=madness::mTxmq_best_isa(); ++i) {
+                madness::vmath_set_isa(madness::MTxmqISA(i));
+                double used = 1e99;
+                for (int t=0; t<5; ++t) {
+                    double start = madness::wall_time();
+                    for (long loop=0; loop<nloop; ++loop) fs[f](n, &x[0], &y[0]);
+                    used = std::min(used, madness::wall_time() - start);
+                }
+                rate[i] = 1e-6*n*nloop/used;
+            }
+            std::printf("%8s %10.1f %10.1f %10.1f\n", names[f], rate[0], rate[1], rate[2]);
+        }
+        madness::vmath_set_isa(isa);
+    }
+
+    TEST(TensorContractTest, InnerAnyIndex) {
+        // inner over every index pair of two 3d tensors against explicit loops
+        madness::Tensor<double> a(6,7,6), b(7,6,7);
+        a.fillrandom();
+        b.fillrandom();
+        madness::Tensor<double> big(12,7,8);
+        big.fillrandom();
+        madness::Tensor<double> as = big(madness::Slice(0,-1,2),madness::_,madness::Slice(1,6));
+        for (int strided=0; strided<2; ++strided) {
+            const madness::Tensor<double>& l = strided ? as : a;
+            for (long k0=0; k0<3; ++k0) {
+                for (long k1=0; k1<3; ++k1) {
+                    if (l.dim(k0) != b.dim(k1)) continue;
+                    madness::Tensor<double> r = inner(l,b,k0,k1);
+                    madness::Tensor<double> acc = copy(r);
+                    inner_result(l,b,k0,k1,acc);
+                    long i[3], j[3];
+                    double err = 0.0;
+                    for (i[0]=0; i[0]<l.dim(0); ++i[0]) for (i[1]=0; i[1]<l.dim(1); ++i[1]) for (i[2]=0; i[2]<l.dim(2); ++i[2]) {
+                        for (j[0]=0; j[0]<b.dim(0); ++j[0]) for (j[1]=0; j[1]<b.dim(1); ++j[1]) for (j[2]=0; j[2]<b.dim(2); ++j[2]) {
+                            if (i[k0] != 0 || j[k1] != 0) continue;
+                            double sum = 0.0;
+                            long ii[3] = {i[0],i[1],i[2]}, jj[3] = {j[0],j[1],j[2]};
+                            for (long k=0; k<l.dim(k0); ++k) {
+                                ii[k0] = jj[k1] = k;
+                                sum += l(ii[0],ii[1],ii[2])*b(jj[0],jj[1],jj[2]);
+                            }
+                            long x[4], n = 0;
+                            for (int d=0; d<3; ++d) if (d != k0) x[n++] = i[d];
+                            for (int d=0; d<3; ++d) if (d != k1) x[n++] = j[d];
+                            err = std::max(err, std::abs(r(x[0],x[1],x[2],x[3]) - sum));
+                            err = std::max(err, std::abs(acc(x[0],x[1],x[2],x[3]) - 2.0*sum));
+                        }
+                    }
+                    ASSERT_LT(err, 1e-13);
+                }
+            }
+        }
+
+        // Several index pairs at once, and mixed types
+        madness::Tensor<double> ab = madness::contract(a, b, std::vector<long>(1,1), std::vector<long>(1,0));
+        ASSERT_LT((ab - inner(a,b,1,0)).normf(), 1e-13);
+        std::vector<long> k0(2), k1(2);
+        k0[0] = 0; k0[1] = 1; k1[0] = 1; k1[1] = 2;
+        ab = madness::contract(a, b, k0, k1);
+        madness::Tensor<double> ref(6,7);
+        for (long i=0; i<6; ++i) for (long j=0; j<7; ++j)
+            for (long p=0; p<6; ++p) for (long q=0; q<7; ++q) ref(i,j) += a(p,q,i)*b(j,p,q);
+        ASSERT_LT((ab - ref).normf(), 1e-13);
+        madness::Tensor<double_complex> z(7,6,7);
+        z.fillrandom();
+        madness::Tensor<double_complex> az = inner(a,z,1,2);
+        ASSERT_LT((real(az) - inner(a,real(z),1,2)).normf(), 1e-13);
+        ASSERT_LT((imag(az) - inner(a,imag(z),1,2)).normf(), 1e-13);
+    }
+
+    TEST(TensorContractTest, Einsum) {
+        using madness::einsum;
+        madness::Tensor<double> x(5,6), y(6,7), z(7,4), t(4,5,6), v(4,6);
+        x.fillrandom(); y.fillrandom(); z.fillrandom(); t.fillrandom(); v.fillrandom();
+        const double tol = 1e-13;
+
+        ASSERT_LT((einsum("ij,jk->ik", x, y) - inner(x,y)).normf(), tol);
+        ASSERT_LT((einsum("ij,jk,kl->il", x, y, z) - inner(inner(x,y),z)).normf(), tol);
+        ASSERT_LT((einsum("jk,ij,kl", y, x, z) - inner(inner(x,y),z)).normf(), tol);   // implicit result
+        ASSERT_LT((einsum("ijk->kij", t) - copy(t.cycledim(1,0,2))).normf(), tol);
+        ASSERT_LT((einsum("ij,ij->ji", x, x) - copy(x).emul(x).swapdim(0,1)).normf(), tol);
+
+        // Batch index, summed index private to one operand, scalar intermediate
+        madness::Tensor<double> ref(4,5);
+        for (long b=0; b<4; ++b) for (long i=0; i<5; ++i) for (long j=0; j<6; ++j) ref(b,i) += t(b,i,j)*v(b,j);
+        ASSERT_LT((einsum("bij,bj->bi", t, v) - ref).normf(), tol);
+        ASSERT_LT((einsum("bij->b", t) - einsum("bij,i,j->b", std::vector< madness::Tensor<double> >{t, madness::Tensor<double>(5).fill(1.0), madness::Tensor<double>(6).fill(1.0)})).normf(), tol);
+        madness::Tensor<double> w(3);
+        w.fillrandom();
+        ASSERT_LT((einsum("ij,ij,k->k", x, x, w) - w*x.trace(x)).normf(), tol);
+
+        madness::Tensor<double_complex> c(6,7);
+        c.fillrandom();
+        ASSERT_LT((einsum("ij,jk->ki", x, c) - transpose(inner(x,c))).normf(), tol);
+
+        ASSERT_THROW(einsum("ii->i", x), madness::TensorException);
+        ASSERT_THROW(einsum("ij,jk->", x, y), madness::TensorException);
+        ASSERT_THROW(einsum("ij,ik->jk", x, y), madness::TensorException);
+    }
+
+    TEST(TensorStorageTest, ConstructCopyDestroy) {
+        // Runs the life cycle of coefficient sized tensors through the
+        // small-block cache, checking that recycled data are zeroed and
+        // that copies alias the data, and reports the cost per tensor
+        const long nloop = 20000;
+        std::printf("%6s %14s %14s\n", "k", "new+del/ns", "copy+del/ns");
+        for (long k=4; k<=20; k+=2) {
+            bool zeroed = true;
+            double used = madness::wall_time();
+            for (long i=0; i<nloop; ++i) {
+                madness::Tensor<double> t(k,k,k);
+                zeroed = zeroed && (t.ptr()[0] == 0.0) && (t.ptr()[t.size()-1] == 0.0);
+                t.ptr()[0] = t.ptr()[t.size()-1] = 1.0;
+            }
+            used = madness::wall_time() - used;
+            EXPECT_TRUE(zeroed) << "k=" << k;
+
+            madness::Tensor<double> t(k,k,k);
+            t.fillindex();
+            bool aliased = true;
+            double copyused = madness::wall_time();
+            for (long i=0; i<nloop; ++i) {
+                madness::Tensor<double> u(t);
+                madness::Tensor<double> v;
+                v = u;
+                aliased = aliased && (v.ptr() == t.ptr());
+            }
+            copyused = madness::wall_time() - copyused;
+            EXPECT_TRUE(aliased) << "k=" << k;
+            EXPECT_EQ(t(k-1,k-1,k-1), double(k*k*k-1));
+
+            std::printf("%6ld %14.1f %14.1f\n", k, 1e9*used/nloop, 1e9*copyused/(2*nloop));
+        }
+    }
+
 //     TYPED_TEST(TensorTest, Container) {
 //         typedef madness::ConcurrentHashMap< int, Tensor<TypeParam> > containerT;
 //         static const int N = 100;
@@ -30,20 +30,162 @@
 
   $Id$
 */
+
+/// \file tensor/vmath.cc
+/// \brief Vectorized elementary functions and the compatibility interface to MKL/ACML vector math
+
+#include <madness/tensor/vmath.h>
+#include <complex>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+
+#include <immintrin.h>
+
+#define VMATH_NS vmath_avx2
+#define VMATH_TARGET __attribute__((target("avx2,fma")))
+#define VMATH_AVX2
+#include <madness/tensor/vmath_simd_kernels.h>
+#undef VMATH_AVX2
+#undef VMATH_TARGET
+#undef VMATH_NS
+
+#define VMATH_NS vmath_avx512
+#define VMATH_TARGET __attribute__((target("avx512f,avx2,fma")))
+#define VMATH_AVX512
+#include <madness/tensor/vmath_simd_kernels.h>
+#undef VMATH_AVX512
+#undef VMATH_TARGET
+#undef VMATH_NS
+
+#endif // MADNESS_HAVE_MTXMQ_SIMD
+
+namespace madness {
+
+    namespace {
+
+        typedef void (*unaryT)(long n, const double* x, double* y);
+
+        /// The vector math functions of one instruction set
+        struct VMathKernels {
+            unaryT exp, log, sqrt, erf, sin, cos;
+            void (*pow)(long n, const double* x, double p, double* y);
+            void (*sincos)(long n, const double* x, double* s, double* c);
+        };
+
+        // Reference versions
+
+        template <double (*f)(double)>
+        void ref_unary(long n, const double* x, double* y) {
+            for (long i=0; i<n; ++i) y[i] = f(x[i]);
+        }
+
+        double ref_exp(double x) {return std::exp(x);}
+        double ref_log(double x) {return std::log(x);}
+        double ref_sqrt(double x) {return std::sqrt(x);}
+        double ref_erf(double x) {return std::erf(x);}
+        double ref_sin(double x) {return std::sin(x);}
+        double ref_cos(double x) {return std::cos(x);}
+
+        void ref_pow(long n, const double* x, double p, double* y) {
+            for (long i=0; i<n; ++i) y[i] = std::pow(x[i], p);
+        }
+
+        void ref_sincos(long n, const double* x, double* s, double* c) {
+            for (long i=0; i<n; ++i) {
+                double xi = x[i];
+                s[i] = std::sin(xi);
+                c[i] = std::cos(xi);
+            }
+        }
+
+        MTxmqISA detect_isa() {
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return MTXMQ_ISA_AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return MTXMQ_ISA_AVX2;
+#endif
+            return MTXMQ_ISA_REFERENCE;
+        }
+
+        // Selected during static initialization (see mtxmq_simd.cc)
+        MTxmqISA best_isa = MTXMQ_ISA_REFERENCE;
+        MTxmqISA current_isa = MTXMQ_ISA_REFERENCE;
+        VMathKernels kernels = {ref_unary<ref_exp>, ref_unary<ref_log>, ref_unary<ref_sqrt>,
+                                ref_unary<ref_erf>, ref_unary<ref_sin>, ref_unary<ref_cos>,
+                                ref_pow, ref_sincos};
+
+        void select_isa(MTxmqISA isa) {
+            if (isa > best_isa) isa = best_isa;
+            VMathKernels k = {ref_unary<ref_exp>, ref_unary<ref_log>, ref_unary<ref_sqrt>,
+                              ref_unary<ref_erf>, ref_unary<ref_sin>, ref_unary<ref_cos>,
+                              ref_pow, ref_sincos};
+#ifdef MADNESS_HAVE_MTXMQ_SIMD
+            if (isa == MTXMQ_ISA_AVX2) {
+                VMathKernels t = {vmath_avx2::vexp, vmath_avx2::vlog, vmath_avx2::vsqrt,
+                                  vmath_avx2::verf, vmath_avx2::vsin, vmath_avx2::vcos,
+                                  vmath_avx2::vpow, vmath_avx2::vsincos};
+                k = t;
+            }
+            else if (isa == MTXMQ_ISA_AVX512) {
+                VMathKernels t = {vmath_avx512::vexp, vmath_avx512::vlog, vmath_avx512::vsqrt,
+                                  vmath_avx512::verf, vmath_avx512::vsin, vmath_avx512::vcos,
+                                  vmath_avx512::vpow, vmath_avx512::vsincos};
+                k = t;
+            }
+#endif
+            kernels = k;
+            current_isa = isa;
+        }
+
+        struct VMathInit {
+            VMathInit() {
+                best_isa = detect_isa();
+                MTxmqISA isa = best_isa;
+                const char* s = std::getenv("MAD_VMATH_ISA");
+                if (s) {
+                    if (std::strcmp(s, "reference") == 0) isa = MTXMQ_ISA_REFERENCE;
+                    else if (std::strcmp(s, "avx2") == 0) isa = MTXMQ_ISA_AVX2;
+                    else if (std::strcmp(s, "avx512") == 0) isa = MTXMQ_ISA_AVX512;
+                }
+                select_isa(isa);
+            }
+        } vmath_init;
+
+    } // namespace
+
+    void vexp(long n, const double* x, double* y) {kernels.exp(n, x, y);}
+    void vlog(long n, const double* x, double* y) {kernels.log(n, x, y);}
+    void vsqrt(long n, const double* x, double* y) {kernels.sqrt(n, x, y);}
+    void verf(long n, const double* x, double* y) {kernels.erf(n, x, y);}
+    void vsin(long n, const double* x, double* y) {kernels.sin(n, x, y);}
+    void vcos(long n, const double* x, double* y) {kernels.cos(n, x, y);}
+    void vpow(long n, const double* x, double p, double* y) {kernels.pow(n, x, p, y);}
+    void vsincos(long n, const double* x, double* s, double* c) {kernels.sincos(n, x, s, c);}
+
+    MTxmqISA vmath_isa() {
+        return current_isa;
+    }
+
+    MTxmqISA vmath_set_isa(MTxmqISA isa) {
+        select_isa(isa);
+        return current_isa;
+    }
+
+} // namespace madness
+
 // We will adopt the intel MKL interface as the standard
 // for vector math routines.
 
 // Must provide a compatibility interface to ACML and also
 // to no underlying math library
 
-#include <complex>
-#include <cmath>
-
 typedef std::complex<double> double_complex;
 
-#include <madness/madness_config.h>
 #ifdef HAVE_MKL
-#include <mkl.h>
 
 #elif defined(HAVE_ACML)
 #include <acml_mv.h>
@@ -71,7 +213,7 @@ void vzExp(int n, const double_complex* x, double_complex* y) {
     vdExp(n, a, expa);
     vdSinCos(n, b, sinb, cosb);
     for (int i=0; i<n; ++i) {
-        y[i] = double_complex(a[i]*cosb[i],a[i]*sinb[i]);
+        y[i] = double_complex(expa[i]*cosb[i],expa[i]*sinb[i]);
     }
     delete[] cosb;
     delete[] sinb;
@@ -83,7 +225,15 @@ void vzExp(int n, const double_complex* x, double_complex* y) {
 #else
 
 void vzExp(int n, const double_complex* x, double_complex* y) {
-    for (int i=0; i<n; ++i) y[i] = exp(x[i]);
+    if (n <= 0) return;
+    std::vector<double> a(n), b(n), s(n), c(n);
+    for (int i=0; i<n; ++i) {
+        a[i] = x[i].real();
+        b[i] = x[i].imag();
+    }
+    madness::vexp(n, &a[0], &a[0]);
+    madness::vsincos(n, &b[0], &s[0], &c[0]);
+    for (int i=0; i<n; ++i) y[i] = double_complex(a[i]*c[i], a[i]*s[i]);
 }
 
 #endif
@@ -33,7 +33,27 @@
 #ifndef MADNESS_TENSOR_VMATH_H__INCLUDED
 #define MADNESS_TENSOR_VMATH_H__INCLUDED
 
+/// \file tensor/vmath.h
+/// \brief Vectorized elementary functions of arrays and tensors
+
+/// The functions are evaluated a SIMD vector at a time with AVX2 or
+/// AVX-512 code chosen at run time in the same way as for mTxmq (set \c
+/// MAD_VMATH_ISA to \c reference, \c avx2 or \c avx512 to override the
+/// choice).  The reference code calls libm element by element.
+///
+/// Errors relative to the correctly rounded result are at most
+/// - 0.5 ulp for \c sqrt;
+/// - 1 ulp for \c exp and \c log;
+/// - 2 ulp for \c sin, \c cos and \c erf;
+/// - 2 ulp for \c pow with |p| <= 10, growing to about |p|/5 ulp beyond.
+/// Arguments the vector code does not cover (e.g., \c exp overflowing or
+/// underflowing, \c log of zero, negative or denormal numbers, \c sin and
+/// \c cos beyond 1e5, infinities and NaNs) are passed on to libm, so the
+/// special values are those of libm.  The output may be the input array.
+
 #include <madness/madness_config.h>
+#include <madness/tensor/tensor.h>
+#include <madness/tensor/mtxmq_simd.h>
 
 #ifdef HAVE_MKL
 #include <mkl.h>
@@ -42,5 +62,148 @@
 void vzExp(int n, const double_complex* x, double_complex* y);
 #endif
 
-#endif // MADNESS_TENSOR_VMATH_H__INCLUDED
+namespace madness {
+
+    /// y[i] = exp(x[i]) for i<n
+    void vexp(long n, const double* x, double* y);
+
+    /// y[i] = log(x[i]) for i<n
+    void vlog(long n, const double* x, double* y);
+
+    /// y[i] = sqrt(x[i]) for i<n
+    void vsqrt(long n, const double* x, double* y);
+
+    /// y[i] = pow(x[i],p) for i<n
+    void vpow(long n, const double* x, double p, double* y);
+
+    /// y[i] = erf(x[i]) for i<n
+    void verf(long n, const double* x, double* y);
+
+    /// y[i] = sin(x[i]) for i<n
+    void vsin(long n, const double* x, double* y);
+
+    /// y[i] = cos(x[i]) for i<n
+    void vcos(long n, const double* x, double* y);
+
+    /// s[i] = sin(x[i]) and c[i] = cos(x[i]) for i<n
+    void vsincos(long n, const double* x, double* s, double* c);
+
+    /// Returns the instruction set currently used by the vector math functions
+    MTxmqISA vmath_isa();
+
+    /// Selects the instruction set of the vector math functions (lowered to what the processor supports)
+
+    /// Not thread safe ... intended for testing and benchmarking
+    /// \return The instruction set actually selected
+    MTxmqISA vmath_set_isa(MTxmqISA isa);
+
+    namespace detail {
+
+        /// Applies a vector math function inplace to a tensor
+
+        /// Contiguous tensors are done in one call, others element by element with the scalar function
+        inline Tensor<double>& vmath_inplace(Tensor<double>& t, void (*vf)(long, const double*, double*),
+                                             double (*f)(double)) {
+            if (t.iscontiguous()) {
+                vf(t.size(), t.ptr(), t.ptr());
+            }
+            else {
+                UNARY_OPTIMIZED_ITERATOR(double, t, *_p0 = f(*_p0));
+            }
+            return t;
+        }
+
+    } // namespace detail
+
+    /// Inplace exp of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& vexp(Tensor<double>& t) {
+        return detail::vmath_inplace(t, vexp, std::exp);
+    }
 
+    /// Inplace log of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& vlog(Tensor<double>& t) {
+        return detail::vmath_inplace(t, vlog, std::log);
+    }
+
+    /// Inplace sqrt of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& vsqrt(Tensor<double>& t) {
+        return detail::vmath_inplace(t, vsqrt, std::sqrt);
+    }
+
+    /// Inplace erf of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& verf(Tensor<double>& t) {
+        return detail::vmath_inplace(t, verf, std::erf);
+    }
+
+    /// Inplace sin of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& vsin(Tensor<double>& t) {
+        return detail::vmath_inplace(t, vsin, std::sin);
+    }
+
+    /// Inplace cos of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& vcos(Tensor<double>& t) {
+        return detail::vmath_inplace(t, vcos, std::cos);
+    }
+
+    /// Inplace power of each element of a tensor
+
+    /// \ingroup tensor
+    inline Tensor<double>& vpow(Tensor<double>& t, double p) {
+        if (t.iscontiguous()) {
+            vpow(t.size(), t.ptr(), p, t.ptr());
+        }
+        else {
+            UNARY_OPTIMIZED_ITERATOR(double, t, *_p0 = std::pow(*_p0, p));
+        }
+        return t;
+    }
+
+    namespace detail {
+
+        /// Functor applying one of the inplace tensor functions above
+        template <Tensor<double>& (*vf)(Tensor<double>&)>
+        struct VmathUnaryOp {
+            Tensor<double>& operator()(Tensor<double>& t) const {
+                return vf(t);
+            }
+
+            /// The form used by \c Function::unaryop() (the key is not needed)
+            template <typename keyT>
+            void operator()(const keyT& key, Tensor<double>& t) const {
+                vf(t);
+            }
+
+            template <typename Archive> void serialize(Archive& ar) {}
+        };
+
+    } // namespace detail
+
+    /// \name Functors for the vector math functions
+    /// For instance, \c f.unaryop(unaryop_exp()) replaces the values of a
+    /// real function by their exponential box by box with \c vexp rather
+    /// than calling \c std::exp per point as \c f.unaryop(std::exp) does.
+    /// \ingroup tensor
+    //@{
+    typedef detail::VmathUnaryOp<vexp> unaryop_exp;
+    typedef detail::VmathUnaryOp<vlog> unaryop_log;
+    typedef detail::VmathUnaryOp<vsqrt> unaryop_sqrt;
+    typedef detail::VmathUnaryOp<verf> unaryop_erf;
+    typedef detail::VmathUnaryOp<vsin> unaryop_sin;
+    typedef detail::VmathUnaryOp<vcos> unaryop_cos;
+    //@}
+
+} // namespace madness
+
+#endif // MADNESS_TENSOR_VMATH_H__INCLUDED
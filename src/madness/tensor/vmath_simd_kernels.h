@@ -0,0 +1,502 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file tensor/vmath_simd_kernels.h
+/// \brief Internal use only ... vectorized exp, log, pow, erf, sin and cos for one instruction set
+
+// This file is included by vmath.cc once per instruction set with
+// VMATH_NS (namespace), VMATH_TARGET (function attributes) and one of
+// VMATH_AVX2 or VMATH_AVX512 defined.  Don't include it anywhere else.
+//
+// Each function is evaluated for a whole vector of arguments with no
+// branches.  Arguments for which the vector code is not accurate (out of
+// range, denormal, infinite or NaN) are flagged and recomputed with libm,
+// so the special values and errno-free results are those of libm.
+//
+//   exp    x = n*ln2 + r, |r| <= ln2/2 (Cody-Waite), degree 13 Taylor
+//          polynomial for exp(r) and 2^n made in the exponent bits.
+//   log    x = 2^e*(1+f), sqrt(1/2) <= 1+f < sqrt(2), log(1+f) = f - s*(f - R(s*s))
+//          with s = f/(2+f) and R the atanh series.
+//   pow    exp(p*log(x)) with log(x) carried to double-double so the error
+//          does not grow with |p*log(x)|.
+//   erf    |x| <= 1: x*P(x*x); 1 < |x| <= 6: 1 - exp(-x*x)*R(x) with R
+//          fitted on [1,2.5] and [2.5,6]; otherwise +-1.  Chebyshev fits.
+//   sin/cos  x = n*pi/2 + r with pi/2 split into three parts (exact for
+//          |x| < 2^20), Taylor polynomials on |r| <= pi/4 and the
+//          quadrant from the low bits of n.
+//
+// A constant c with the magic number 1.5*2^52 added is c rounded to the
+// nearest integer held in the low bits of the mantissa, which is how the
+// integers are moved between the floating point and integer units.
+
+namespace VMATH_NS {
+
+#define VMATH_INLINE static inline __attribute__((always_inline)) VMATH_TARGET
+#define VMATH_MEMBER inline __attribute__((always_inline)) VMATH_TARGET
+
+#if defined(VMATH_AVX2)
+
+    typedef __m256d vec;
+    typedef __m256i ivec;
+    typedef __m256d mask;
+    const int W = 4;
+
+    VMATH_INLINE vec vset(double x) { return _mm256_set1_pd(x); }
+    VMATH_INLINE vec vload(const double* p) { return _mm256_loadu_pd(p); }
+    VMATH_INLINE void vstore(double* p, vec v) { _mm256_storeu_pd(p, v); }
+    VMATH_INLINE vec vadd(vec a, vec b) { return _mm256_add_pd(a, b); }
+    VMATH_INLINE vec vsub(vec a, vec b) { return _mm256_sub_pd(a, b); }
+    VMATH_INLINE vec vmul(vec a, vec b) { return _mm256_mul_pd(a, b); }
+    VMATH_INLINE vec vdiv(vec a, vec b) { return _mm256_div_pd(a, b); }
+    VMATH_INLINE vec vsqrt(vec a) { return _mm256_sqrt_pd(a); }
+    /// a*b + c
+    VMATH_INLINE vec vfma(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+    /// a*b - c
+    VMATH_INLINE vec vfms(vec a, vec b, vec c) { return _mm256_fmsub_pd(a, b, c); }
+    /// c - a*b
+    VMATH_INLINE vec vfnma(vec a, vec b, vec c) { return _mm256_fnmadd_pd(a, b, c); }
+    VMATH_INLINE vec vand(vec a, vec b) { return _mm256_and_pd(a, b); }
+    VMATH_INLINE vec vxor(vec a, vec b) { return _mm256_xor_pd(a, b); }
+
+    VMATH_INLINE mask vlt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    VMATH_INLINE mask vgt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    /// Not a >= b, i.e., a < b or either is NaN
+    VMATH_INLINE mask vnge(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_NGE_UQ); }
+    /// Not a <= b, i.e., a > b or either is NaN
+    VMATH_INLINE mask vnle(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_NLE_UQ); }
+    VMATH_INLINE mask vor(mask a, mask b) { return _mm256_or_pd(a, b); }
+    /// m ? a : b
+    VMATH_INLINE vec vselect(mask m, vec a, vec b) { return _mm256_blendv_pd(b, a, m); }
+    /// One bit per element set in m
+    VMATH_INLINE int vbits(mask m) { return _mm256_movemask_pd(m); }
+
+    VMATH_INLINE ivec vcasti(vec a) { return _mm256_castpd_si256(a); }
+    VMATH_INLINE vec vcastd(ivec a) { return _mm256_castsi256_pd(a); }
+    VMATH_INLINE ivec viset(long long x) { return _mm256_set1_epi64x(x); }
+    VMATH_INLINE ivec viadd(ivec a, ivec b) { return _mm256_add_epi64(a, b); }
+    VMATH_INLINE ivec visub(ivec a, ivec b) { return _mm256_sub_epi64(a, b); }
+    VMATH_INLINE ivec viand(ivec a, ivec b) { return _mm256_and_si256(a, b); }
+    VMATH_INLINE ivec vior(ivec a, ivec b) { return _mm256_or_si256(a, b); }
+    template <int n> VMATH_INLINE ivec vislli(ivec a) { return _mm256_slli_epi64(a, n); }
+    template <int n> VMATH_INLINE ivec visrli(ivec a) { return _mm256_srli_epi64(a, n); }
+    /// Elements of a with bit b set
+    VMATH_INLINE mask vitest(ivec a, long long b) {
+        ivec bb = viset(b);
+        return vcastd(_mm256_cmpeq_epi64(viand(a, bb), bb));
+    }
+
+#elif defined(VMATH_AVX512)
+
+    typedef __m512d vec;
+    typedef __m512i ivec;
+    typedef __mmask8 mask;
+    const int W = 8;
+
+    VMATH_INLINE vec vset(double x) { return _mm512_set1_pd(x); }
+    VMATH_INLINE vec vload(const double* p) { return _mm512_loadu_pd(p); }
+    VMATH_INLINE void vstore(double* p, vec v) { _mm512_storeu_pd(p, v); }
+    VMATH_INLINE vec vadd(vec a, vec b) { return _mm512_add_pd(a, b); }
+    VMATH_INLINE vec vsub(vec a, vec b) { return _mm512_sub_pd(a, b); }
+    VMATH_INLINE vec vmul(vec a, vec b) { return _mm512_mul_pd(a, b); }
+    VMATH_INLINE vec vdiv(vec a, vec b) { return _mm512_div_pd(a, b); }
+    VMATH_INLINE vec vsqrt(vec a) { return _mm512_sqrt_pd(a); }
+    VMATH_INLINE vec vfma(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+    VMATH_INLINE vec vfms(vec a, vec b, vec c) { return _mm512_fmsub_pd(a, b, c); }
+    VMATH_INLINE vec vfnma(vec a, vec b, vec c) { return _mm512_fnmadd_pd(a, b, c); }
+    // The floating point logical operations need AVX-512DQ
+    VMATH_INLINE vec vand(vec a, vec b) {
+        return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)));
+    }
+    VMATH_INLINE vec vxor(vec a, vec b) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(b)));
+    }
+
+    VMATH_INLINE mask vlt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    VMATH_INLINE mask vgt(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    VMATH_INLINE mask vnge(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_NGE_UQ); }
+    VMATH_INLINE mask vnle(vec a, vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_NLE_UQ); }
+    VMATH_INLINE mask vor(mask a, mask b) { return mask(a | b); }
+    VMATH_INLINE vec vselect(mask m, vec a, vec b) { return _mm512_mask_blend_pd(m, b, a); }
+    VMATH_INLINE int vbits(mask m) { return int(m); }
+
+    VMATH_INLINE ivec vcasti(vec a) { return _mm512_castpd_si512(a); }
+    VMATH_INLINE vec vcastd(ivec a) { return _mm512_castsi512_pd(a); }
+    VMATH_INLINE ivec viset(long long x) { return _mm512_set1_epi64(x); }
+    VMATH_INLINE ivec viadd(ivec a, ivec b) { return _mm512_add_epi64(a, b); }
+    VMATH_INLINE ivec visub(ivec a, ivec b) { return _mm512_sub_epi64(a, b); }
+    VMATH_INLINE ivec viand(ivec a, ivec b) { return _mm512_and_si512(a, b); }
+    VMATH_INLINE ivec vior(ivec a, ivec b) { return _mm512_or_si512(a, b); }
+    template <int n> VMATH_INLINE ivec vislli(ivec a) { return _mm512_slli_epi64(a, n); }
+    template <int n> VMATH_INLINE ivec visrli(ivec a) { return _mm512_srli_epi64(a, n); }
+    VMATH_INLINE mask vitest(ivec a, long long b) { return _mm512_test_epi64_mask(a, viset(b)); }
+
+#endif
+
+    const double MAGIC = 6755399441055744.0;      // 1.5*2^52
+    const double LOG2E = 1.4426950408889634;
+    const double LN2HI = 6.93147180369123816490e-01; // leading 32 bits of ln2
+    const double LN2LO = 1.90821492927058770002e-10;
+    const double SIGN = -0.0;
+
+    /// Horner's rule for a polynomial of degree n-1
+    template <int n>
+    VMATH_INLINE vec vpoly(vec x, const double* c) {
+        vec p = vset(c[n-1]);
+#pragma GCC unroll 32
+        for (int i=n-2; i>=0; --i) p = vfma(p, x, vset(c[i]));
+        return p;
+    }
+
+    /// s + err = a + b exactly
+    VMATH_INLINE void vtwosum(vec a, vec b, vec& s, vec& err) {
+        s = vadd(a, b);
+        vec bb = vsub(s, a);
+        err = vadd(vsub(a, vsub(s, bb)), vsub(b, bb));
+    }
+
+    // ---------------------------------------------------------------------
+    // exp
+
+    const double EXP_LO = -708.0, EXP_HI = 709.0;
+
+    // 1/k! for k=0..13
+    const double exp_c[] = {
+        1.0, 1.0, 0.5, 1.6666666666666666e-01, 4.1666666666666664e-02,
+        8.3333333333333332e-03, 1.3888888888888889e-03, 1.9841269841269841e-04,
+        2.4801587301587302e-05, 2.7557319223985893e-06, 2.7557319223985888e-07,
+        2.5052108385441720e-08, 2.0876756987868100e-09, 1.6059043836821613e-10};
+
+    /// exp(x + xlo) for EXP_LO <= x <= EXP_HI and |xlo| tiny
+    VMATH_INLINE vec vexp_core(vec x, vec xlo) {
+        const vec magic = vset(MAGIC);
+        vec t = vfma(x, vset(LOG2E), magic);
+        vec n = vsub(t, magic);
+        vec r = vfnma(n, vset(LN2HI), x);
+        r = vfnma(n, vset(LN2LO), r);
+        r = vadd(r, xlo);
+        vec p = vpoly<14>(r, exp_c);
+        // 2^n ... the low bits of t are n
+        ivec k = visub(vcasti(t), vcasti(magic));
+        vec scale = vcastd(vislli<52>(viadd(k, viset(1023))));
+        return vmul(p, scale);
+    }
+
+    struct Exp {
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            bad = vor(vnge(x, vset(EXP_LO)), vnle(x, vset(EXP_HI)));
+            return vexp_core(x, vset(0.0));
+        }
+        static double ref(double x) { return std::exp(x); }
+    };
+
+    // ---------------------------------------------------------------------
+    // log
+
+    const double LOG_MIN = 2.2250738585072014e-308; // DBL_MIN
+    const double LOG_MAX = 1.7976931348623157e+308; // DBL_MAX
+
+    // 2/(2k+1) for k=1..10
+    const double log_c[] = {
+        6.6666666666666663e-01, 4.0000000000000002e-01, 2.8571428571428570e-01,
+        2.2222222222222221e-01, 1.8181818181818182e-01, 1.5384615384615385e-01,
+        1.3333333333333333e-01, 1.1764705882352941e-01, 1.0526315789473684e-01,
+        9.5238095238095233e-02};
+
+    /// log(x) = e*ln2hi + (f - c) + e*ln2lo for normal positive x ... returns the pieces
+    VMATH_INLINE void vlog_core(vec x, vec& e, vec& f, vec& c) {
+        const vec two52 = vset(4503599627370496.0);
+        ivec bits = vcasti(x);
+        // Biased exponent as a double
+        e = vsub(vcastd(vior(visrli<52>(bits), vcasti(two52))), two52);
+        e = vsub(e, vset(1023.0));
+        vec m = vcastd(vior(viand(bits, viset(0x000fffffffffffffLL)), viset(0x3ff0000000000000LL)));
+        mask big = vgt(m, vset(1.4142135623730951));
+        m = vselect(big, vmul(m, vset(0.5)), m);
+        e = vselect(big, vadd(e, vset(1.0)), e);
+        f = vsub(m, vset(1.0));
+        vec s = vdiv(f, vadd(f, vset(2.0)));
+        vec z = vmul(s, s);
+        vec R = vmul(z, vpoly<10>(z, log_c));
+        c = vmul(s, vsub(f, R));
+    }
+
+    struct Log {
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            bad = vor(vnge(x, vset(LOG_MIN)), vnle(x, vset(LOG_MAX)));
+            vec e, f, c;
+            vlog_core(x, e, f, c);
+            vec lo = vfms(e, vset(LN2LO), c);
+            return vfma(e, vset(LN2HI), vadd(f, lo));
+        }
+        static double ref(double x) { return std::log(x); }
+    };
+
+    // ---------------------------------------------------------------------
+    // pow with a scalar exponent
+
+    struct Pow {
+        double p;
+        explicit Pow(double p) : p(p) {}
+
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            vec e, f, c;
+            vlog_core(x, e, f, c);
+            // log(x) = hi + lo ... (e*ln2hi + f) - c with both sums exact (two-sum)
+            vec hi, lo, err;
+            vtwosum(vmul(e, vset(LN2HI)), f, hi, lo);
+            vtwosum(hi, vsub(vset(0.0), c), hi, err);
+            lo = vadd(vadd(lo, err), vmul(e, vset(LN2LO)));
+            // Renormalize so that |lo| <= ulp(hi)/2
+            vec h = vadd(hi, lo);
+            lo = vadd(vsub(hi, h), lo);
+            hi = h;
+            // y = p*log(x) = yhi + ylo
+            vec vp = vset(p);
+            vec yhi = vmul(vp, hi);
+            vec ylo = vfma(vp, lo, vfms(vp, hi, yhi));
+            bad = vor(vor(vnge(x, vset(LOG_MIN)), vnle(x, vset(LOG_MAX))),
+                      vor(vnge(yhi, vset(EXP_LO)), vnle(yhi, vset(EXP_HI))));
+            return vexp_core(yhi, ylo);
+        }
+        double ref(double x) const { return std::pow(x, p); }
+    };
+
+    // ---------------------------------------------------------------------
+    // sqrt ... the instruction is correctly rounded
+
+    struct Sqrt {
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            bad = vlt(x, vset(0.0));   // only for the sake of errno
+            return vsqrt(x);
+        }
+        static double ref(double x) { return std::sqrt(x); }
+    };
+
+    // ---------------------------------------------------------------------
+    // erf
+
+    // erf(x) = x*P(2*x*x - 1) for |x| <= 1
+    const double erf_a[] = {
+        0.96546873866986727, -0.14053608902271711, 0.019852496688984218,
+        -0.0022854855611440855, 0.00021751715603563488, -1.7537169441280198e-05,
+        1.2233827638093572e-06, -7.51156925108609e-08, 4.1157515002658853e-09,
+        -2.035231956483527e-10, 9.2112501874282304e-12, -3.8065912241221399e-13};
+
+    // exp(x*x)*erfc(x) = R((x - 1.75)/0.75) for 1 <= x <= 2.5
+    const double erf_b1[] = {
+        0.28497223473743638, -0.098232259135863906, 0.031367041923984512,
+        -0.0093909354924603256, 0.0026591791242491221, -0.0007168914456118457,
+        0.0001849560777696111, -4.5856167136466223e-05, 1.0962896542159193e-05,
+        -2.5345107841273393e-06, 5.6800825015196657e-07, -1.2366035459110419e-07,
+        2.6214568079487618e-08, -5.4135571573905924e-09, 1.0771290313630326e-09,
+        -2.1245086396244978e-10, 4.8546206397191835e-11, -9.112420747968596e-12};
+
+    // exp(x*x)*erfc(x) = R((x - 4.25)/1.75) for 2.5 <= x <= 6
+    const double erf_b2[] = {
+        0.12934527478599253, -0.050652579975578184, 0.019391340462986965,
+        -0.0072669543172292272, 0.0026690037369852784, -0.00096173298638538068,
+        0.00034031141027692435, -0.00011835411956521039, 4.0487314200447514e-05,
+        -1.3632078719121409e-05, 4.5176226066556626e-06, -1.4764959666320758e-06,
+        4.8098107864929914e-07, -1.5277977174198102e-07, 4.2789506641696626e-08,
+        -1.3332115949837287e-08, 6.8272018228983557e-09, -2.0449696870215864e-09};
+
+    struct Erf {
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            const vec one = vset(1.0);
+            vec sign = vand(x, vset(SIGN));
+            vec ax = vxor(x, sign);
+            bad = vnle(ax, vset(LOG_MAX));   // inf and NaN
+
+            mask small = vlt(ax, one);
+            vec ya = vset(0.0), yb = vset(0.0);
+            if (vbits(small)) {
+                vec t = vfms(vmul(x, x), vset(2.0), one);
+                ya = vmul(x, vpoly<12>(t, erf_a));
+            }
+            if (vbits(small) != (1<<W)-1) {
+                mask hi = vgt(ax, vset(2.5));
+                vec t = vmul(vsub(ax, vselect(hi, vset(4.25), vset(1.75))),
+                             vselect(hi, vset(1.0/1.75), vset(1.0/0.75)));
+                vec R = vselect(hi, vset(erf_b2[17]), vset(erf_b1[17]));
+#pragma GCC unroll 32
+                for (int i=16; i>=0; --i) R = vfma(R, t, vselect(hi, vset(erf_b2[i]), vset(erf_b1[i])));
+                // exp(-x*x) with the rounding error of x*x
+                vec x2 = vmul(ax, ax);
+                vec x2lo = vfms(ax, ax, x2);
+                vec ex = vexp_core(vsub(vset(0.0), vselect(vgt(x2, vset(36.0)), vset(36.0), x2)),
+                                   vsub(vset(0.0), x2lo));
+                yb = vfnma(ex, R, one);
+                yb = vselect(vgt(ax, vset(6.0)), one, yb);
+                yb = vxor(yb, sign);
+            }
+            return vselect(small, ya, yb);
+        }
+        static double ref(double x) { return std::erf(x); }
+    };
+
+    // ---------------------------------------------------------------------
+    // sin and cos
+
+    const double TRIG_MAX = 1e5;
+    const double TWO_OVER_PI = 0.6366197723675814;
+    const double PIO2_1 = 1.5707963267341256;      // leading 33 bits of pi/2
+    const double PIO2_2 = 6.077100506303966e-11;   // next 33 bits
+    const double PIO2_3 = 2.0222662487959506e-21;
+
+    // (-1)^k/(2k+3)! for k=0..7
+    const double sin_c[] = {
+        -1.6666666666666666e-01, 8.3333333333333332e-03, -1.9841269841269841e-04,
+        2.7557319223985893e-06, -2.5052108385441720e-08, 1.6059043836821613e-10,
+        -7.6471637318198164e-13, 2.8114572543455206e-15};
+
+    // (-1)^k/(2k+4)! for k=0..7
+    const double cos_c[] = {
+        4.1666666666666664e-02, -1.3888888888888889e-03, 2.4801587301587302e-05,
+        -2.7557319223985888e-07, 2.0876756987868100e-09, -1.1470745597729725e-11,
+        4.7794773323873853e-14, -1.5619206968586225e-16};
+
+    /// sin(r) and cos(r) with x = n*pi/2 + r ... returns n in the low bits
+    VMATH_INLINE ivec vsincos_core(vec x, vec& s, vec& c) {
+        const vec magic = vset(MAGIC);
+        vec t = vfma(x, vset(TWO_OVER_PI), magic);
+        vec n = vsub(t, magic);
+        vec r = vfnma(n, vset(PIO2_1), x);
+        r = vfnma(n, vset(PIO2_2), r);
+        r = vfnma(n, vset(PIO2_3), r);
+        vec z = vmul(r, r);
+        s = vfma(vmul(r, z), vpoly<8>(z, sin_c), r);
+        c = vfma(vmul(z, z), vpoly<8>(z, cos_c), vfnma(vset(0.5), z, vset(1.0)));
+        return visub(vcasti(t), vcasti(magic));
+    }
+
+    VMATH_INLINE mask vtrig_bad(vec x) {
+        return vor(vnge(x, vset(-TRIG_MAX)), vnle(x, vset(TRIG_MAX)));
+    }
+
+    struct Sin {
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            bad = vtrig_bad(x);
+            vec s, c;
+            ivec q = vsincos_core(x, s, c);
+            vec y = vselect(vitest(q, 1), c, s);
+            return vxor(y, vcastd(vislli<62>(viand(q, viset(2)))));
+        }
+        static double ref(double x) { return std::sin(x); }
+    };
+
+    struct Cos {
+        VMATH_MEMBER vec operator()(vec x, mask& bad) const {
+            bad = vtrig_bad(x);
+            vec s, c;
+            ivec q = vsincos_core(x, s, c);
+            vec y = vselect(vitest(q, 1), s, c);
+            q = viadd(q, viset(1));
+            return vxor(y, vcastd(vislli<62>(viand(q, viset(2)))));
+        }
+        static double ref(double x) { return std::cos(x); }
+    };
+
+    // ---------------------------------------------------------------------
+    // Drivers
+
+    /// Recomputes the flagged elements with libm ... x is a copy since y may be x
+    template <typename opT>
+    VMATH_INLINE void fixup(const opT& op, int bad, const double* x, double* y) {
+        for (int j=0; j<W; ++j)
+            if (bad & (1<<j)) y[j] = op.ref(x[j]);
+    }
+
+    /// y[i] = op(x[i]) for i<n
+    template <typename opT>
+    VMATH_TARGET void map(const opT& op, long n, const double* x, double* y) {
+        long i = 0;
+        for (; i+W<=n; i+=W) {
+            vec v = vload(x+i);
+            mask bad;
+            vec r = op(v, bad);
+            int b = vbits(bad);
+            if (b) {
+                double xs[W];
+                vstore(xs, v);
+                vstore(y+i, r);
+                fixup(op, b, xs, y+i);
+            }
+            else {
+                vstore(y+i, r);
+            }
+        }
+        if (i < n) {
+            // The tail is padded with ones, which is a regular argument of everything
+            double xs[W], ys[W];
+            for (int j=0; j<W; ++j) xs[j] = (i+j < n) ? x[i+j] : 1.0;
+            mask bad;
+            vstore(ys, op(vload(xs), bad));
+            fixup(op, vbits(bad), xs, ys);
+            for (long j=0; i+j<n; ++j) y[i+j] = ys[j];
+        }
+    }
+
+    VMATH_TARGET void vexp(long n, const double* x, double* y) { map(Exp(), n, x, y); }
+    VMATH_TARGET void vlog(long n, const double* x, double* y) { map(Log(), n, x, y); }
+    VMATH_TARGET void vsqrt(long n, const double* x, double* y) { map(Sqrt(), n, x, y); }
+    VMATH_TARGET void verf(long n, const double* x, double* y) { map(Erf(), n, x, y); }
+    VMATH_TARGET void vsin(long n, const double* x, double* y) { map(Sin(), n, x, y); }
+    VMATH_TARGET void vcos(long n, const double* x, double* y) { map(Cos(), n, x, y); }
+    VMATH_TARGET void vpow(long n, const double* x, double p, double* y) { map(Pow(p), n, x, y); }
+
+    /// s[i] = sin(x[i]) and c[i] = cos(x[i]) for i<n ... s or c may be x
+    VMATH_TARGET void vsincos(long n, const double* x, double* s, double* c) {
+        double xs[W], ss[W], cs[W];
+        for (long i=0; i<n; i+=W) {
+            const long m = (n-i < W) ? n-i : W;
+            for (int j=0; j<W; ++j) xs[j] = (j < m) ? x[i+j] : 1.0;
+            vec v = vload(xs), sv, cv;
+            ivec q = vsincos_core(v, sv, cv);
+            mask odd = vitest(q, 1);
+            vstore(ss, vxor(vselect(odd, cv, sv), vcastd(vislli<62>(viand(q, viset(2))))));
+            q = viadd(q, viset(1));
+            vstore(cs, vxor(vselect(odd, sv, cv), vcastd(vislli<62>(viand(q, viset(2))))));
+            int bad = vbits(vtrig_bad(v));
+            for (int j=0; j<m; ++j) {
+                if (bad & (1<<j)) {
+                    ss[j] = std::sin(xs[j]);
+                    cs[j] = std::cos(xs[j]);
+                }
+                s[i+j] = ss[j];
+                c[i+j] = cs[j];
+            }
+        }
+    }
+
+#undef VMATH_MEMBER
+#undef VMATH_INLINE
+
+} // namespace VMATH_NS
@@ -596,6 +596,25 @@ namespace SafeMPI {
             return Intracomm(std::shared_ptr<Impl>(new Impl(group_comm, me, nproc, true)));
         }
 
+        /**
+         * This collective operation partitions this \c Intracomm into
+         * one new \c Intracomm per distinct \c color , ordering the
+         * processes in each by \c key .
+         *
+         * @param color Processes with the same (non-negative) color share a communicator
+         * @param key Determines the rank within the new communicator
+         * @return a new Intracomm object
+         */
+        Intracomm Split(int color, int key) const {
+            MADNESS_ASSERT(pimpl);
+            SAFE_MPI_GLOBAL_MUTEX;
+            MPI_Comm split_comm;
+            MADNESS_MPI_TEST(MPI_Comm_split(pimpl->comm, color, key, &split_comm));
+            int me; MADNESS_MPI_TEST(MPI_Comm_rank(split_comm, &me));
+            int nproc; MADNESS_MPI_TEST(MPI_Comm_size(split_comm, &nproc));
+            return Intracomm(std::shared_ptr<Impl>(new Impl(split_comm, me, nproc, true)));
+        }
+
         bool operator==(const Intracomm& other) const {
             return (pimpl == other.pimpl) || ((pimpl && other.pimpl) &&
                     Comm_compare(pimpl->comm, other.pimpl->comm));
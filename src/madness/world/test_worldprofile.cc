@@ -30,9 +30,25 @@
 */
 
 #include <madness/world/MADworld.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
 
 using namespace madness;
 
+int nfail = 0;
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        print("check failed:", what);
+        ++nfail;
+    }
+}
+
 
 void dave(int i) {
     PROFILE_FUNC;
@@ -49,14 +65,142 @@ void fred(int i) {
     dave(i);
 }
 
+// Some floating point work so the hardware counter profile has content
+double jim(int n) {
+    PROFILE_FUNC;
+    double sum = 0.0;
+    for (int i=0; i<n; ++i) sum += 1.0/(1.0 + double(i)*double(i));
+    return sum;
+}
+
+// The call tree checks profile these regions explicitly so that they
+// run whether or not the PROFILE macros are enabled
+
+double work(int n) {
+    double sum = 0.0;
+    for (int i=0; i<n; ++i) sum += 1.0/(1.0 + double(i));
+    return sum;
+}
+
+double leaf() {
+    static const int id = WorldProfile::register_id("test_leaf");
+    WorldProfileObj p(id);
+    return work(2000);
+}
+
+double inner(bool callleaf) {
+    static const int id = WorldProfile::register_id("test_inner");
+    WorldProfileObj p(id);
+    double sum = work(2000);
+    if (callleaf) sum += leaf();
+    return sum;
+}
+
+double outer() {
+    static const int id = WorldProfile::register_id("test_outer");
+    WorldProfileObj p(id);
+    return work(2000) + inner(true) + inner(false);
+}
+
+const WorldProfileNode* find_child(const WorldProfileNode* node, const char* name) {
+    if (!node) return 0;
+    const int id = WorldProfile::register_id(name);
+    for (unsigned int i=0; i<node->children.size(); ++i)
+        if (node->children[i]->id == id) return node->children[i];
+    return 0;
+}
+
+std::string read_file(const std::string& filename) {
+    std::ifstream f(filename.c_str());
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+// Returns the value of "calls" in the first JSON object with the given name
+long json_calls(const std::string& json, const std::string& name) {
+    std::size_t pos = json.find("{\"name\": \"" + name + "\"");
+    if (pos == std::string::npos) return -1;
+    pos = json.find("\"calls\": ", pos);
+    if (pos == std::string::npos) return -1;
+    return std::atol(json.c_str() + pos + 9);
+}
+
+void test_calltree(World& world) {
+    double sum = 0.0;
+    for (int i=0; i<100; ++i) sum += outer();
+    for (int i=0; i<50; ++i) sum += inner(true); // Distinct call path from outer -> inner
+    if (world.rank() == 0) print("calltree sum", sum);
+
+    // Local tree: one node per call path with the number of entries
+    const WorldProfileNode* root = WorldProfile::calltree_root();
+    const WorldProfileNode* o = find_child(root, "test_outer");
+    const WorldProfileNode* oi = find_child(o, "test_inner");
+    const WorldProfileNode* oil = find_child(oi, "test_leaf");
+    const WorldProfileNode* i = find_child(root, "test_inner");
+    const WorldProfileNode* il = find_child(i, "test_leaf");
+    check(o && oi && oil && i && il, "call paths present in the local tree");
+    if (o && oi && oil && i && il) {
+        check(o->count == 100, "outer count");
+        check(oi->count == 200, "outer;inner count");
+        check(oil->count == 100, "outer;inner;leaf count");
+        check(i->count == 50, "inner count");
+        check(il->count == 50, "inner;leaf count");
+        check(oi->parent == o && oil->parent == oi, "parent links");
+        check(o->icycles >= o->xcycles && o->icycles >= oi->icycles, "inclusive time contains callees");
+        check(find_child(oil, "test_leaf") == 0 && find_child(o, "test_leaf") == 0, "no spurious paths");
+    }
+
+    // Reduced output: counts are summed over processes
+    const std::string folded = "test_worldprofile.folded";
+    const std::string json = "test_worldprofile.json";
+    WorldProfile::write_folded(world, folded);
+    WorldProfile::write_json(world, json);
+    if (world.rank() == 0) {
+        std::map<std::string, unsigned long> us;
+        std::ifstream f(folded.c_str());
+        std::string path;
+        unsigned long t;
+        while (f >> path >> t) us[path] = t;
+        check(us.count("test_outer") && us.count("test_outer;test_inner") &&
+              us.count("test_outer;test_inner;test_leaf") && us.count("test_inner") &&
+              us.count("test_inner;test_leaf"), "call paths present in the folded output");
+        check(us.count("test_leaf") == 0, "leaf never called from the root");
+
+        const std::string s = read_file(json);
+        const long nproc = world.size();
+        const std::string root = "{\"name\": \"root\"";
+        check(s.compare(0, root.size(), root) == 0, "JSON root object");
+        check(std::count(s.begin(), s.end(), '{') == std::count(s.begin(), s.end(), '}') &&
+              std::count(s.begin(), s.end(), '[') == std::count(s.begin(), s.end(), ']'), "JSON brackets balance");
+        check(json_calls(s, "test_outer") == 100*nproc, "JSON outer calls");
+        check(json_calls(s, "test_leaf") == 50*nproc, "JSON first leaf is under inner");
+        std::size_t nleaf = 0;
+        for (std::size_t pos=s.find("\"test_leaf\""); pos!=std::string::npos; pos=s.find("\"test_leaf\"", pos+1)) ++nleaf;
+        check(nleaf == 2, "JSON leaf appears on two paths");
+
+        std::remove(folded.c_str());
+        std::remove(json.c_str());
+    }
+    world.gop.fence();
+}
+
 void realmain(int argc, char** argv)
 {
     World world(SafeMPI::COMM_WORLD);
     for (int i=0; i<1000; ++i)
         fred(i);
+    for (int i=0; i<500; ++i)
+        dave(i); // Distinct call path from fred -> dave
+    double sum = 0.0;
+    for (int i=0; i<100; ++i)
+        sum += jim(10000);
+    if (world.rank() == 0) print("jim sum", sum);
 
     WorldProfile::print(world);
 
+    test_calltree(world);
+
     world.gop.fence();
 }
 
@@ -71,5 +215,5 @@ int main(int argc, char** argv) {
     realmain(argc, argv);
 
     finalize();
-    return 0;
+    return nfail ? 1 : 0;
 }
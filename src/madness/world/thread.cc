@@ -40,8 +40,10 @@
 #include <madness/world/madness_exception.h>
 #include <madness/world/print.h>
 #include <madness/world/worldpapi.h>
+#include <madness/world/worldperf.h>
 #include <madness/world/safempi.h>
 #include <madness/world/atomicint.h>
+#include <madness/world/topology.h>
 #include <cstring>
 #include <fstream>
 
@@ -70,6 +72,7 @@ namespace madness {
     int ThreadBase::cpulo[3];
     int ThreadBase::cpuhi[3];
     bool ThreadBase::bind[3];
+    std::vector<int> ThreadBase::cpumap;
     pthread_key_t ThreadBase::thread_key;
 
     ThreadPool* ThreadPool::instance_ptr = 0;
@@ -140,6 +143,8 @@ namespace madness {
             error("caught unhandled exception");
         }
 
+        PerfCounters::close_thread();
+
 #ifdef HAVE_PAPI
         end_papi_measurement();
 #endif
@@ -205,7 +210,7 @@ namespace madness {
         memcpy(ThreadBase::bind, bind, 3*sizeof(bool));
         memcpy(ThreadBase::cpulo, cpu, 3*sizeof(int));
 
-        int ncpu = num_hw_processors();
+        int ncpu = cpumap.empty() ? num_hw_processors() : int(cpumap.size());
 
         // impose sanity and compute cpuhi
         for (int i=0; i<3; ++i) {
@@ -219,6 +224,10 @@ namespace madness {
         }
     }
 
+    void ThreadBase::set_affinity_cpus(const std::vector<int>& cpus) {
+        cpumap = cpus;
+    }
+
     void ThreadBase::set_affinity(int logical_id, int ind) {
         if (logical_id < 0 || logical_id > 2) {
             std::cout << "ThreadBase: set_affinity: logical_id bad?" << std::endl;
@@ -251,7 +260,7 @@ namespace madness {
 #ifndef ON_A_MAC
         cpu_set_t mask;
         CPU_ZERO(&mask);
-        for (int i=lo; i<=hi; ++i) CPU_SET(i,&mask);
+        for (int i=lo; i<=hi; ++i) CPU_SET(cpumap.empty() ? i : cpumap[i], &mask);
         if (sched_setaffinity(0, sizeof(mask), &mask) == -1) {
             perror("system error message");
             std::cout << "ThreadBase: set_affinity: Could not set cpu affinity" << std::endl;
@@ -427,6 +436,9 @@ namespace madness {
                 MADNESS_EXCEPTION("POOL_NTHREAD is not an integer", result);
             nthread -= shift;
         }
+        else if (Topology::available()) {
+            nthread = Topology::default_pool_nthread(); // One less than # cores we own
+        }
         else {
             nthread = ThreadBase::num_hw_processors();
             if (nthread < 2)
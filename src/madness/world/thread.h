@@ -68,6 +68,7 @@ extern "C" {
 #endif
 #include <sstream> // for std::istringstream
 #include <cstring> // for strchr & strrchr
+#include <madness/world/worldperf.h>
 #endif // MADNESS_TASK_PROFILING
 
 #ifdef HAVE_INTEL_TBB
@@ -107,6 +108,7 @@ namespace madness {
         static bool bind[3]; ///< \todo Brief description needed.
         static int cpulo[3]; ///< \todo Brief description needed.
         static int cpuhi[3]; ///< \todo Brief description needed.
+        static std::vector<int> cpumap; ///< Maps cpu numbers in the affinity pattern to os cpu ids (identity if empty).
         static pthread_key_t thread_key; ///< Thread id key.
 
         /// \todo Brief description needed.
@@ -200,6 +202,15 @@ namespace madness {
         /// \param[in] cpu Description needed.
         static void set_affinity_pattern(const bool bind[3], const int cpu[3]);
 
+        /// Specify the cpus that the affinity pattern refers to.
+
+        /// After this call cpu \c i of the affinity pattern is the operating
+        /// system cpu \c cpus[i] and there are \c cpus.size() cpus.  Must be
+        /// called before \c set_affinity_pattern().  An empty list restores
+        /// the identity mapping over all hardware processors.
+        /// \param[in] cpus The operating system cpu ids.
+        static void set_affinity_cpus(const std::vector<int>& cpus);
+
         /// \todo Brief description needed.
 
         /// \todo Descriptions needed.
@@ -483,12 +494,14 @@ namespace madness {
         /// Task event class.
 
         /// This class is used to record the task trace information, including
-        /// submit, start, and stop times, as well as identification information.
+        /// submit, start, and stop times, hardware counters, as well as
+        /// identification information.
         class TaskEvent {
         private:
             double times_[3]; ///< Task trace times: { submit, start, stop }.
             std::pair<void*, unsigned short> id_; ///< Task identification information.
             unsigned short threads_; ///< Number of threads used by the task.
+            PerfCounterValues hw_; ///< Hardware counters used by the task (single-threaded tasks only).
 
             /// Print demangled symbol name.
 
@@ -575,12 +588,24 @@ namespace madness {
                 id_ = id;
                 threads_ = threads;
                 times_[0] = submit_time;
+                // Multi-threaded tasks may start and stop on different
+                // threads so counter differences would be meaningless
+                if(threads == 1)
+                    PerfCounters::read(hw_);
                 times_[1] = wall_time();
             }
 
             /// Record the stop time of the task.
             void stop() {
                 times_[2] = wall_time();
+                if(threads_ == 1) {
+                    PerfCounterValues now;
+                    PerfCounters::read(now);
+                    hw_ = now - hw_;
+                }
+                else {
+                    hw_ = PerfCounterValues();
+                }
             }
 
             /// Output the task data using a tab-separated list.
@@ -591,7 +616,10 @@ namespace madness {
             /// - the number of threads used by the task
             /// - the submit time
             /// - the start time
-            /// - the stop time.
+            /// - the stop time
+            /// - the cycles, instructions, last-level cache misses and flops
+            ///   (zero if hardware counters are unavailable or the task is
+            ///   multi-threaded).
             ///
             /// \param[in,out] os The output stream.
             /// \param[in] te The task event to be output.
@@ -628,6 +656,9 @@ namespace madness {
                 os.precision(6);
                 os << std::fixed << "\t" << te.times_[0]
                         << "\t" << te.times_[1] << "\t" << te.times_[2];
+                os.precision(0);
+                os << "\t" << te.hw_.cycles << "\t" << te.hw_.instructions
+                        << "\t" << te.hw_.llc_misses << "\t" << te.hw_.flops;
                 os.precision(precision);
                 return os;
             }
@@ -1176,10 +1207,6 @@ namespace madness {
         /// \todo Could we use C++11's `= delete` to hide this?
         void operator=(const ThreadPool&);       // Verboten
 
-        /// Get the number of threads from the environment.
-
-        /// \return The number of threads.
-        int default_nthread();
 
        /// Run the next task.
 
@@ -1393,6 +1420,13 @@ namespace madness {
 #endif // HAVE_INTEL_TBB
         }
 
+        /// Get the default number of pool threads.
+
+        /// From \c MAD_NUM_THREADS (less one for the main thread) or
+        /// \c POOL_NTHREAD if set, otherwise from the node topology.
+        /// \return The number of threads.
+        static int default_nthread();
+
         /// Returns the number of threads in the pool.
 
         /// \return The number of threads in the pool.
@@ -0,0 +1,382 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file topology.cc
+ \brief Implementation of the node topology probe.
+ \ingroup threads
+*/
+
+#include <madness/world/topology.h>
+#include <madness/world/safempi.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+#define MADNESS_TOPOLOGY_USE_SYSFS 1
+#endif
+
+namespace madness {
+
+    namespace {
+
+        struct TopologyData {
+            bool initialized;
+            bool available;
+            bool exclusive;
+            int nsocket, nnuma, ncore, nhwthread;
+            int nprocess_core;
+            int local_rank, local_size;
+            std::vector<int> process_cpus;
+            std::size_t l1d, l2, l3, line;
+
+            TopologyData()
+                : initialized(false), available(false), exclusive(false)
+                , nsocket(1), nnuma(1), ncore(1), nhwthread(1), nprocess_core(1)
+                , local_rank(0), local_size(1)
+                , l1d(0), l2(0), l3(0), line(0)
+            {}
+        };
+
+        TopologyData& topo() {
+            static TopologyData data;
+            return data;
+        }
+
+        /// First of the environment variables that is set, as an integer, or \c dflt
+        int getenv_int(const char* const* names, int dflt) {
+            for (int i=0; names[i]; ++i) {
+                const char* s = std::getenv(names[i]);
+                if (s) return std::atoi(s);
+            }
+            return dflt;
+        }
+
+        /// Parses sizes such as "32K" or "16M" into bytes
+        std::size_t parse_size(const char* s) {
+            char* end = 0;
+            std::size_t n = std::strtoul(s, &end, 10);
+            if (*end == 'K' || *end == 'k') n *= 1024;
+            else if (*end == 'M' || *end == 'm') n *= 1024*1024;
+            else if (*end == 'G' || *end == 'g') n *= 1024*1024*1024;
+            return n;
+        }
+
+#ifdef MADNESS_TOPOLOGY_USE_SYSFS
+        /// Reads the first line of a file; returns false if it cannot be read
+        bool read_line(const char* path, char* buf, int len) {
+            std::FILE* f = std::fopen(path, "r");
+            if (!f) return false;
+            bool ok = (std::fgets(buf, len, f) != 0);
+            std::fclose(f);
+            if (ok) buf[std::strcspn(buf, "\n")] = 0;
+            return ok;
+        }
+
+        int read_int(const char* path, int dflt) {
+            char buf[64];
+            return read_line(path, buf, sizeof(buf)) ? std::atoi(buf) : dflt;
+        }
+
+        /// Counts the entries of \c dir whose name is \c prefix followed by a number
+        int count_dir(const char* dir, const char* prefix) {
+            DIR* d = opendir(dir);
+            if (!d) return 0;
+            int n = 0;
+            const std::size_t len = std::strlen(prefix);
+            while (struct dirent* e = readdir(d)) {
+                if (std::strncmp(e->d_name, prefix, len) == 0 &&
+                    e->d_name[len] >= '0' && e->d_name[len] <= '9') ++n;
+            }
+            closedir(d);
+            return n;
+        }
+
+        void probe_caches(int cpu) {
+            TopologyData& t = topo();
+            for (int index=0; ; ++index) {
+                char path[256], buf[64];
+                std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+                int level = read_int(path, -1);
+                if (level < 0) break;
+                std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, index);
+                if (!read_line(path, buf, sizeof(buf)) || std::strcmp(buf, "Instruction") == 0) continue;
+                std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu, index);
+                if (!read_line(path, buf, sizeof(buf))) continue;
+                std::size_t size = parse_size(buf);
+                if (level == 1) t.l1d = size;
+                else if (level == 2) t.l2 = size;
+                else if (level == 3) t.l3 = size;
+                std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/coherency_line_size", cpu, index);
+                int line = read_int(path, 0);
+                if (line > 0) t.line = line;
+            }
+        }
+
+        void probe_sysfs() {
+            TopologyData& t = topo();
+
+            const long nconf = sysconf(_SC_NPROCESSORS_CONF);
+            if (nconf <= 0) return;
+
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            if (sched_getaffinity(0, sizeof(mask), &mask) != 0) return;
+
+            // (package, core) of every online cpu
+            typedef std::pair<int,int> coreT;
+            std::map<int, coreT> cpu_core;
+            std::set<coreT> cores;
+            std::set<int> sockets;
+            for (int cpu=0; cpu<nconf && cpu<CPU_SETSIZE; ++cpu) {
+                char path[256];
+                std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+                int core = read_int(path, -1);
+                if (core < 0) continue; // offline or missing
+                std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+                int package = read_int(path, 0);
+                cpu_core[cpu] = coreT(package, core);
+                cores.insert(coreT(package, core));
+                sockets.insert(package);
+            }
+            if (cpu_core.empty()) return;
+
+            t.nhwthread = cpu_core.size();
+            t.ncore = cores.size();
+            t.nsocket = sockets.size();
+            t.nnuma = std::max(1, count_dir("/sys/devices/system/node", "node"));
+
+            // Cpus in our mask grouped by core
+            std::map<coreT, std::vector<int> > siblings;
+            int nmask = 0;
+            for (std::map<int, coreT>::const_iterator it=cpu_core.begin(); it!=cpu_core.end(); ++it) {
+                if (CPU_ISSET(it->first, &mask)) {
+                    siblings[it->second].push_back(it->first);
+                    ++nmask;
+                }
+            }
+            if (siblings.empty()) return;
+
+            // If the launcher left us on the whole node but there are
+            // several of us, take our share of the cores.  Whether that
+            // (or the launcher's binding) really left us alone is decided
+            // later by check_exclusive().
+            std::vector<std::vector<int> > mycores;
+            for (std::map<coreT, std::vector<int> >::const_iterator it=siblings.begin(); it!=siblings.end(); ++it)
+                mycores.push_back(it->second);
+            if (nmask == t.nhwthread && t.local_size > 1 && int(mycores.size()) >= t.local_size) {
+                const int n = mycores.size();
+                const int lo = (t.local_rank*n)/t.local_size;
+                const int hi = ((t.local_rank+1)*n)/t.local_size;
+                mycores = std::vector<std::vector<int> >(mycores.begin()+lo, mycores.begin()+hi);
+            }
+
+            // One cpu per core first, then the second SMT sibling of each core, ...
+            t.process_cpus.clear();
+            for (unsigned int smt=0; ; ++smt) {
+                bool any = false;
+                for (unsigned int c=0; c<mycores.size(); ++c) {
+                    if (smt < mycores[c].size()) {
+                        t.process_cpus.push_back(mycores[c][smt]);
+                        any = true;
+                    }
+                }
+                if (!any) break;
+            }
+            t.nprocess_core = mycores.size();
+
+            probe_caches(t.process_cpus[0]);
+            t.available = true;
+        }
+#endif // MADNESS_TOPOLOGY_USE_SYSFS
+
+        void probe_sysconf() {
+            TopologyData& t = topo();
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+            if (!t.l1d) t.l1d = std::max(0L, sysconf(_SC_LEVEL1_DCACHE_SIZE));
+            if (!t.l2) t.l2 = std::max(0L, sysconf(_SC_LEVEL2_CACHE_SIZE));
+            if (!t.l3) t.l3 = std::max(0L, sysconf(_SC_LEVEL3_CACHE_SIZE));
+            if (!t.line) t.line = std::max(0L, sysconf(_SC_LEVEL1_DCACHE_LINESIZE));
+#endif
+            // Conservative defaults typical of current x86 cores
+            if (!t.l1d) t.l1d = 32*1024;
+            if (!t.l2) t.l2 = 256*1024;
+            if (!t.line) t.line = 64;
+        }
+
+    } // namespace
+
+    void Topology::initialize() {
+        TopologyData& t = topo();
+        if (t.initialized) return;
+        t.initialized = true;
+
+        static const char* const rank_vars[] = {"OMPI_COMM_WORLD_LOCAL_RANK", "MPI_LOCALRANKID",
+                                                "MV2_COMM_WORLD_LOCAL_RANK", 0};
+        static const char* const size_vars[] = {"OMPI_COMM_WORLD_LOCAL_SIZE", "MPI_LOCALNRANKS",
+                                                "MV2_COMM_WORLD_LOCAL_SIZE", 0};
+        t.local_rank = getenv_int(rank_vars, 0);
+        t.local_size = std::max(1, getenv_int(size_vars, 1));
+        if (t.local_rank < 0 || t.local_rank >= t.local_size) t.local_rank = 0;
+
+#ifdef MADNESS_TOPOLOGY_USE_SYSFS
+        probe_sysfs();
+#endif
+        probe_sysconf();
+    }
+
+    bool Topology::available() {
+        return topo().available;
+    }
+
+    int Topology::num_sockets() {
+        return topo().nsocket;
+    }
+
+    int Topology::num_numa_nodes() {
+        return topo().nnuma;
+    }
+
+    int Topology::num_cores() {
+        return topo().ncore;
+    }
+
+    int Topology::num_hw_threads() {
+        return topo().nhwthread;
+    }
+
+    int Topology::num_process_cores() {
+        return topo().nprocess_core;
+    }
+
+    const std::vector<int>& Topology::process_cpus() {
+        return topo().process_cpus;
+    }
+
+    bool Topology::exclusive_cpus() {
+        return topo().exclusive;
+    }
+
+    void Topology::check_exclusive(const SafeMPI::Intracomm& comm) {
+        TopologyData& t = topo();
+        t.exclusive = false;
+
+        // Group processes by host; a hash collision only makes the test
+        // more conservative
+        char host[256];
+        if (gethostname(host, sizeof(host)) != 0) host[0] = 0;
+        host[sizeof(host)-1] = 0;
+        const int color = int(std::hash<std::string>()(host) & 0x7fffffff);
+        SafeMPI::Intracomm node = comm.Split(color, comm.Get_rank());
+
+        // No. of processes on the node holding each cpu
+        int maxcpu = 0;
+        for (unsigned int i=0; i<t.process_cpus.size(); ++i) maxcpu = std::max(maxcpu, t.process_cpus[i]+1);
+        std::vector<int> all;
+        if (node.Get_size() > 1) {
+            int n = 0;
+            node.Allreduce(&maxcpu, &n, 1, MPI_INT, MPI_MAX);
+            std::vector<int> mine(n, 0);
+            all.resize(n, 0);
+            for (unsigned int i=0; i<t.process_cpus.size(); ++i) mine[t.process_cpus[i]] = 1;
+            if (n) node.Allreduce(&mine[0], &all[0], n, MPI_INT, MPI_SUM);
+        }
+        else {
+            all.resize(maxcpu, 1);
+        }
+
+        bool disjoint = t.available && !t.process_cpus.empty();
+        for (unsigned int i=0; i<t.process_cpus.size(); ++i)
+            if (all[t.process_cpus[i]] != 1) disjoint = false;
+        t.exclusive = disjoint;
+    }
+
+    int Topology::local_rank() {
+        return topo().local_rank;
+    }
+
+    int Topology::local_size() {
+        return topo().local_size;
+    }
+
+    int Topology::default_pool_nthread() {
+        if (!available()) return -1;
+        return std::max(1, num_process_cores() - 1);
+    }
+
+    std::size_t Topology::l1d_cache_size() {
+        return topo().l1d;
+    }
+
+    std::size_t Topology::l2_cache_size() {
+        return topo().l2;
+    }
+
+    std::size_t Topology::l3_cache_size() {
+        return topo().l3;
+    }
+
+    std::size_t Topology::cache_line_size() {
+        return topo().line;
+    }
+
+    void Topology::print(std::ostream& s) {
+        const TopologyData& t = topo();
+        if (t.available) {
+            s << "node topology: " << t.nsocket << (t.nsocket == 1 ? " socket, " : " sockets, ")
+              << t.nnuma << (t.nnuma == 1 ? " NUMA node, " : " NUMA nodes, ")
+              << t.ncore << " cores, " << t.nhwthread << " hw threads; this process has "
+              << t.nprocess_core << " cores (" << t.process_cpus.size() << " hw threads)";
+            if (t.local_size > 1)
+                s << " as local rank " << t.local_rank << " of " << t.local_size;
+            if (!t.exclusive)
+                s << ", possibly shared with other processes";
+            s << "\n";
+        }
+        else {
+            s << "node topology: unavailable\n";
+        }
+        s << "caches: L1d " << t.l1d/1024 << " KB, L2 " << t.l2/1024 << " KB, L3 "
+          << t.l3/1024 << " KB, line " << t.line << " bytes\n";
+    }
+
+} // namespace madness
@@ -0,0 +1,139 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_TOPOLOGY_H__INCLUDED
+#define MADNESS_WORLD_TOPOLOGY_H__INCLUDED
+
+/**
+ \file topology.h
+ \brief Node topology (cores, SMT siblings, NUMA nodes, caches) discovered at startup.
+ \ingroup threads
+
+ On Linux the topology is read from \c /sys/devices/system and restricted
+ to the cpus in this process's affinity mask.  If several MPI processes
+ share a node without having been bound by the launcher, the cores are
+ divided between them using the local rank exported by common MPI
+ launchers (Open MPI, MPICH/Hydra, MVAPICH).  The cpus are only treated
+ as exclusive to the process once \c check_exclusive() has confirmed
+ that no two processes on the node hold the same cpu.  Elsewhere, or if \c /sys is
+ not readable, \c available() is false and the cache sizes come from
+ \c sysconf where possible or sensible defaults otherwise.
+
+ The result is used by \c madness::initialize() to size the thread pool
+ (unless \c MAD_NUM_THREADS or \c POOL_NTHREAD is set) and, if \c MAD_BIND
+ is "auto", to bind the main thread, the communication
+ thread, and the pool threads.  Kernels may use the cache sizes to choose
+ block sizes.
+*/
+
+#include <madness/madness_config.h>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace SafeMPI {
+    class Intracomm;
+}
+
+namespace madness {
+
+    /// Static interface to the topology of the node this process runs on
+    class Topology {
+    public:
+        /// Probes the topology; called from \c madness::initialize(), later calls do nothing
+        static void initialize();
+
+        /// True if the topology was read from the operating system
+        static bool available();
+
+        /// No. of processor packages (sockets) on the node
+        static int num_sockets();
+
+        /// No. of NUMA nodes on the node
+        static int num_numa_nodes();
+
+        /// No. of physical cores on the node
+        static int num_cores();
+
+        /// No. of hardware threads (logical cpus) on the node
+        static int num_hw_threads();
+
+        /// No. of physical cores available to this process
+        static int num_process_cores();
+
+        /// Logical cpus available to this process ordered one per core first, then SMT siblings
+
+        /// Binding consecutive threads to consecutive entries places them
+        /// on distinct cores for as long as there are unused cores.
+        static const std::vector<int>& process_cpus();
+
+        /// True if \c check_exclusive() found that \c process_cpus() are not shared with other processes
+        static bool exclusive_cpus();
+
+        /// Checks that the local processes hold disjoint cpus (collective)
+
+        /// Processes are grouped by host name and sum their cpu counts, so
+        /// this is true if the launcher bound the processes to disjoint
+        /// parts of the node or if the cores could be divided between
+        /// them, but not if, e.g., several processes were restricted to
+        /// the same socket.  Called from \c madness::initialize() once
+        /// MPI is up; until then \c exclusive_cpus() is false.
+        /// @param[in] comm Communicator of all processes
+        static void check_exclusive(const SafeMPI::Intracomm& comm);
+
+        /// Rank of this process among those on the same node (0 if unknown)
+        static int local_rank();
+
+        /// No. of processes on the same node (1 if unknown)
+        static int local_size();
+
+        /// Default no. of pool threads ... one less than the cores available to this process
+        static int default_pool_nthread();
+
+        /// Size in bytes of the level 1 data cache of one core
+        static std::size_t l1d_cache_size();
+
+        /// Size in bytes of the level 2 cache
+        static std::size_t l2_cache_size();
+
+        /// Size in bytes of the level 3 (last level) cache, or 0 if there is none
+        static std::size_t l3_cache_size();
+
+        /// Cache line size in bytes
+        static std::size_t cache_line_size();
+
+        /// Prints a short summary of the topology and cache sizes
+        static void print(std::ostream& s);
+    };
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_TOPOLOGY_H__INCLUDED
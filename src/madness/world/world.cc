@@ -41,7 +41,10 @@
 #include <madness/world/worldam.h>
 #include <madness/world/world_task_queue.h>
 #include <madness/world/worldgop.h>
+#include <madness/world/worldperf.h>
+#include <madness/world/topology.h>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 
 #ifdef MADNESS_HAS_ELEMENTAL
@@ -148,27 +151,32 @@ namespace madness {
         initialize_papi();
 #endif
 
+        Topology::initialize();
+
         bool bind[3];
         int cpulo[3];
 
         const char* sbind = getenv("MAD_BIND");
         if (!sbind) sbind = MAD_BIND_DEFAULT;
-        std::istringstream s(sbind);
-        for (int i=0; i<3; ++i) {
-            int t;
-            s >> t;
-            if (t < 0) {
-                bind[i] = false;
-                cpulo[i] = 0;
-            }
-            else {
-                bind[i] = true;
-                cpulo[i] = t;
+        const bool autobind = (std::strcmp(sbind, "auto") == 0);
+        if (!autobind) {
+            std::istringstream s(sbind);
+            for (int i=0; i<3; ++i) {
+                int t;
+                s >> t;
+                if (t < 0) {
+                    bind[i] = false;
+                    cpulo[i] = 0;
+                }
+                else {
+                    bind[i] = true;
+                    cpulo[i] = t;
+                }
             }
-        }
 
-        ThreadBase::set_affinity_pattern(bind, cpulo); // Decide how to locate threads before doing anything
-        ThreadBase::set_affinity(0);         // The main thread is logical thread 0
+            ThreadBase::set_affinity_pattern(bind, cpulo); // Decide how to locate threads before doing anything
+            ThreadBase::set_affinity(0);         // The main thread is logical thread 0
+        }
 
 #if defined(HAVE_IBMBGQ) and defined(HPM)
         // HPM Profiler
@@ -188,8 +196,32 @@ namespace madness {
         ThreadBase::set_hpm_thread_env(hpm_thread_id);
 #endif
         detail::WorldMpi::initialize(argc, argv, MADNESS_MPI_THREAD_LEVEL);
+        Topology::check_exclusive(SafeMPI::COMM_WORLD);
+        if (autobind) {
+            // Bind main thread to the first core we own, pool threads to the
+            // following cores, and the communication thread to a spare
+            // hardware thread if there is one ... otherwise leave it (and
+            // everything else if we might be sharing cpus) floating.  This
+            // waits for MPI since only then can we check that the local
+            // processes hold disjoint cpus.
+            const std::vector<int>& cpus = Topology::process_cpus();
+            const int ncpu = cpus.size();
+            const bool ok = Topology::available() && Topology::exclusive_cpus() && ncpu > 1;
+            if (ok) ThreadBase::set_affinity_cpus(cpus);
+            bind[0] = bind[2] = ok;
+            cpulo[0] = 0;
+            cpulo[2] = 1;
+            bind[1] = ok && (ncpu > ThreadPool::default_nthread() + 1);
+            cpulo[1] = bind[1] ? ncpu-1 : 0;
+
+            ThreadBase::set_affinity_pattern(bind, cpulo); // Before any threads are started
+            ThreadBase::set_affinity(0);         // The main thread is logical thread 0
+        }
         start_cpu_time = cpu_time();
         start_wall_time = wall_time();
+#if defined(WORLD_PROFILE_ENABLE) || defined(MADNESS_TASK_PROFILING)
+        PerfCounters::initialize(); // Before any threads so they all see the same settings
+#endif
         ThreadPool::begin();        // Must have thread pool before any AM arrives
         if(SafeMPI::COMM_WORLD.Get_size() > 1) {
             RMI::begin();           // Must have RMI while still running single threaded
@@ -210,9 +242,11 @@ namespace madness {
         World::default_world = new World(comm);
 
         madness_initialized_ = true;
-        if(SafeMPI::COMM_WORLD.Get_rank() == 0)
+        if(SafeMPI::COMM_WORLD.Get_rank() == 0) {
             std::cout << "MADNESS runtime initialized with " << ThreadPool::size()
                 << " threads in the pool and affinity " << sbind << "\n";
+            Topology::print(std::cout);
+        }
 
         return * World::default_world;
     }
@@ -231,6 +265,7 @@ namespace madness {
         if(SafeMPI::COMM_WORLD.Get_size() > 1)
             RMI::end();
         ThreadPool::end();
+        PerfCounters::close_thread();
         detail::WorldMpi::finalize();
         madness_initialized_ = false;
     }
@@ -0,0 +1,229 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file worldperf.cc
+ \brief Implementation of the per-thread hardware counters.
+ \ingroup world
+*/
+
+#include <madness/world/worldperf.h>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <stdint.h>
+#define MADNESS_HAVE_PERF_EVENT 1
+#endif
+
+namespace madness {
+
+#ifdef MADNESS_HAVE_PERF_EVENT
+
+    namespace {
+
+        const int NHW = 4; // cycles, instructions, LLC references, LLC misses
+
+        bool perf_initialized = false;
+        bool perf_enabled = false;
+        int perf_nflop = 0;
+        uint64_t perf_flop_config[PerfCounters::MAX_FLOP_EVENTS];
+        double perf_flop_weight[PerfCounters::MAX_FLOP_EVENTS];
+
+        // Per-thread state ... must be POD since thread_local may be __thread
+        thread_local int perf_state = 0;   // 0 = not opened, 1 = open, -1 = failed
+        thread_local int perf_hw_fd = -1;  // leader of the hardware group
+        thread_local int perf_flop_fd = -1; // leader of the flop group (or -1)
+        thread_local int perf_member_fd[NHW + PerfCounters::MAX_FLOP_EVENTS];
+        thread_local int perf_nmember = 0;
+
+        int perf_open(uint32_t type, uint64_t config, int group_fd) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP |
+                PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            // pid=0, cpu=-1 ... follow the calling thread on any cpu
+            return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+        }
+
+        /// Opens a group and returns the leader fd, or -1 if any member fails
+        int perf_open_group(uint32_t type, const uint64_t* config, int n) {
+            int leader = perf_open(type, config[0], -1);
+            if (leader < 0) return -1;
+            const int first = perf_nmember;
+            for (int i=1; i<n; ++i) {
+                int fd = perf_open(type, config[i], leader);
+                if (fd < 0) {
+                    while (perf_nmember > first) ::close(perf_member_fd[--perf_nmember]);
+                    ::close(leader);
+                    return -1;
+                }
+                perf_member_fd[perf_nmember++] = fd;
+            }
+            return leader;
+        }
+
+        void perf_open_thread() {
+            static const uint64_t hw[NHW] = {PERF_COUNT_HW_CPU_CYCLES,
+                                             PERF_COUNT_HW_INSTRUCTIONS,
+                                             PERF_COUNT_HW_CACHE_REFERENCES,
+                                             PERF_COUNT_HW_CACHE_MISSES};
+            perf_nmember = 0;
+            perf_hw_fd = perf_open_group(PERF_TYPE_HARDWARE, hw, NHW);
+            if (perf_hw_fd < 0) {
+                perf_state = -1;
+                return;
+            }
+            // Flops go in their own group so failing to schedule them does
+            // not cost us the basic counters
+            if (perf_nflop) perf_flop_fd = perf_open_group(PERF_TYPE_RAW, perf_flop_config, perf_nflop);
+            perf_state = 1;
+        }
+
+        /// Reads a group into \c values scaling for multiplexing; returns false on error
+        bool perf_read_group(int fd, int n, double* values) {
+            uint64_t buf[3 + NHW + PerfCounters::MAX_FLOP_EVENTS];
+            ssize_t nbyte = ::read(fd, buf, sizeof(uint64_t)*(3+n));
+            if (nbyte != ssize_t(sizeof(uint64_t)*(3+n)) || int(buf[0]) != n) return false;
+            const uint64_t enabled = buf[1], running = buf[2];
+            const double scale = (running > 0) ? double(enabled)/double(running) : 0.0;
+            for (int i=0; i<n; ++i) values[i] = double(buf[3+i])*scale;
+            return true;
+        }
+
+        void perf_parse_flop_events(const char* s) {
+            // Format: config:weight[,config:weight]... with config in hex
+            while (s && *s && perf_nflop < PerfCounters::MAX_FLOP_EVENTS) {
+                char* end = 0;
+                uint64_t config = std::strtoull(s, &end, 16);
+                if (end == s) break;
+                double weight = 1.0;
+                s = end;
+                if (*s == ':') {
+                    weight = std::strtod(s+1, &end);
+                    s = end;
+                }
+                perf_flop_config[perf_nflop] = config;
+                perf_flop_weight[perf_nflop] = weight;
+                ++perf_nflop;
+                while (*s == ',' || *s == ' ') ++s;
+            }
+        }
+
+    } // namespace
+
+    void PerfCounters::initialize() {
+        if (perf_initialized) return;
+        perf_initialized = true;
+
+        const char* s = std::getenv("MAD_PERF_COUNTERS");
+        if (s && std::atoi(s) == 0) {
+            perf_enabled = false;
+            return;
+        }
+        perf_parse_flop_events(std::getenv("MAD_PERF_FLOP_EVENTS"));
+
+        // Probe on the calling (main) thread
+        perf_enabled = true;
+        perf_open_thread();
+        perf_enabled = (perf_state == 1);
+    }
+
+    bool PerfCounters::available() {
+        return perf_enabled;
+    }
+
+    bool PerfCounters::have_flops() {
+        return perf_enabled && perf_nflop > 0;
+    }
+
+    void PerfCounters::read(PerfCounterValues& v) {
+        v = PerfCounterValues();
+        if (!perf_enabled) return;
+        if (perf_state == 0) perf_open_thread();
+        if (perf_state != 1) return;
+
+        double hw[NHW];
+        if (perf_read_group(perf_hw_fd, NHW, hw)) {
+            v.cycles = hw[0];
+            v.instructions = hw[1];
+            v.llc_refs = hw[2];
+            v.llc_misses = hw[3];
+        }
+        if (perf_flop_fd >= 0) {
+            double flop[MAX_FLOP_EVENTS];
+            if (perf_read_group(perf_flop_fd, perf_nflop, flop)) {
+                for (int i=0; i<perf_nflop; ++i) v.flops += perf_flop_weight[i]*flop[i];
+            }
+        }
+    }
+
+    void PerfCounters::close_thread() {
+        if (perf_state != 1) return;
+        for (int i=0; i<perf_nmember; ++i) ::close(perf_member_fd[i]);
+        if (perf_flop_fd >= 0) ::close(perf_flop_fd);
+        ::close(perf_hw_fd);
+        perf_nmember = 0;
+        perf_hw_fd = perf_flop_fd = -1;
+        perf_state = 0;
+    }
+
+#else
+
+    void PerfCounters::initialize() {}
+
+    bool PerfCounters::available() {
+        return false;
+    }
+
+    bool PerfCounters::have_flops() {
+        return false;
+    }
+
+    void PerfCounters::read(PerfCounterValues& v) {
+        v = PerfCounterValues();
+    }
+
+    void PerfCounters::close_thread() {}
+
+#endif // MADNESS_HAVE_PERF_EVENT
+
+} // namespace madness
@@ -0,0 +1,130 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_WORLDPERF_H__INCLUDED
+#define MADNESS_WORLD_WORLDPERF_H__INCLUDED
+
+/**
+ \file worldperf.h
+ \brief Per-thread hardware performance counters read through Linux \c perf_event_open.
+ \ingroup world
+
+ Unlike the PAPI interface in worldpapi.h this needs no external library. On
+ Linux each thread lazily opens a group of counters (cycles, instructions,
+ last-level cache references and misses) the first time it reads them, and
+ optionally a second group of raw floating-point events whose weighted sum
+ is reported as the flop count.  On other platforms, or if the kernel refuses
+ (\c /proc/sys/kernel/perf_event_paranoid, no PMU in a VM, ...), every read
+ returns zeros and \c PerfCounters::available() is false.
+
+ Environment variables read by \c PerfCounters::initialize():
+ - \c MAD_PERF_COUNTERS=0 disables the counters entirely.
+ - \c MAD_PERF_FLOP_EVENTS is a comma separated list of \c config:weight
+   pairs giving raw (\c PERF_TYPE_RAW) event codes in hexadecimal and the
+   number of flops each event counts.  E.g., on Intel Haswell and later
+   \c "0x01c7:1,0x04c7:2,0x10c7:4,0x40c7:8" counts scalar, 128-, 256- and
+   512-bit packed double precision FP_ARITH_INST_RETIRED.  At most
+   \c PerfCounters::MAX_FLOP_EVENTS are used.
+*/
+
+#include <madness/madness_config.h>
+
+namespace madness {
+
+    /// Snapshot (or difference of snapshots) of the hardware counters of one thread
+    struct PerfCounterValues {
+        double cycles;       ///< Core cycles
+        double instructions; ///< Instructions retired
+        double llc_refs;     ///< Last-level cache references
+        double llc_misses;   ///< Last-level cache misses
+        double flops;        ///< Weighted sum of the flop events (zero if none configured)
+
+        /// Constructor initializes all counters to zero
+        PerfCounterValues()
+            : cycles(0.0), instructions(0.0), llc_refs(0.0), llc_misses(0.0), flops(0.0) {}
+
+        PerfCounterValues& operator+=(const PerfCounterValues& other) {
+            cycles += other.cycles;
+            instructions += other.instructions;
+            llc_refs += other.llc_refs;
+            llc_misses += other.llc_misses;
+            flops += other.flops;
+            return *this;
+        }
+
+        PerfCounterValues& operator-=(const PerfCounterValues& other) {
+            cycles -= other.cycles;
+            instructions -= other.instructions;
+            llc_refs -= other.llc_refs;
+            llc_misses -= other.llc_misses;
+            flops -= other.flops;
+            return *this;
+        }
+
+        PerfCounterValues operator-(const PerfCounterValues& other) const {
+            PerfCounterValues result(*this);
+            result -= other;
+            return result;
+        }
+    }; // struct PerfCounterValues
+
+
+    /// Static interface to the per-thread hardware counters
+    class PerfCounters {
+    public:
+        static const int MAX_FLOP_EVENTS = 8; ///< Max. number of raw flop events
+
+        /// Reads the environment and probes the counters on the calling thread
+
+        /// Called from \c madness::initialize().  Safe to call more than
+        /// once; the environment is only read on the first call.
+        static void initialize();
+
+        /// True if counters are enabled and could be opened on the main thread
+        static bool available();
+
+        /// True if at least one flop event is configured and counting
+        static bool have_flops();
+
+        /// Reads the counters of the calling thread into \c v
+
+        /// The first read on a thread opens its counters.  If counters are
+        /// unavailable \c v is set to zero.  Values are scaled for
+        /// multiplexing so they remain comparable between reads.
+        static void read(PerfCounterValues& v);
+
+        /// Closes the counters of the calling thread (e.g., before it exits)
+        static void close_thread();
+    };
+
+} // namespace madness
+
+#endif // MADNESS_WORLD_WORLDPERF_H__INCLUDED
@@ -33,6 +33,10 @@
 #include <madness/world/mpi_archive.h>
 #include <madness/world/MADworld.h>
 #include <madness/world/atomicint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
 
 namespace madness {
 
@@ -71,6 +75,16 @@ namespace madness {
         inbyt_sent =  other.inbyt_sent;
         xnbyt_recv =  other.xnbyt_recv;
         inbyt_recv =  other.inbyt_recv;
+        xcycles = other.xcycles;
+        icycles = other.icycles;
+        xinstr = other.xinstr;
+        iinstr = other.iinstr;
+        xllcref = other.xllcref;
+        illcref = other.illcref;
+        xllcmiss = other.xllcmiss;
+        illcmiss = other.illcmiss;
+        xflops = other.xflops;
+        iflops = other.iflops;
 
         return *this;
     }
@@ -103,6 +117,16 @@ namespace madness {
         inbyt_sent.init_par_stats(me);
         xnbyt_recv.init_par_stats(me);
         inbyt_recv.init_par_stats(me);
+        xcycles.init_par_stats(me);
+        icycles.init_par_stats(me);
+        xinstr.init_par_stats(me);
+        iinstr.init_par_stats(me);
+        xllcref.init_par_stats(me);
+        illcref.init_par_stats(me);
+        xllcmiss.init_par_stats(me);
+        illcmiss.init_par_stats(me);
+        xflops.init_par_stats(me);
+        iflops.init_par_stats(me);
     }
 
     void WorldProfileEntry::par_reduce(const WorldProfileEntry& other) {
@@ -117,6 +141,16 @@ namespace madness {
         inbyt_sent.par_reduce(other.inbyt_sent);
         xnbyt_recv.par_reduce(other.xnbyt_recv);
         inbyt_recv.par_reduce(other.inbyt_recv);
+        xcycles.par_reduce(other.xcycles);
+        icycles.par_reduce(other.icycles);
+        xinstr.par_reduce(other.xinstr);
+        iinstr.par_reduce(other.iinstr);
+        xllcref.par_reduce(other.xllcref);
+        illcref.par_reduce(other.illcref);
+        xllcmiss.par_reduce(other.xllcmiss);
+        illcmiss.par_reduce(other.illcmiss);
+        xflops.par_reduce(other.xflops);
+        iflops.par_reduce(other.iflops);
     }
 
     void WorldProfileEntry::clear() {
@@ -131,6 +165,73 @@ namespace madness {
         inbyt_sent.clear();
         xnbyt_recv.clear();
         inbyt_recv.clear();
+        xcycles.clear();
+        icycles.clear();
+        xinstr.clear();
+        iinstr.clear();
+        xllcref.clear();
+        illcref.clear();
+        xllcmiss.clear();
+        illcmiss.clear();
+        xflops.clear();
+        iflops.clear();
+    }
+
+    void WorldProfileEntry::add_exclusive(const PerfCounterValues& hw) {
+        xcycles.value += hw.cycles;
+        xinstr.value += hw.instructions;
+        xllcref.value += hw.llc_refs;
+        xllcmiss.value += hw.llc_misses;
+        xflops.value += hw.flops;
+    }
+
+    void WorldProfileEntry::add_inclusive(const PerfCounterValues& hw) {
+        icycles.value += hw.cycles;
+        iinstr.value += hw.instructions;
+        illcref.value += hw.llc_refs;
+        illcmiss.value += hw.llc_misses;
+        iflops.value += hw.flops;
+    }
+
+    WorldProfileNode::WorldProfileNode(int id, WorldProfileNode* parent)
+            : id(id), parent(parent), count(0), xcycles(0), icycles(0)
+    {}
+
+    WorldProfileNode* WorldProfileNode::child(int id) {
+        ScopedMutex<Spinlock> fred(this);
+        for (unsigned int i=0; i<children.size(); ++i) {
+            if (children[i]->id == id) return children[i];
+        }
+        WorldProfileNode* node = new WorldProfileNode(id, this);
+        children.push_back(node);
+        return node;
+    }
+
+    void WorldProfileNode::clear() {
+        ScopedMutex<Spinlock> fred(this);
+        count = 0;
+        xcycles = icycles = 0;
+        for (unsigned int i=0; i<children.size(); ++i) children[i]->clear();
+    }
+
+    void WorldProfileTreeEntry::init_par_stats(ProcessID me) {
+        count.init_par_stats(me);
+        xcpu.init_par_stats(me);
+        icpu.init_par_stats(me);
+    }
+
+    void WorldProfileTreeEntry::par_reduce(const WorldProfileTreeEntry& other) {
+        nproc += other.nproc;
+        count.par_reduce(other.count);
+        xcpu.par_reduce(other.xcpu);
+        icpu.par_reduce(other.icpu);
+    }
+
+    void WorldProfileTreeEntry::finalize_par_stats(int nproc_total) {
+        if (nproc < nproc_total) { // Some process never got here
+            count.min = 0;
+            xcpu.min = icpu.min = 0.0;
+        }
     }
 
     std::vector<WorldProfileEntry>& WorldProfile::nvitems() {
@@ -185,6 +286,12 @@ namespace madness {
         for (unsigned int i=0; i<nv.size(); ++i) {
             nv[i].clear();
         }
+        calltree_root()->clear();
+    }
+
+    WorldProfileNode* WorldProfile::calltree_root() {
+        static WorldProfileNode root(-1, 0);
+        return &root;
     }
 
     /// Returns a reference to the specified entry.  Throws if id is invalid.
@@ -282,6 +389,27 @@ namespace madness {
         }
     }
 
+
+    static void profile_do_print_hw(const std::vector<WorldProfileEntry>& v) {
+        std::printf("              exclusive                                                inclusive\n");
+        std::printf(" ---------------------------------------------------------------- ----------------------------------------------------------------\n");
+        std::printf("   cycles    instr      IPC  GFLOP/s flop/cyc  LLC-ref LLC-miss    cycles    instr      IPC  GFLOP/s flop/cyc  LLC-ref LLC-miss name\n");
+        std::printf(" -------- -------- -------- -------- -------- -------- --------  -------- -------- -------- -------- -------- -------- -------- --------------------\n");
+        for (unsigned int i=0; i<v.size(); ++i) {
+            const WorldProfileEntry& e = v[i];
+            double xipc = e.xcycles.sum ? e.xinstr.sum/e.xcycles.sum : 0.0;
+            double iipc = e.icycles.sum ? e.iinstr.sum/e.icycles.sum : 0.0;
+            double xgfs = e.xcpu.sum ? 1e-9*e.xflops.sum/e.xcpu.sum : 0.0;
+            double igfs = e.icpu.sum ? 1e-9*e.iflops.sum/e.icpu.sum : 0.0;
+            double xfpc = e.xcycles.sum ? e.xflops.sum/e.xcycles.sum : 0.0;
+            double ifpc = e.icycles.sum ? e.iflops.sum/e.icycles.sum : 0.0;
+            std::printf("%9.2e%9.2e%9.2f%9.2f%9.2f%9.2e%9.2e %9.2e%9.2e%9.2f%9.2f%9.2f%9.2e%9.2e %s\n",
+                        e.xcycles.sum, e.xinstr.sum, xipc, xgfs, xfpc, e.xllcref.sum, e.xllcmiss.sum,
+                        e.icycles.sum, e.iinstr.sum, iipc, igfs, ifpc, e.illcref.sum, e.illcmiss.sum,
+                        e.name.c_str());
+        }
+    }
+
 #endif
 
 #ifdef WORLD_PROFILE_ENABLE
@@ -379,9 +507,29 @@ namespace madness {
             std::printf("  ** sorted by inclusive nbytes sent **\n");
             profile_do_print_comms(world, v);
 
+            if (PerfCounters::available()) {
+                std::printf("\n    MADNESS hardware counter profile\n");
+                std::printf("    --------------------------------\n\n");
+                std::printf("    o  counters are summed over all threads and processes\n");
+                std::printf("    o  IPC is instructions retired per cycle\n");
+                std::printf("    o  GFLOP/s is per cpu-second (i.e., per thread), flop/cyc per cycle\n");
+                if (!PerfCounters::have_flops())
+                    std::printf("    o  no flop events configured ... set MAD_PERF_FLOP_EVENTS\n");
+                std::printf("    o  sorted in descending order by total exclusive cpu time\n");
+
+                std::sort(v.begin(), v.end(), &WorldProfileEntry::exclusivecmp);
+                std::printf("\n\n");
+                profile_do_print_hw(v);
+            }
+
         }
         world.gop.fence();
 
+        print_calltree(world);
+        const char* folded = std::getenv("MAD_PROFILE_FOLDED");
+        if (folded) write_folded(world, folded);
+        const char* json = std::getenv("MAD_PROFILE_JSON");
+        if (json) write_json(world, json);
 #endif
     }
 
@@ -404,19 +552,214 @@ namespace madness {
         }
     }
 
-    WorldProfileObj::WorldProfileObj(int id) : prev(call_stack), id(id), cpu_base(madness::cpu_time()), stats_base(::madness::RMI::get_stats()) {
+    namespace {
+
+        /// Appends the entries for the descendents of \c node in depth-first order
+        void calltree_collect(const WorldProfileNode* node, const std::string& path,
+                              double rfreq, std::vector<WorldProfileTreeEntry>& v) {
+            for (unsigned int i=0; i<node->children.size(); ++i) {
+                const WorldProfileNode* c = node->children[i];
+                WorldProfileTreeEntry e;
+                const std::string& name = WorldProfile::get_entry(c->id).name;
+                e.path = path.empty() ? name : path + ";" + name;
+                e.nproc = 1;
+                e.count.value = c->count;
+                e.xcpu.value = c->xcycles*rfreq;
+                e.icpu.value = c->icycles*rfreq;
+                v.push_back(e);
+                calltree_collect(c, e.path, rfreq, v);
+            }
+        }
+
+        /// Orders paths so that every node comes immediately before its descendents
+        bool calltree_pathcmp(const WorldProfileTreeEntry& a, const WorldProfileTreeEntry& b) {
+            const std::string& x = a.path;
+            const std::string& y = b.path;
+            std::size_t n = std::min(x.size(), y.size());
+            for (std::size_t i=0; i<n; ++i) {
+                char cx = (x[i] == ';') ? '\001' : x[i];
+                char cy = (y[i] == ';') ? '\001' : y[i];
+                if (cx != cy) return cx < cy;
+            }
+            return x.size() < y.size();
+        }
+
+        int calltree_depth(const std::string& path) {
+            return std::count(path.begin(), path.end(), ';');
+        }
+
+        std::string calltree_leaf(const std::string& path) {
+            std::size_t pos = path.rfind(';');
+            return (pos == std::string::npos) ? path : path.substr(pos+1);
+        }
+
+        void json_string(std::FILE* f, const std::string& s) {
+            std::fputc('"', f);
+            for (std::size_t i=0; i<s.size(); ++i) {
+                char c = s[i];
+                if (c == '"' || c == '\\') std::fputc('\\', f);
+                if (c >= 0 && c < 0x20) continue;
+                std::fputc(c, f);
+            }
+            std::fputc('"', f);
+        }
+
+    } // namespace
+
+    std::vector<WorldProfileTreeEntry> WorldProfile::reduce_calltree(World& world) {
+        std::vector<WorldProfileTreeEntry> v;
+        calltree_collect(calltree_root(), "", 1.0/cpu_frequency(), v);
+
+        ProcessID me = world.rank();
+        std::map<std::string, WorldProfileTreeEntry> m;
+        for (unsigned int i=0; i<v.size(); ++i) {
+            v[i].init_par_stats(me);
+            m[v[i].path] = v[i];
+        }
+
+        // Binary tree reduction as in print()
+        for (ProcessID p=2*me+1; p<=2*me+2; ++p) {
+            if (p >= world.size()) break;
+            archive::MPIInputArchive ar(world, p);
+            std::vector<WorldProfileTreeEntry> w;
+            ar & w;
+            for (unsigned int i=0; i<w.size(); ++i) {
+                std::map<std::string, WorldProfileTreeEntry>::iterator it = m.find(w[i].path);
+                if (it == m.end())
+                    m[w[i].path] = w[i];
+                else
+                    it->second.par_reduce(w[i]);
+            }
+        }
+
+        v.clear();
+        for (std::map<std::string, WorldProfileTreeEntry>::const_iterator it=m.begin(); it!=m.end(); ++it)
+            v.push_back(it->second);
+
+        if (me) {
+            archive::MPIOutputArchive ar(world, (me-1)/2);
+            ar & v;
+            v.clear();
+        }
+        else {
+            for (unsigned int i=0; i<v.size(); ++i) v[i].finalize_par_stats(world.size());
+            std::sort(v.begin(), v.end(), calltree_pathcmp);
+        }
+        return v;
+    }
+
+    void WorldProfile::print_calltree(World& world) {
+        std::vector<WorldProfileTreeEntry> v = reduce_calltree(world);
+        if (world.rank() == 0) {
+            double total = 0.0;
+            for (unsigned int i=0; i<v.size(); ++i)
+                if (calltree_depth(v[i].path) == 0) total += v[i].icpu.sum;
+
+            std::printf("\n    MADNESS call tree profile\n");
+            std::printf("    -------------------------\n\n");
+            std::printf("    o  one entry per distinct call path, indented under its caller\n");
+            std::printf("    o  times are from the time stamp counter summed over threads\n");
+            std::printf("    o  min/avg/max are of the inclusive time over processes\n");
+            std::printf("    o  imbal = max/avg (1.0 is perfectly balanced)\n");
+            std::printf("    o  tasks start new paths at the root since they have no caller\n\n");
+            std::printf("  inc%%     inc/s   inc-min  inc-avg  inc-max    imbal    exc/s     calls name\n");
+            std::printf(" ----- -------- -------- -------- -------- -------- -------- --------- --------------------\n");
+            const double nproc = world.size();
+            for (unsigned int i=0; i<v.size(); ++i) {
+                const WorldProfileTreeEntry& e = v[i];
+                double avg = e.icpu.sum/nproc;
+                double imbal = avg ? e.icpu.max/avg : 1.0;
+                std::printf("%6.1f%9.2e%9.2e%9.2e%9.2e%9.2f%9.2e%10lu %*s%s\n",
+                            total ? 100.0*e.icpu.sum/total : 0.0,
+                            e.icpu.sum, e.icpu.min, avg, e.icpu.max, imbal,
+                            e.xcpu.sum, e.count.sum,
+                            2*calltree_depth(e.path), "", calltree_leaf(e.path).c_str());
+            }
+        }
+        world.gop.fence();
+    }
+
+    void WorldProfile::write_folded(World& world, const std::string& filename) {
+        std::vector<WorldProfileTreeEntry> v = reduce_calltree(world);
+        if (world.rank() == 0) {
+            std::FILE* f = std::fopen(filename.c_str(), "w");
+            if (!f) MADNESS_EXCEPTION("WorldProfile: write_folded: failed to open file", 0);
+            for (unsigned int i=0; i<v.size(); ++i) {
+                unsigned long long us = (unsigned long long)(v[i].xcpu.sum*1e6 + 0.5);
+                if (us) std::fprintf(f, "%s %llu\n", v[i].path.c_str(), us);
+            }
+            std::fclose(f);
+        }
+        world.gop.fence();
+    }
+
+    void WorldProfile::write_json(World& world, const std::string& filename) {
+        std::vector<WorldProfileTreeEntry> v = reduce_calltree(world);
+        if (world.rank() == 0) {
+            std::FILE* f = std::fopen(filename.c_str(), "w");
+            if (!f) MADNESS_EXCEPTION("WorldProfile: write_json: failed to open file", 0);
+
+            double total = 0.0;
+            for (unsigned int i=0; i<v.size(); ++i)
+                if (calltree_depth(v[i].path) == 0) total += v[i].icpu.sum;
+
+            const double nproc = world.size();
+            std::fprintf(f, "{\"name\": \"root\", \"value\": %.0f, \"nproc\": %d, \"children\": [", total*1e6, world.size());
+            int open = 0;            // No. of entries whose children list is open
+            bool need_comma = false;
+            for (unsigned int i=0; i<v.size(); ++i) {
+                const WorldProfileTreeEntry& e = v[i];
+                const int depth = calltree_depth(e.path);
+                while (open > depth) {
+                    std::fprintf(f, "]}");
+                    --open;
+                    need_comma = true;
+                }
+                if (need_comma) std::fprintf(f, ",");
+                const double avg = e.icpu.sum/nproc;
+                std::fprintf(f, "\n%*s{\"name\": ", 2*(depth+1), "");
+                json_string(f, calltree_leaf(e.path));
+                std::fprintf(f, ", \"value\": %.0f, \"self\": %.0f, \"calls\": %lu, "
+                             "\"min\": %.6e, \"avg\": %.6e, \"max\": %.6e, \"imbalance\": %.3f, \"children\": [",
+                             e.icpu.sum*1e6, e.xcpu.sum*1e6, e.count.sum,
+                             e.icpu.min, avg, e.icpu.max, avg ? e.icpu.max/avg : 1.0);
+                ++open;
+                need_comma = false;
+            }
+            while (open-- > 0) std::fprintf(f, "]}");
+            std::fprintf(f, "]}\n");
+            std::fclose(f);
+        }
+        world.gop.fence();
+    }
+
+    WorldProfileObj::WorldProfileObj(int id)
+        : prev(call_stack)
+        , id(id)
+        , node((prev ? prev->node : WorldProfile::calltree_root())->child(id))
+        , tsc_base(cycle_count())
+        , cpu_base(madness::cpu_time())
+        , stats_base(::madness::RMI::get_stats())
+    {
+        PerfCounters::read(hw_base);
         int tid = mythreadid;
         if (tid == -1) tid = mythreadid = ++threadcounter;
         MADNESS_ASSERT(mythreadid < 64);
         cpu_start = cpu_base;
+        tsc_start = tsc_base;
         stats_start = stats_base;
+        hw_start = hw_base;
         call_stack = this;
         ++(WorldProfile::get_entry(id).depth[tid]); // Keep track of recursive calls to avoid double counting time in self
-        if (prev) prev->pause(cpu_start,stats_start);
+        if (prev) prev->pause(cpu_start,tsc_start,stats_start,hw_start);
     }
 
     /// Pause profiling while we are not executing ... accumulate time in self
-    void WorldProfileObj::pause(double now, const RMIStats& stats) {
+    void WorldProfileObj::pause(double now, uint64_t tsc, const RMIStats& stats, const PerfCounterValues& hw) {
+        {
+            ScopedMutex<Spinlock> fred(node);
+            node->xcycles += (tsc - tsc_start);
+        }
         ScopedMutex<Spinlock> martha(WorldProfile::get_entry(id));
         WorldProfileEntry& d = WorldProfile::get_entry(id);
 
@@ -425,20 +768,32 @@ namespace madness {
         d.xnmsg_recv.value += (stats.nmsg_recv - stats_start.nmsg_recv);
         d.xnbyt_sent.value += (stats.nbyte_sent - stats_start.nbyte_sent);
         d.xnbyt_recv.value += (stats.nbyte_recv - stats_start.nbyte_recv);
+        d.add_exclusive(hw - hw_start);
     }
 
     /// Resume profiling
-    void WorldProfileObj::resume(double now, const RMIStats& statsnow) {
+    void WorldProfileObj::resume(double now, uint64_t tsc, const RMIStats& statsnow, const PerfCounterValues& hw) {
         cpu_start = now;
+        tsc_start = tsc;
         stats_start = statsnow;
+        hw_start = hw;
     }
 
     WorldProfileObj::~WorldProfileObj() {
         // if (call_stack != this) throw "WorldProfileObject: call stack confused\n"; // destructors should not throw
         double now = madness::cpu_time();
+        uint64_t tsc = cycle_count();
         RMIStats stats = RMI::get_stats();
+        PerfCounterValues hw;
+        PerfCounters::read(hw);
         WorldProfileEntry& d = WorldProfile::get_entry(id);
         int tid = mythreadid;
+        {
+            ScopedMutex<Spinlock> fred(node);
+            ++(node->count);
+            node->xcycles += (tsc - tsc_start);
+            node->icycles += (tsc - tsc_base);
+        }
         {
             ScopedMutex<Spinlock> martha(d);
             ++(d.count.value);
@@ -447,6 +802,7 @@ namespace madness {
             d.xnmsg_recv.value += (stats.nmsg_recv - stats_start.nmsg_recv);
             d.xnbyt_sent.value += (stats.nbyte_sent - stats_start.nbyte_sent);
             d.xnbyt_recv.value += (stats.nbyte_recv - stats_start.nbyte_recv);
+            d.add_exclusive(hw - hw_start);
             d.depth[tid]--;
             if (d.depth[tid] == 0) { // Don't double count recursive calls
                 d.icpu.value += (now - cpu_base);
@@ -454,10 +810,11 @@ namespace madness {
                 d.inmsg_recv.value += (stats.nmsg_recv - stats_base.nmsg_recv);
                 d.inbyt_sent.value += (stats.nbyte_sent - stats_base.nbyte_sent);
                 d.inbyt_recv.value += (stats.nbyte_recv - stats_base.nbyte_recv);
+                d.add_inclusive(hw - hw_base);
             }
         }
         call_stack = prev;
-        if (call_stack) call_stack->resume(now, stats);
+        if (call_stack) call_stack->resume(now, tsc, stats, hw);
     }
 
 } // namespace madness
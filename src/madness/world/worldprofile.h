@@ -37,6 +37,8 @@
 #include <madness/world/worldrmi.h>
 #include <madness/world/worldtypes.h>
 #include <madness/world/worldmutex.h>
+#include <madness/world/worldperf.h>
+#include <madness/world/timers.h>
 #include <string>
 #include <vector>
 
@@ -103,6 +105,16 @@ namespace madness {
         ProfileStat<unsigned long> inbyt_sent; ///< No. of bytes sent ... inclusive
         ProfileStat<unsigned long> xnbyt_recv; ///< No. of bytes recv ... exclusive
         ProfileStat<unsigned long> inbyt_recv; ///< No. of bytes recv ... inclusive
+        ProfileStat<double> xcycles;  ///< Hardware cycles ... exclusive
+        ProfileStat<double> icycles;  ///< Hardware cycles ... inclusive
+        ProfileStat<double> xinstr;   ///< Instructions retired ... exclusive
+        ProfileStat<double> iinstr;   ///< Instructions retired ... inclusive
+        ProfileStat<double> xllcref;  ///< Last-level cache references ... exclusive
+        ProfileStat<double> illcref;  ///< Last-level cache references ... inclusive
+        ProfileStat<double> xllcmiss; ///< Last-level cache misses ... exclusive
+        ProfileStat<double> illcmiss; ///< Last-level cache misses ... inclusive
+        ProfileStat<double> xflops;   ///< Floating point operations ... exclusive
+        ProfileStat<double> iflops;   ///< Floating point operations ... inclusive
 
         WorldProfileEntry(const char* name = "");
 
@@ -118,6 +130,12 @@ namespace madness {
 
         static bool inclusivebytcmp(const WorldProfileEntry&a, const WorldProfileEntry& b);
 
+        /// Accumulates exclusive hardware counter deltas
+        void add_exclusive(const PerfCounterValues& hw);
+
+        /// Accumulates inclusive hardware counter deltas
+        void add_inclusive(const PerfCounterValues& hw);
+
         void init_par_stats(ProcessID me);
 
         void par_reduce(const WorldProfileEntry& other);
@@ -126,11 +144,61 @@ namespace madness {
 
         template <class Archive>
         void serialize(const Archive& ar) {
-            ar & name & depth & count & xcpu & icpu & xnmsg_sent & inmsg_sent & xnmsg_recv & inmsg_recv & xnbyt_sent & inbyt_sent & xnbyt_recv & inbyt_recv;
+            ar & name & depth & count & xcpu & icpu & xnmsg_sent & inmsg_sent & xnmsg_recv & inmsg_recv & xnbyt_sent & inbyt_sent & xnbyt_recv & inbyt_recv
+               & xcycles & icycles & xinstr & iinstr & xllcref & illcref & xllcmiss & illcmiss & xflops & iflops;
         }
     }; // struct WorldProfileEntry
 
 
+    /// Node in the call tree of profiled regions
+
+    /// There is one node per distinct call path (i.e., sequence of nested
+    /// profiled regions) rather than one per region, so that a routine
+    /// called from different places is recorded separately.  Nodes are
+    /// shared by all threads, are created on first use, and are never
+    /// deleted.  Times are kept in time stamp counter cycles.
+    struct WorldProfileNode : public Spinlock {
+        const int id;                            ///< Entry id of the region (-1 for the root)
+        WorldProfileNode* const parent;          ///< Calling node (null for the root)
+        std::vector<WorldProfileNode*> children; ///< Nodes called from this one
+        unsigned long count;                     ///< No. of times entered
+        uint64_t xcycles;                        ///< Exclusive cycles (i.e., excluding calls)
+        uint64_t icycles;                        ///< Inclusive cycles
+
+        WorldProfileNode(int id, WorldProfileNode* parent);
+
+        /// Returns the node for region \c id called from here, creating it if necessary
+        WorldProfileNode* child(int id);
+
+        /// Zeros the data of this node and all of its descendents
+        void clear();
+    }; // struct WorldProfileNode
+
+
+    /// Statistics for one call path reduced over processes
+    struct WorldProfileTreeEntry {
+        std::string path;                   ///< Region names from the root separated by ';'
+        int nproc;                          ///< No. of processes that executed this path
+        ProfileStat<unsigned long> count;   ///< count of times called
+        ProfileStat<double> xcpu;           ///< exclusive time (i.e., excluding calls)
+        ProfileStat<double> icpu;           ///< inclusive time (i.e., including calls)
+
+        WorldProfileTreeEntry() : nproc(0) {}
+
+        void init_par_stats(ProcessID me);
+
+        void par_reduce(const WorldProfileTreeEntry& other);
+
+        /// Adjusts the minima for processes that never executed this path
+        void finalize_par_stats(int nproc_total);
+
+        template <class Archive>
+        void serialize(const Archive& ar) {
+            ar & path & nproc & count & xcpu & icpu;
+        }
+    }; // struct WorldProfileTreeEntry
+
+
     /// Singleton-like class for holding profiling data and functionality
 
     /// Use the macros PROFILE_FUNC, PROFILE_BLOCK, PROFILE_MEMBER_FUNC
@@ -161,12 +229,42 @@ namespace madness {
         /// Returns a reference to the specified entry.  Throws if id is invalid.
         static WorldProfileEntry& get_entry(int id);
 
+        /// Returns the root of the call tree
+        static WorldProfileNode* calltree_root();
+
         /// Prints global profiling information.  Global fence involved.  Implemented in worldstuff.cc
+
+        /// Also prints the call tree and, if the environment variables
+        /// \c MAD_PROFILE_FOLDED or \c MAD_PROFILE_JSON name a file, writes
+        /// it out as by \c write_folded() and \c write_json().
         static void print(World& world);
 
+        /// Prints the call tree reduced over all processes.  Collective.
+        static void print_calltree(World& world);
+
+        /// Writes the call tree in folded-stack format.  Collective.
+
+        /// Each line is the ';' separated call path followed by the
+        /// exclusive time in microseconds summed over all processes, as
+        /// read by flamegraph.pl and most other flame graph tools.  Written
+        /// by process zero.
+        static void write_folded(World& world, const std::string& filename);
+
+        /// Writes the call tree as nested JSON objects.  Collective.
+
+        /// Each node has \c name, \c value (inclusive microseconds summed
+        /// over processes), \c self (exclusive), \c calls, \c min, \c max,
+        /// \c avg and \c imbalance (max/avg of the inclusive time over
+        /// processes) and \c children, which is the layout used by d3 flame
+        /// graph viewers.  Written by process zero.
+        static void write_json(World& world, const std::string& filename);
+
     private:
         /// Private.  Accumlates data from process into parallel statistics.  Implemented in worldstuff.cc
         static void recv_stats(World& world, ProcessID p);
+
+        /// Private.  Reduces the call tree over processes; the result is only valid on process zero.
+        static std::vector<WorldProfileTreeEntry> reduce_calltree(World& world);
     };
 
 
@@ -175,19 +273,24 @@ namespace madness {
         static thread_local int mythreadid; ///< My unique thread id
         WorldProfileObj* const prev; ///< Pointer to the entry that called me
         const int id;                ///< My entry in the world profiler
+        WorldProfileNode* const node; ///< My node in the call tree
+        const uint64_t tsc_base;     ///< Cycle count when I started executing
+        uint64_t tsc_start;          ///< Cycle count when I was at top of stack
         const double cpu_base;       ///< Time that I started executing
         RMIStats stats_base;         ///< Msg stats when I start executing
         double cpu_start;            ///< Time that I was at top of stack
         RMIStats stats_start;        ///< Msg stats when I was at top of stack;
+        PerfCounterValues hw_base;   ///< Hardware counters when I start executing
+        PerfCounterValues hw_start;  ///< Hardware counters when I was at top of stack
     public:
 
         WorldProfileObj(int id);
 
         /// Pause profiling while we are not executing ... accumulate time in self
-        void pause(double now, const RMIStats& stats);
+        void pause(double now, uint64_t tsc, const RMIStats& stats, const PerfCounterValues& hw);
 
         /// Resume profiling
-        void resume(double now, const RMIStats& stats);
+        void resume(double now, uint64_t tsc, const RMIStats& stats, const PerfCounterValues& hw);
 
         ~WorldProfileObj();
     };